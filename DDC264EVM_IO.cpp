@@ -16,18 +16,26 @@
 #include "StdAfx.h"
 #include "CyApi.h"
 #include "DDC264EVM_IO.h"
+#include "EVM_Registers.h"
+#include "EVM_Internal.h"
+#include "EVM_Decode.h"
+#include "EVM_Memory.h"
+#include "EVM_Devices.h"
+#include "EVM_Timing.h"
+#include "EVM_Board.h"
+#include "EVM_Trace.h"
+#include "EVM_Average.h"
 #include <cstring>
 #include <malloc.h>
 #include <math.h>
-#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
 
-#ifdef DEBUG
-  #include<iostream>
-  using namespace std;
-  #define DEBUGECHO(TXT) cout << TXT << "\n"
-#else
-  #define DEBUGECHO(TXT) {}
-#endif
+HINSTANCE EVM_Module = NULL;
+
+// Milliseconds a control write waits for the stream reading the board to send it
+static const int CONTROL_TIMEOUT_MS = 2000;
 
 BOOL APIENTRY DllMain(HANDLE hModule,
     DWORD  ul_reason_for_call,
@@ -37,9 +45,13 @@ BOOL APIENTRY DllMain(HANDLE hModule,
     switch (ul_reason_for_call)
     {
     case DLL_PROCESS_ATTACH:
+        EVM_Module = (HINSTANCE)hModule;
+        break;
     case DLL_THREAD_ATTACH:
     case DLL_THREAD_DETACH:
+        break;
     case DLL_PROCESS_DETACH:
+        // The device watcher holds a reference to the DLL, an unload gets here only after EVM_Shutdown stopped it
         break;
     }
     return TRUE;
@@ -50,11 +62,9 @@ BOOL APIENTRY DllMain(HANDLE hModule,
 constexpr char DLL_ID[] = "DDC264EVM_IO ver 3.3";
 constexpr char DLL_C[] = "Miguel Risco-Castillo (c) 2024";
 
-#define STRINGLEN 65536 //the larger this number is, the faster the data is shifted in.
-#define MAX_CHANNELS_FAST 4096 // 2048 = 1024A + 1024B
-
 // This function reads the device descriptors from the Cypress USB Chip(s).
 // It returns arrays of values, one set of values per device detected.
+// The descriptors come from the device cache, the boards are only opened when they are plugged or unplugged.
 
 int __stdcall ReadDeviceDescriptors(int* USBdevCount, int* bLengthPass, int* bDescriptorTypePass,
     long* bcdUSBPass, int* bDeviceClassPass, int* bDeviceSubClassPass,
@@ -62,19 +72,17 @@ int __stdcall ReadDeviceDescriptors(int* USBdevCount, int* bLengthPass, int* bDe
     long* idProductPass, long* bcdDevicePass, int* iManufacturerPass,
     int* iProductPass, int* iSerialNumberPass, int* bNumConfigurationsPass)
 {
-    CCyUSBDevice* USBDevice;
-    USB_DEVICE_DESCRIPTOR descr;
-
-    USBDevice = new CCyUSBDevice(NULL);   // Create an instance of CCyUSBDevice
+    std::vector<EVM_DeviceEntry> List;
+    EVM_GetDevices(List);
 
-    USBdevCount[0] = USBDevice->DeviceCount();
+    USBdevCount[0] = (int)List.size();
 
-    for (int i = 0; i < USBDevice->DeviceCount(); i++)
+    for (int i = 0; i < USBdevCount[0]; i++)
     {
 
-        if (USBDevice->Open(i))
+        if (List[i].Opened)
         {
-            USBDevice->GetDeviceDescriptor(&descr);
+            const USB_DEVICE_DESCRIPTOR& descr = List[i].Device;
             bLengthPass[i] = descr.bLength;
             bDescriptorTypePass[i] = descr.bDescriptorType;
             bcdUSBPass[i] = descr.bcdUSB;
@@ -89,7 +97,6 @@ int __stdcall ReadDeviceDescriptors(int* USBdevCount, int* bLengthPass, int* bDe
             iProductPass[i] = descr.iProduct;
             iSerialNumberPass[i] = descr.iSerialNumber;
             bNumConfigurationsPass[i] = descr.bNumConfigurations;
-            USBDevice->Close();
         }
     }
 
@@ -103,14 +110,12 @@ int __stdcall ReadInterfaceDescriptors(int* USBdev, int* bLengthPass, int* bDesc
     int* bInterfaceClassPass, int* bInterfaceSubClassPass, int* bInterfaceProtocolPass,
     int* iInterfacePass)
 {
-    CCyUSBDevice* USBDevice;
-    USB_INTERFACE_DESCRIPTOR descr;
+    std::vector<EVM_DeviceEntry> List;
+    EVM_GetDevices(List);
 
-    USBDevice = new CCyUSBDevice(NULL);   // Create an instance of CCyUSBDevice
-
-    if (USBDevice->Open(USBdev[0]))
+    if (USBdev[0] >= 0 && USBdev[0] < (int)List.size() && List[USBdev[0]].Opened)
     {
-        USBDevice->GetIntfcDescriptor(&descr);
+        const USB_INTERFACE_DESCRIPTOR& descr = List[USBdev[0]].Interface;
         bLengthPass[0] = descr.bLength;
         bDescriptorTypePass[0] = descr.bDescriptorType;
         bInterfaceNumberPass[0] = descr.bInterfaceNumber;
@@ -120,7 +125,6 @@ int __stdcall ReadInterfaceDescriptors(int* USBdev, int* bLengthPass, int* bDesc
         bInterfaceSubClassPass[0] = descr.bInterfaceSubClass;
         bInterfaceProtocolPass[0] = descr.bInterfaceProtocol;
         iInterfacePass[0] = descr.iInterface;
-        USBDevice->Close();
     }
     else
     {
@@ -130,17 +134,23 @@ int __stdcall ReadInterfaceDescriptors(int* USBdev, int* bLengthPass, int* bDesc
     return(0);
 }
 
-// This function writes a string of bytes to the USB
+// This function writes a string of bytes to the USB.
+// While a stream reads the board they are sent by its reader between two transfers, -4 or -5 if they couldn't be;
+// on -4 they were not sent and never will be.
 int __stdcall XferDataOut(int* USBdev, unsigned char* Data, long* DataLength)
 {
+    EVM_Exchange Exchange(USBdev[0], Data, DataLength[0], CONTROL_TIMEOUT_MS);
+    if (!Exchange.Held) return(Exchange.Result);
+
     CCyUSBDevice* USBDevice = new CCyUSBDevice(NULL); // Create an instance of CCyUSBDevice - NULL means we don't register for pnp events
 
-    if (USBDevice->Open(USBdev[0]))
+    if (EVM_OpenDevice(USBDevice, USBdev[0]))
     {
         if (USBDevice->BulkOutEndPt)
         {
+            long Length = DataLength[0];
             USBDevice->BulkOutEndPt->TimeOut = 100;
-            USBDevice->BulkOutEndPt->XferData(Data, DataLength[0]);
+            if (USBDevice->BulkOutEndPt->XferData(Data, DataLength[0])) Exchange.Board.Note(Data, Length);
         }
         USBDevice->Close();
     }
@@ -154,13 +164,16 @@ int __stdcall XferDataOut(int* USBdev, unsigned char* Data, long* DataLength)
 
 
 // This is the primary conduit for onesie/twosie data from the USB to the computer.
+// -14 while a stream reads the board, the data is its own.
 int __stdcall XferDataIn(int* USBdev, unsigned char* Data, long* DataLength)
 {
+    EVM_Exchange Exchange(USBdev[0]);
+    if (!Exchange.Held) return(Exchange.Result);
 
     bool XferSuccess;
     CCyUSBDevice* USBDevice = new CCyUSBDevice(NULL); // Create an instance of CCyUSBDevice - NULL means we don't register for pnp events
 
-    if (USBDevice->Open(USBdev[0]))
+    if (EVM_OpenDevice(USBDevice, USBdev[0]))
     {
         if (USBDevice->BulkInEndPt)
         {
@@ -208,178 +221,176 @@ void __stdcall dllCprght(char* text, int bufsize)
 // This function writes a byte to a Register via USB.
 int __stdcall EVM_RegDataOut(int* USBdev, int* Reg, int* Data)
 {
-    constexpr auto ArraySize = 2;
-    unsigned char DataArr[ArraySize] = { 0 };
-
-    CCyUSBDevice* USBDevice = new CCyUSBDevice(NULL); // Create an instance of CCyUSBDevice - NULL means we don't register for pnp events
-
-    DataArr[0] = *Reg && 0xFF;
-    DataArr[1] = *Data && 0xFF;
-
-    if (USBDevice->Open(USBdev[0]))
-    {
-        if (USBDevice->BulkOutEndPt)
-        {
-            long DataLength = ArraySize;
-            USBDevice->BulkOutEndPt->TimeOut = 100;
-            USBDevice->BulkOutEndPt->XferData(DataArr, DataLength);
-        }
-        USBDevice->Close();
-    }
-    else
-    {
-        return(-1);
-    }
-
-    return(0);
+    auto Seq = EVM_MakePacket({ { (byte)(*Reg & 0xFF), (byte)(*Data & 0xFF) } });
+    long DataLength = Seq.Length();
+    return XferDataOut(USBdev, Seq.Bytes, &DataLength);
 }
 
 bool __stdcall EVM_ResetDDC(int* USBdev) // Soft Reset DDC
 {
-    byte Array[] = { 0x00, 0x00, 0x00, 0x00, 0x15, 0xFF, 0x15, 0xFF, 0x15, 0x00, 0x15, 0x00, 0x15, 0x00, 0x15, 0x00, 0x15, 0xFF, 0x15, 0xFF, 0x15, 0xFF, 0x15, 0xFF };
-    long arraySize = sizeof(Array) / sizeof(Array[0]);
-    return (XferDataOut(USBdev, Array, &arraySize) == 0);
+    auto Seq = EVM_SEQ_RESET_DDC;
+    long arraySize = Seq.Length();
+    return (XferDataOut(USBdev, Seq.Bytes, &arraySize) == 0);
 }
 
 bool __stdcall EVM_ClearTriggers(int* USBdev) // Makes sure the CFG state machine is reset
 {
-    byte Array[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1E, 0x00, 0x1E, 0x00, 0xD1, 0x00 };
-    long arraySize = sizeof(Array) / sizeof(Array[0]);
-    return (XferDataOut(USBdev, Array, &arraySize) == 0);
+    auto Seq = EVM_SEQ_CLEAR_TRIGGERS;
+    long arraySize = Seq.Length();
+    return (XferDataOut(USBdev, Seq.Bytes, &arraySize) == 0);
 }
 
 bool __stdcall EVM_DataSequence(int* USBdev, byte* CFGHIGH, byte* CFGLOW) // Send DataSequence Array
 {
-    byte Array[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x11, 0x00, 0x12, 0x00, 0x1C, 0x00, 0x1D, 0x00, 0x1F, 0x01, 0x00, 0x00, 0x00, 0x00, 0x1E, 0x00 };
-    Array[11] = *CFGHIGH; Array[13] = *CFGLOW;
-    long arraySize = sizeof(Array) / sizeof(Array[0]);
-    return (XferDataOut(USBdev, Array, &arraySize) == 0);
-}
-
-std::map<int, const char*> RegNameTable = {
-    {0x00, "No Op"},
-    {0x01, "CONV_LOW_REG_MSB"},
-    {0x02, "CONV_LOW_REG_MidB"},
-    {0x03, "CONV_LOW_REG_LSB"},
-    {0x04, "CONV_HIGH_REG_MSB"},
-    {0x05, "CONV_HIGH_REG_MidB"},
-    {0x06, "CONV_HIGH_REG_LSB"},
-    {0x07, "DIVXCLK_REGS"},
-    {0x08, "DDC_CLK_SEL"},
-    {0x09, "FORMAT[4],CHANNELS[3:0]"},
-    {0x0A, "DIVXCLK_DATA_REGS"},
-    {0x0B, "DDC_DATA_CLK_SEL"},
-    {0x0C, "nDVALIDS_IGNORE"},
-    {0x0D, "nDVALIDS_READ_LSB"},
-    {0x0E, "nDVALIDS_READ_MidB"},
-    {0x0F, "nDVALIDS_READ_MSB"},
-    {0x10, "DONE[1],START_CONVERSIONS[0]"},
-    {0x11, "CLK_CFG"},
-    {0x12, "DIN_CFG"},
-    {0x13, "DCLK_WAIT_COUNT_MSB"},
-    {0x14, "DCLK_WAIT_COUNT_LSB"},
-    {0x15, "DDC_RESETN"},
-    {0x16, "HARDWARE_TRIGGER_EN"},
-    {0x1A, "DCLK_SELECT_MANUAL_OR_AUTO"},
-    {0x1B, "DOUT_IN[1],DCLK_MANUAL_SET_VALUE[0]"},
-    {0x1C, "DDC CFGHIGH"},
-    {0x1D, "DDC CFGLOW"},
-    {0x1E, "TRIGGER"},
-    {0x1F, "FORMAT_DIN_CFG"},
-    {0x20, "REG_FREQ_DIV_DIN_CLK_HIGH[3:0],REG_FREQ_DIV_DIN_CLK_LOW[3:0]"},
-    {0x22, "DDC Daughter Card Select"},
-    {0x23, "RESERVED"},
-    {0x24, "RESERVED"},
-    {0x25, "RESERVED"},
-    {0x26, "RESERVED"},
-    //
-    {0x51, "CONV_WAIT_LOW_REG_MSB"},
-    {0x52, "CONV_WAIT_LOW_REG_LSB"},
-    {0x53, "CONV_WAIT_HIGH_REG_MSB"},
-    {0x54, "CONV_WAIT_HIGH_REG_LSB"},
-    {0x55, "NON_CONT"},
-    {0x56, "RESET_CONV"},
-    {0x57, "CONV_CONFIG"},
+    auto Seq = EVM_SeqDataSequence(*CFGHIGH, *CFGLOW);
+    long arraySize = Seq.Length();
+    return (XferDataOut(USBdev, Seq.Bytes, &arraySize) == 0);
+}
+
+// Register names indexed by address, built at compile time. Unlisted addresses are "UNKNOW".
+struct EVM_RegNames
+{
+    const char* Name[EVM_REG_COUNT];
+};
+
+constexpr EVM_RegNames EVM_MakeRegNames()
+{
+    EVM_RegNames T = {};
+    T.Name[EVM_REG_NOOP] = "No Op";
+    T.Name[EVM_REG_CONV_LOW_MSB] = "CONV_LOW_REG_MSB";
+    T.Name[EVM_REG_CONV_LOW_MIDB] = "CONV_LOW_REG_MidB";
+    T.Name[EVM_REG_CONV_LOW_LSB] = "CONV_LOW_REG_LSB";
+    T.Name[EVM_REG_CONV_HIGH_MSB] = "CONV_HIGH_REG_MSB";
+    T.Name[EVM_REG_CONV_HIGH_MIDB] = "CONV_HIGH_REG_MidB";
+    T.Name[EVM_REG_CONV_HIGH_LSB] = "CONV_HIGH_REG_LSB";
+    T.Name[EVM_REG_DIVXCLK] = "DIVXCLK_REGS";
+    T.Name[EVM_REG_DDC_CLK_SEL] = "DDC_CLK_SEL";
+    T.Name[EVM_REG_FORMAT_CHANNELS] = "FORMAT[4],CHANNELS[3:0]";
+    T.Name[EVM_REG_DIVXCLK_DATA] = "DIVXCLK_DATA_REGS";
+    T.Name[EVM_REG_DDC_DATA_CLK_SEL] = "DDC_DATA_CLK_SEL";
+    T.Name[EVM_REG_NDVALIDS_IGNORE] = "nDVALIDS_IGNORE";
+    T.Name[EVM_REG_NDVALIDS_READ_LSB] = "nDVALIDS_READ_LSB";
+    T.Name[EVM_REG_NDVALIDS_READ_MIDB] = "nDVALIDS_READ_MidB";
+    T.Name[EVM_REG_NDVALIDS_READ_MSB] = "nDVALIDS_READ_MSB";
+    T.Name[EVM_REG_CONVERSIONS] = "DONE[1],START_CONVERSIONS[0]";
+    T.Name[EVM_REG_CLK_CFG] = "CLK_CFG";
+    T.Name[EVM_REG_DIN_CFG] = "DIN_CFG";
+    T.Name[EVM_REG_DCLK_WAIT_COUNT_MSB] = "DCLK_WAIT_COUNT_MSB";
+    T.Name[EVM_REG_DCLK_WAIT_COUNT_LSB] = "DCLK_WAIT_COUNT_LSB";
+    T.Name[EVM_REG_DDC_RESETN] = "DDC_RESETN";
+    T.Name[EVM_REG_HARDWARE_TRIGGER_EN] = "HARDWARE_TRIGGER_EN";
+    T.Name[EVM_REG_DCLK_SELECT] = "DCLK_SELECT_MANUAL_OR_AUTO";
+    T.Name[EVM_REG_DOUT_IN_DCLK_MANUAL] = "DOUT_IN[1],DCLK_MANUAL_SET_VALUE[0]";
+    T.Name[EVM_REG_DDC_CFGHIGH] = "DDC CFGHIGH";
+    T.Name[EVM_REG_DDC_CFGLOW] = "DDC CFGLOW";
+    T.Name[EVM_REG_TRIGGER] = "TRIGGER";
+    T.Name[EVM_REG_FORMAT_DIN_CFG] = "FORMAT_DIN_CFG";
+    T.Name[EVM_REG_FREQ_DIV_DIN_CLK] = "REG_FREQ_DIV_DIN_CLK_HIGH[3:0],REG_FREQ_DIV_DIN_CLK_LOW[3:0]";
+    T.Name[EVM_REG_DAUGHTER_CARD_SELECT] = "DDC Daughter Card Select";
+    for (int i = 0x23; i <= 0x26; i++) T.Name[i] = "RESERVED";
     //
-    {0x5E, "FIRMWARE_VERSION_MSB"},
-    {0x5F, "FIRMWARE_VERSION_LSB"},
-    {0xD0, "read_out_trigger"},
-    {0xD1, "RESERVED"},
+    T.Name[EVM_REG_CONV_WAIT_LOW_MSB] = "CONV_WAIT_LOW_REG_MSB";
+    T.Name[EVM_REG_CONV_WAIT_LOW_LSB] = "CONV_WAIT_LOW_REG_LSB";
+    T.Name[EVM_REG_CONV_WAIT_HIGH_MSB] = "CONV_WAIT_HIGH_REG_MSB";
+    T.Name[EVM_REG_CONV_WAIT_HIGH_LSB] = "CONV_WAIT_HIGH_REG_LSB";
+    T.Name[EVM_REG_NON_CONT] = "NON_CONT";
+    T.Name[EVM_REG_RESET_CONV] = "RESET_CONV";
+    T.Name[EVM_REG_CONV_CONFIG] = "CONV_CONFIG";
     //
-    {0xDA, "TRIGGER_READ_AVG_RAM"},
-    {0xDB, "STOP_ADDR_MSB"},
-    {0xDC, "STOP_ADDR_LSB"},
-    {0xDD, "AB_AVG_SEL"},
-    {0xDE, "USE_RAM_CHIPS"},
+    T.Name[EVM_REG_FIRMWARE_VERSION_MSB] = "FIRMWARE_VERSION_MSB";
+    T.Name[EVM_REG_FIRMWARE_VERSION_LSB] = "FIRMWARE_VERSION_LSB";
+    T.Name[EVM_REG_READ_OUT_TRIGGER] = "read_out_trigger";
+    T.Name[EVM_REG_RESERVED_D1] = "RESERVED";
     //
-    {0xE0, "RESERVED"},
-    {0xE1, "RESERVED"},
-    {0xE2, "RESERVED"},
-    {0xE3, "RESERVED"},
-    {0xE4, "RESERVED"},
-    {0xE5, "RESERVED"},
+    T.Name[EVM_REG_TRIGGER_READ_AVG_RAM] = "TRIGGER_READ_AVG_RAM";
+    T.Name[EVM_REG_STOP_ADDR_MSB] = "STOP_ADDR_MSB";
+    T.Name[EVM_REG_STOP_ADDR_LSB] = "STOP_ADDR_LSB";
+    T.Name[EVM_REG_AB_AVG_SEL] = "AB_AVG_SEL";
+    T.Name[EVM_REG_USE_RAM_CHIPS] = "USE_RAM_CHIPS";
     //
-    {0xEB, "CLKDELAY_AROUND_CONV"},
+    for (int i = 0xE0; i <= 0xE5; i++) T.Name[i] = "RESERVED";
     //
-    {0xFF, "SOFT_FPGA_RESET"},
+    T.Name[EVM_REG_CLKDELAY_AROUND_CONV] = "CLKDELAY_AROUND_CONV";
     //
-    //Default "UNKNOW"
-};
+    T.Name[EVM_REG_SOFT_FPGA_RESET] = "SOFT_FPGA_RESET";
+    return T;
+}
+
+constexpr EVM_RegNames RegNameTable = EVM_MakeRegNames();
 
 int __stdcall EVM_RegNameTable(int RegN, char* buf, int bufsize)
 {
     int textSize;
-    const char* RegName = RegNameTable[RegN];
-    if (RegName != nullptr) {
-        textSize = min((size_t)bufsize, strlen(RegName));
-        memcpy(buf, RegName, textSize);
-    }
-    else {
-        textSize = min((size_t)bufsize, strlen("UNKNOW"));
-        memcpy(buf, "UNKNOW", textSize);
-    }
+    const char* RegName = (RegN >= 0 && RegN < EVM_REG_COUNT) ? RegNameTable.Name[RegN] : nullptr;
+    if (RegName == nullptr) RegName = "UNKNOW";
+    textSize = min((size_t)bufsize, strlen(RegName));
+    memcpy(buf, RegName, textSize);
     buf[textSize] = 0;
     return textSize;
 }
 
 
-long __stdcall EVM_RegsTransfer(int* USBdev, int* RegsIn, int* RegEnable, int* RegsOut) {
+// Stores the (address, value) pairs of a register readback block into RegsOut and the register cache of Board
+static void ParseRegsReadback(EVM_Board& Board, const unsigned char* Data, long DataLen, int* RegsOut)
+{
+    bool Conv = false;
+    Board.Note(Data, DataLen);
+    for (long i = 0; i + 1 < DataLen; i += 2)
+    {
+        RegsOut[Data[i]] = Data[i + 1];
+        if (Data[i] >= EVM_REG_CONV_LOW_MSB && Data[i] <= EVM_REG_CONV_HIGH_LSB) Conv = true;
+    }
+    // The integration times of the board, for the timing of the captures
+    if (Conv) EVM_NoteConvRegisters(RegsOut);
+}
 
-    CCyUSBDevice* USBDevice = new CCyUSBDevice(NULL);
+// Writes the enabled registers and reads them all back into RegsOut. While a stream reads the board the writes
+// are sent by its reader between two transfers and RegsOut comes from the register cache, the values last
+// written or read back; the unknown ones are left as they are.
+long __stdcall EVM_RegsTransfer(int* USBdev, int* RegsIn, int* RegEnable, int* RegsOut) {
 
+    EVM_TRACE_SCOPE("RegsTransfer");
     bool XferSuccess;
     int AllowedWaitCount;
 
     long DataLen;
-    unsigned char DataStr[512];
-    unsigned char* Data = (unsigned char*)calloc(2048, sizeof(unsigned char));
-    if (Data == NULL) return -3;
+    EVM_PacketBuf<EVM_REG_COUNT> Writes;
+    EVM_PacketBuf<EVM_REG_COUNT + 2> DataStr;
 
-    DataLen = 2;
-    DataStr[0] = (char)0x00;
-    DataStr[1] = (char)0x00;
+    for (int i = 0; i < EVM_REG_COUNT; i++)
+    {
+        if (RegEnable[i] == 1) Writes.Put((byte)i, (byte)RegsIn[i]);
+    }
 
-    for (int i = 0; i < 256; i++)
+    EVM_Exchange Exchange(USBdev[0], Writes.Bytes, Writes.Length, CONTROL_TIMEOUT_MS);
+    if (!Exchange.Held)
     {
-        if (RegEnable[i] == 1)
+        if (Exchange.Result == 0 && RegsOut != nullptr)
         {
-            DataStr[DataLen] = (char)i;
-            DataStr[DataLen + 1] = (char)RegsIn[i];
-            DataLen += 2;
+            int Cached[EVM_REG_COUNT];
+            Exchange.Board.Registers(Cached);
+            for (int i = 0; i < EVM_REG_COUNT; i++) if (Cached[i] >= 0) RegsOut[i] = Cached[i];
         }
+        return(Exchange.Result);
     }
 
-    DataStr[DataLen] = (char)0xD0;  //D0 is the opcode to start/stop reading the FPGA registers
-    DataStr[DataLen + 1] = (char)0x00;
-    DataLen += 2;
+    CCyUSBDevice* USBDevice = new CCyUSBDevice(NULL);
+    EVM_ScratchBuffer Scratch;
+    unsigned char* Data = Scratch.Data();
+
+    DataStr.Put(EVM_SEQ_NOP);
+    for (long i = 0; i + 1 < Writes.Length; i += 2) DataStr.Put(Writes.Bytes[i], Writes.Bytes[i + 1]);
+    DataStr.Put(EVM_SEQ_READ_REGS_STOP);
 
-    if (USBDevice->Open(USBdev[0]))
+    if (EVM_OpenDevice(USBDevice, USBdev[0]))
     {
         //Write the Data Str
         if (USBDevice->BulkOutEndPt)
         {
+            EVM_TRACE_SCOPE_ARG("write", DataStr.Length);
+            DataLen = DataStr.Length;
             USBDevice->BulkOutEndPt->TimeOut = 100;
-            USBDevice->BulkOutEndPt->XferData(DataStr, DataLen);
+            if (USBDevice->BulkOutEndPt->XferData(DataStr.Bytes, DataLen)) Exchange.Board.Note(Writes.Bytes, Writes.Length);
         }
         else
         {
@@ -391,84 +402,71 @@ long __stdcall EVM_RegsTransfer(int* USBdev, int* RegsIn, int* RegEnable, int* R
         DataLen = 2048;
         XferSuccess = true;
         AllowedWaitCount = 16383;
-        while (XferSuccess == true && AllowedWaitCount > 0)
         {
-            if (USBDevice->BulkInEndPt)
-            {
-                USBDevice->BulkInEndPt->TimeOut = 50; //500ms = 0.5s
-                USBDevice->BulkInEndPt->SetXferSize(DataLen);
-                XferSuccess = USBDevice->BulkInEndPt->XferData(Data, DataLen);
-            }
-            else
+            EVM_TRACE_SCOPE("drain");
+            while (XferSuccess == true && AllowedWaitCount > 0)
             {
-                USBDevice->Close();
-                return(-10);  //-10 means couldn't open USB endpoint
+                if (USBDevice->BulkInEndPt)
+                {
+                    USBDevice->BulkInEndPt->TimeOut = 50; //500ms = 0.5s
+                    USBDevice->BulkInEndPt->SetXferSize(DataLen);
+                    XferSuccess = USBDevice->BulkInEndPt->XferData(Data, DataLen);
+                }
+                else
+                {
+                    USBDevice->Close();
+                    return(-10);  //-10 means couldn't open USB endpoint
+                }
+                AllowedWaitCount--;
             }
-            AllowedWaitCount--;
         }
 
         if (XferSuccess) return(-5); //Never timed out, probably more data in the pipe.
 
         //Write the "Read FPGA Register" opcode: D001
-        DataStr[0] = char(0xD0);  //D0 is the opcode to start/stop reading the FPGA registers
-        DataStr[1] = char(0x01);
-        DataLen = 2;
-        if (USBDevice->BulkOutEndPt)
-        {
-            USBDevice->BulkOutEndPt->TimeOut = 100;
-            USBDevice->BulkOutEndPt->XferData(DataStr, DataLen);
-        }
-        else
-        {
-            USBDevice->Close();
-            return(-9);  //-9 means couldn't open USB endpoint
-        }
-
-        //Read the Data back
-        if (RegsOut != nullptr)
         {
-            if (USBDevice->BulkInEndPt)
+            EVM_TRACE_SCOPE("readback");
+            if (USBDevice->BulkOutEndPt)
             {
-                USBDevice->BulkInEndPt->TimeOut = 100; //500ms = 0.5s
-                DataLen = 512;
-                XferSuccess = USBDevice->BulkInEndPt->XferData(Data, DataLen);
+                auto Seq = EVM_SEQ_READ_REGS_START;
+                DataLen = Seq.Length();
+                USBDevice->BulkOutEndPt->TimeOut = 100;
+                USBDevice->BulkOutEndPt->XferData(Seq.Bytes, DataLen);
             }
             else
             {
                 USBDevice->Close();
-                return(-10);  //-10 means couldn't open USB endpoint
+                return(-9);  //-9 means couldn't open USB endpoint
             }
 
-            for (long i = 0; i < (2 * (DataLen - 1)); i += 2)
+            //Read the Data back
+            if (RegsOut != nullptr)
             {
-                if (((long)Data[i]) < 256)
+                if (USBDevice->BulkInEndPt)
+                {
+                    USBDevice->BulkInEndPt->TimeOut = 100; //500ms = 0.5s
+                    DataLen = 512;
+                    XferSuccess = USBDevice->BulkInEndPt->XferData(Data, DataLen);
+                }
+                else
                 {
-                    RegsOut[((int)Data[i])] = ((int)Data[i + 1]);
+                    USBDevice->Close();
+                    return(-10);  //-10 means couldn't open USB endpoint
                 }
+
+                ParseRegsReadback(Exchange.Board, Data, DataLen, RegsOut);
             }
         }
 
         //Stop the "Read FPGA Register" opcode: D000
         //then reset CONV with 5600 and 5601
-        DataStr[0] = char(0xD0);  //D0 is the opcode to start/stop reading the FPGA registers
-        DataStr[1] = char(0x00);
-
-        DataStr[2] = char(0x00);
-        DataStr[3] = char(0x00);
-
-        DataStr[4] = char(0x56);
-        DataStr[5] = char(0x00);
-
-        DataStr[6] = char(0x00);
-        DataStr[7] = char(0x00);
-
-        DataStr[8] = char(0x56);
-        DataStr[9] = char(0x01);
-        DataLen = 10;
         if (USBDevice->BulkOutEndPt)
         {
+            EVM_TRACE_SCOPE("reset conv");
+            auto Seq = EVM_SEQ_RESET_CONV;
+            DataLen = Seq.Length();
             USBDevice->BulkOutEndPt->TimeOut = 100;
-            USBDevice->BulkOutEndPt->XferData(DataStr, DataLen);
+            USBDevice->BulkOutEndPt->XferData(Seq.Bytes, DataLen);
         }
         else
         {
@@ -488,52 +486,162 @@ long __stdcall EVM_RegsTransfer(int* USBdev, int* RegsIn, int* RegEnable, int* R
 }
 
 
-long __stdcall EVM_DataCap(int* USBdev, int Channels, int nDVALIDReads, int* DataArray, int* AllDataAorBfirst) {
+bool SendPacket(CCyUSBDevice* USBDevice, unsigned char* Bytes, long Length, ULONG TimeOut)
+{
+    EVM_TRACE_SCOPE_ARG("command", Length);
+    USBDevice->BulkOutEndPt->TimeOut = TimeOut;
+    return USBDevice->BulkOutEndPt->XferData(Bytes, Length);
+}
+
+bool DrainBulkIn(CCyUSBDevice* USBDevice, unsigned char* Buffer, long BufLen, ULONG TimeOut, int AllowedWaitCount)
+{
+    EVM_TRACE_SCOPE("drain");
+    bool XferSuccess = true;
+    while (XferSuccess == true && AllowedWaitCount > 0)
+    {
+        long Len = BufLen;
+        USBDevice->BulkInEndPt->TimeOut = TimeOut;
+        USBDevice->BulkInEndPt->SetXferSize(BufLen);
+        XferSuccess = USBDevice->BulkInEndPt->XferData(Buffer, Len);
+        AllowedWaitCount--;
+    }
+    return !XferSuccess;
+}
 
-    long LenVar;
-    unsigned char inputCmd[2];
-    bool XferSuccess;
-    long StringLen, StringLenRet;
-    long BytesOfData;
-    int AllowedWaitCount;
-    long BytesRead;
-    long DAi;
 
-    StringLen = STRINGLEN;
-    StringLenRet = STRINGLEN;
+
+bool ReadTransfer(CCyUSBDevice* USBDevice, unsigned char* Buffer, long& Len, ULONG TimeOut, int AllowedWaitCount)
+{
+    EVM_TRACE_SCOPE("transfer");
+    long BufLen = Len;
+    bool XferSuccess = false;
+    while (XferSuccess == false && AllowedWaitCount > 0)
+    {
+        Len = BufLen;
+        USBDevice->BulkInEndPt->TimeOut = TimeOut;
+        XferSuccess = USBDevice->BulkInEndPt->XferData(Buffer, Len);
+        AllowedWaitCount--;
+    }
+    return XferSuccess;
+}
+
+// Reads the data of a conversion already started with 0x10FF into DataArray, converted as described by Conv.
+// Every transfer is stamped into the capture timing of the thread, set up by the caller.
+// Returns 0, -4 on timeout, -8 on a transfer not multiple of 4 bytes.
+static long ReadCapture(CCyUSBDevice* USBDevice, unsigned char* DataCap, long BytesOfData, void* DataArray,
+    const EVM_Conversion& Conv, int* AllDataAorBfirst)
+{
+    long Rows = (Conv.Channels > 0) ? (BytesOfData / 4) / Conv.Channels : 0;
+    long StringLenRet;
+    long BytesRead = 0;
+    EVM_TimingFit& Timing = EVM_CaptureTiming();
+
+    DEBUGECHO("Read first bunch of data");
+
+    {
+        // From the start command to the first data, the latency of the board
+        EVM_TRACE_SCOPE("first read");
+        StringLenRet = STRINGLEN;
+        USBDevice->BulkInEndPt->SetXferSize(STRINGLEN);
+        if (!ReadTransfer(USBDevice, DataCap, StringLenRet, 10000, 3)) return(-4);  //1000 = 1s
+    }
+    double Stamp = EVM_Now();
+    if (StringLenRet % 4 != 0) return(-8);
+
+    AllDataAorBfirst[0] = (DataCap[0] == 128) ? 0 : 1;
+    Timing.NewFrame(AllDataAorBfirst[0]);
+    Timing.Add(min(StringLenRet, BytesOfData) / 4, Stamp);
+
+    {
+        EVM_TRACE_SCOPE_ARG("decode", min(StringLenRet, BytesOfData));
+        DecodeSamples(DataCap, min(StringLenRet, BytesOfData), 0, DataArray, Rows, Conv);
+    }
+    BytesRead += StringLenRet;
+
+    DEBUGECHO("Read main bunch of data");
+
+    EVM_TRACE_SCOPE_ARG("read loop", BytesOfData - min(BytesRead, BytesOfData));
+    while (BytesRead < BytesOfData)
+    {
+        StringLenRet = STRINGLEN;
+        if (!ReadTransfer(USBDevice, DataCap, StringLenRet, 250, 40)) return(-4);  //10s at 250
+        Timing.Add(min(BytesRead + StringLenRet, BytesOfData) / 4, EVM_Now());
+        if (StringLenRet % 4 != 0) return(-8);
+
+        EVM_TRACE_SCOPE_ARG("decode", min(StringLenRet, BytesOfData - BytesRead));
+        DecodeSamples(DataCap, min(StringLenRet, BytesOfData - BytesRead), BytesRead / 4, DataArray, Rows, Conv);
+        BytesRead += StringLenRet;
+    }
+
+    return(0);
+}
+
+// Same as ReadCapture but keeps the raw words in Raw, which must hold BytesOfData + STRINGLEN: after a short
+// transfer the next one still asks for a whole STRINGLEN and may end that far past BytesOfData.
+// FirstData is stamped when the first transfer completes, and every transfer into the capture timing.
+static long ReadRawCapture(CCyUSBDevice* USBDevice, unsigned char* Raw, long BytesOfData, LARGE_INTEGER* FirstData)
+{
+    long StringLenRet;
+    long BytesRead = 0;
+    EVM_TimingFit& Timing = EVM_CaptureTiming();
+
+    {
+        EVM_TRACE_SCOPE("first read");
+        StringLenRet = STRINGLEN;
+        USBDevice->BulkInEndPt->SetXferSize(STRINGLEN);
+        if (!ReadTransfer(USBDevice, Raw, StringLenRet, 10000, 3)) return(-4);
+    }
+    QueryPerformanceCounter(FirstData);
+    if (StringLenRet % 4 != 0) return(-8);
+    Timing.NewFrame((Raw[0] == 128) ? 0 : 1);
+    Timing.Add(min(StringLenRet, BytesOfData) / 4, EVM_Now());
+    BytesRead += StringLenRet;
+
+    EVM_TRACE_SCOPE_ARG("read loop", BytesOfData - min(BytesRead, BytesOfData));
+    while (BytesRead < BytesOfData)
+    {
+        StringLenRet = STRINGLEN;
+        if (!ReadTransfer(USBDevice, Raw + BytesRead, StringLenRet, 250, 40)) return(-4);
+        Timing.Add(min(BytesRead + StringLenRet, BytesOfData) / 4, EVM_Now());
+        if (StringLenRet % 4 != 0) return(-8);
+        BytesRead += StringLenRet;
+    }
+
+    return(0);
+}
+
+
+// Stops, drains, starts a conversion and reads it into DataArray, converted as described by Conv
+static long DataCapture(int* USBdev, int Channels, int nDVALIDReads, void* DataArray, const EVM_Conversion& Conv, int* AllDataAorBfirst)
+{
+    auto StopCmd = EVM_SEQ_STOP_CONVERSIONS;
+    auto NopCmd = EVM_SEQ_NOP;
+    auto StartCmd = EVM_SEQ_START_CONVERSIONS;
+    long BytesOfData;
+    long Result;
 
     //Number of readings = channels * nDVALID Reads
     //Number of readings per channel = nDVALID Reads / 2
     //Bytes of data = Number of readings * 4
     BytesOfData = Channels * nDVALIDReads * 4;
 
-    int WorkingTemp;
-    unsigned char DataCap[STRINGLEN];
+    EVM_TRACE_SCOPE_ARG("DataCap", BytesOfData);
+    EVM_Exchange Exchange(USBdev[0]);
+    if (!Exchange.Held) return(Exchange.Result);
+
+    EVM_ScratchBuffer Scratch;
+    unsigned char* Raw = Scratch.Data();
 
     CCyUSBDevice* USBDevice = new CCyUSBDevice(NULL);   // Create an instance of CCyUSBDevice
 
-    if (USBDevice->Open(USBdev[0]))
+    if (EVM_OpenDevice(USBDevice, USBdev[0]))
     {
 
         if (USBDevice->BulkOutEndPt)   //shifts out 0x1000, which stops all conversions
         {
-            inputCmd[0] = 0x10;
-            inputCmd[1] = 0x00;
-            LenVar = 2;
-            USBDevice->BulkOutEndPt->TimeOut = 250;
-            XferSuccess = USBDevice->BulkOutEndPt->XferData(inputCmd, LenVar);
-            if (XferSuccess == false)
-            {
-                USBDevice->Close();
-                return(-5);
-            }
-
-            inputCmd[0] = 0x00;
-            inputCmd[1] = 0x00;
-            LenVar = 2;
-            USBDevice->BulkOutEndPt->TimeOut = 250;
-            XferSuccess = USBDevice->BulkOutEndPt->XferData(inputCmd, LenVar);
-            if (XferSuccess == false)
+            EVM_TRACE_SCOPE("stop");
+            if (!SendPacket(USBDevice, StopCmd.Bytes, StopCmd.Length(), 250) ||
+                !SendPacket(USBDevice, NopCmd.Bytes, NopCmd.Length(), 250))
             {
                 USBDevice->Close();
                 return(-5);
@@ -544,134 +652,494 @@ long __stdcall EVM_DataCap(int* USBdev, int Channels, int nDVALIDReads, int* Dat
 
         if (USBDevice->BulkInEndPt)  //emptys read buffer
         {
-            StringLenRet = StringLen;
-            XferSuccess = true;
-            AllowedWaitCount = 32;
-            while (XferSuccess == true && AllowedWaitCount > 0)
-            {
-                USBDevice->BulkInEndPt->TimeOut = 250;  //1000 = 1s
-                USBDevice->BulkInEndPt->SetXferSize(StringLen);
-                XferSuccess = USBDevice->BulkInEndPt->XferData(DataCap, StringLenRet);
-                AllowedWaitCount--;
-            }
+            DrainBulkIn(USBDevice, Raw, STRINGLEN, 250, 32);
         }
 
         DEBUGECHO("Starts a conversion");
 
         if (USBDevice->BulkOutEndPt)    //shifts out 0x10FF, which starts a conversion
         {
-            inputCmd[0] = 0x10;
-            inputCmd[1] = 0xFF;
-            LenVar = 2;
-            USBDevice->BulkOutEndPt->TimeOut = 250;
-            XferSuccess = USBDevice->BulkOutEndPt->XferData(inputCmd, LenVar);
-            if (XferSuccess == false)
+            EVM_TRACE_SCOPE("start");
+            if (!SendPacket(USBDevice, StartCmd.Bytes, StartCmd.Length(), 250))
             {
                 USBDevice->Close();
                 return(-5);
             }
         }
 
-        BytesRead = 0;
-        if (USBDevice->BulkInEndPt)
+        if (!USBDevice->BulkInEndPt)
         {
+            USBDevice->Close();
+            return(-10);
+        }
 
-            DEBUGECHO("Read first bunch of data");
-
-            XferSuccess = false;
-            AllowedWaitCount = 3; //10s at 250
-            while (XferSuccess == false && AllowedWaitCount > 0)
-            {
-                StringLenRet = StringLen;
-                USBDevice->BulkInEndPt->TimeOut = 10000;  //1000 = 1s
-                USBDevice->BulkInEndPt->SetXferSize(StringLen);
-                XferSuccess = USBDevice->BulkInEndPt->XferData(DataCap, StringLenRet);
-                AllowedWaitCount--;
-            }
+        EVM_CaptureTiming().Reset(Channels);
+        Result = ReadCapture(USBDevice, Raw, BytesOfData, DataArray, Conv, AllDataAorBfirst);
+        if (Result != 0)
+        {
+            USBDevice->Close();
+            return(Result);
+        }
 
-            if (XferSuccess == false)
+        if (USBDevice->BulkOutEndPt) //shifts out 0x1000, which lets the conversion end
+        {
+            EVM_TRACE_SCOPE("stop");
+            if (!SendPacket(USBDevice, StopCmd.Bytes, StopCmd.Length(), 250))
             {
                 USBDevice->Close();
-                return(-4);
+                return(-6);
             }
+        }
+        USBDevice->Close();
+    }
+    else
+    {
+        return(-2); //-2 means it couldn't open the USB device.
+    }
 
-            if (StringLenRet % 4 != 0)
-            {
-                USBDevice->Close();
-                return(-8);
-            }
+    return(0);
+}
 
-            AllDataAorBfirst[0] = (DataCap[0] == 128) ? 0 : 1;
 
-            DAi = 0;
-            for (long j = 0; j < StringLenRet; j += 4)
-            {
-                WorkingTemp = DataCap[j + 1] * 0x10000 + DataCap[j + 2] * 0x100 + DataCap[j + 3];
-                DataArray[DAi] = WorkingTemp;
-                DAi++;
-            }
-            BytesRead += StringLenRet;
+long __stdcall EVM_DataCap(int* USBdev, int Channels, int nDVALIDReads, int* DataArray, int* AllDataAorBfirst) {
+
+    return DataCapture(USBdev, Channels, nDVALIDReads, DataArray, EVM_RawConversion(), AllDataAorBfirst);
+}
+
+
+// Same as EVM_DataCap with the samples delivered as SampleType (EVM_SAMPLE_xxx), optionally or'ed with
+// EVM_LAYOUT_CHANNEL_MAJOR. The float types are scaled to pC with the range and format bits of CFGHIGH.
+// EVM_SAMPLE_UINT16 is only valid in 16 bits format. The decoder for the combination is picked once here.
+long __stdcall EVM_DataCapEx(int* USBdev, int Channels, int nDVALIDReads, int SampleType, byte* CFGHIGH,
+    void* DataArray, int* AllDataAorBfirst)
+{
+    EVM_Conversion Conv = EVM_MakeConversion(SampleType, *CFGHIGH, Channels);
+    if (Conv.Fn == nullptr) return(-7);
+
+    return DataCapture(USBdev, Channels, nDVALIDReads, DataArray, Conv, AllDataAorBfirst);
+}
+
+
+// Same as EVM_DataCapEx keeping only the nSelected channels of ChannelList, in that order. DataArray receives
+// nSelected * nDVALIDReads samples; the unselected words are never written anywhere.
+long __stdcall EVM_DataCapROI(int* USBdev, int Channels, int nDVALIDReads, int SampleType, byte* CFGHIGH,
+    int nSelected, int* ChannelList, void* DataArray, int* AllDataAorBfirst)
+{
+    EVM_Roi Roi;
+    if (!EVM_MakeRoi(Roi, Channels, nSelected, ChannelList)) return(-7);
+
+    EVM_Conversion Conv = EVM_MakeConversion(SampleType, *CFGHIGH, Channels);
+    EVM_ApplyRoi(Conv, &Roi);
+    if (Conv.Fn == nullptr) return(-7);
+
+    return DataCapture(USBdev, Channels, nDVALIDReads, DataArray, Conv, AllDataAorBfirst);
+}
+
+
+// Builds the gather table of an image of nPixels pixels for EVM_DataCapImage and EVM_StreamSetImage.
+// PixelMap holds the physical channel of each pixel in row major order, chip * (Channels / nChips) + channel
+// of the chip, or -1 for a pixel without channel. Chip c arrives in position ChipOrder[c] of the data, as set
+// by the daughter card select register; nChips 0 or ChipOrder null keeps the order. The pixels of the nDead
+// DeadChannels are masked. Gather receives the channel of the data shown by each pixel, -1 if masked.
+// Returns the pixels with a channel, -7 if a map entry, the chip order or a dead channel is not valid.
+long __stdcall EVM_MapPixels(int Channels, int nPixels, int* PixelMap, int nChips, int* ChipOrder,
+    int nDead, int* DeadChannels, int* Gather)
+{
+    if (Channels <= 0 || nPixels <= 0 || PixelMap == nullptr || Gather == nullptr || nDead < 0) return(-7);
+    if (nChips < 0 || (nChips > 0 && Channels % nChips != 0) || (nDead > 0 && DeadChannels == nullptr)) return(-7);
+
+    // Data position of every physical channel, -1 once dead
+    std::vector<int> Data(Channels);
+    const bool Reorder = (nChips > 0 && ChipOrder != nullptr);
+    const int nSlots = Reorder ? nChips : 1;
+    const int ChipChannels = Channels / nSlots;
+    std::vector<bool> Taken(nSlots, false);
+    for (int c = 0; c < nSlots; c++)
+    {
+        int Slot = Reorder ? ChipOrder[c] : 0;
+        if (Slot < 0 || Slot >= nSlots || Taken[Slot]) return(-7);
+        Taken[Slot] = true;
+        for (int ch = 0; ch < ChipChannels; ch++) Data[c * ChipChannels + ch] = Slot * ChipChannels + ch;
+    }
+    for (int d = 0; d < nDead; d++)
+    {
+        if (DeadChannels[d] < 0 || DeadChannels[d] >= Channels) return(-7);
+        Data[DeadChannels[d]] = -1;
+    }
+
+    long Mapped = 0;
+    for (int p = 0; p < nPixels; p++)
+    {
+        if (PixelMap[p] < -1 || PixelMap[p] >= Channels) return(-7);
+        Gather[p] = (PixelMap[p] >= 0) ? Data[PixelMap[p]] : -1;
+        if (Gather[p] >= 0) Mapped++;
+    }
+    return(Mapped);
+}
+
+
+// Same as EVM_DataCapEx delivering every DVALID as a Width x Height image in row major order, built from the
+// Gather table of EVM_MapPixels while decoding: Images receives nDVALIDReads images one after the other, with the
+// masked pixels set to 0, NaN for the float types. Returns -7 if a channel shows in two pixels.
+long __stdcall EVM_DataCapImage(int* USBdev, int Channels, int nDVALIDReads, int SampleType, byte* CFGHIGH,
+    int Width, int Height, int* Gather, void* Images, int* AllDataAorBfirst)
+{
+    EVM_Roi Roi;
+    if (Width <= 0 || Height <= 0 || !EVM_MakeImageRoi(Roi, Channels, Width * Height, Gather)) return(-7);
+
+    EVM_Conversion Conv = EVM_MakeConversion(SampleType & EVM_SAMPLE_TYPE_MASK, *CFGHIGH, Channels);
+    EVM_ApplyRoi(Conv, &Roi);
+    if (Conv.Fn == nullptr) return(-7);
+
+    return DataCapture(USBdev, Channels, nDVALIDReads, Images, Conv, AllDataAorBfirst);
+}
+
+
+// Reset, configuration and capture in a single device session. Each command goes in its own packet, in the
+// order and with the drains of EVM_ResetDDC, EVM_ClearTriggers, EVM_DataSequence, EVM_RegsTransfer and EVM_DataCap
+// called one after the other, so the board sees the same gaps: only the opening of the device for each is saved.
+// With RegsOut the registers are read back and the enabled ones compared with RegsIn, returning -11 on any mismatch.
+long __stdcall EVM_ConfigureAndCapture(int* USBdev, byte* CFGHIGH, byte* CFGLOW, int* RegsIn, int* RegEnable, int* RegsOut,
+    int Channels, int nDVALIDReads, int* DataArray, int* AllDataAorBfirst)
+{
+    EVM_PacketBuf<EVM_REG_COUNT + 2> Writes;
+    auto StopNopCmd = EVM_Concat(EVM_SEQ_STOP_CONVERSIONS, EVM_SEQ_NOP);
+    auto ResetCmd = EVM_SEQ_RESET_DDC;
+    auto ClearCmd = EVM_SEQ_CLEAR_TRIGGERS;
+    auto SequenceCmd = EVM_SeqDataSequence(*CFGHIGH, *CFGLOW);
+    auto ArmCmd = EVM_SEQ_RESET_CONV_AND_STOP;
+    auto StartCmd = EVM_SEQ_START_CONVERSIONS;
+    auto StopCmd = EVM_SEQ_STOP_CONVERSIONS;
+    bool Verify = (RegsOut != nullptr);
+    long BytesOfData = Channels * nDVALIDReads * 4;
+    long Result;
+
+    Writes.Put(EVM_SEQ_NOP);
+    for (int i = 0; i < EVM_REG_COUNT; i++)
+    {
+        if (RegEnable[i] == 1) Writes.Put((byte)i, (byte)RegsIn[i]);
+    }
+    Writes.Put(EVM_SEQ_READ_REGS_STOP);
+
+    EVM_TRACE_SCOPE_ARG("ConfigureAndCapture", BytesOfData);
+    EVM_Exchange Exchange(USBdev[0]);
+    if (!Exchange.Held) return(Exchange.Result);
+
+    EVM_ScratchBuffer DataCap;
+    std::unique_ptr<CCyUSBDevice> USBDevice(new CCyUSBDevice(NULL));
+
+    if (!EVM_OpenDevice(USBDevice.get(), USBdev[0])) return(-2);
+    if (!USBDevice->BulkOutEndPt) { USBDevice->Close(); return(-9); }
+    if (!USBDevice->BulkInEndPt) { USBDevice->Close(); return(-10); }
+
+    DEBUGECHO("Reset and configure");
+
+    if (!SendPacket(USBDevice.get(), StopNopCmd.Bytes, StopNopCmd.Length(), 250) ||
+        !SendPacket(USBDevice.get(), ResetCmd.Bytes, ResetCmd.Length(), 100) ||
+        !SendPacket(USBDevice.get(), ClearCmd.Bytes, ClearCmd.Length(), 100) ||
+        !SendPacket(USBDevice.get(), SequenceCmd.Bytes, SequenceCmd.Length(), 100) ||
+        !SendPacket(USBDevice.get(), Writes.Bytes, Writes.Length, 100) ||
+        !DrainBulkIn(USBDevice.get(), DataCap.Data(), STRINGLEN, 50, 32))
+    {
+        USBDevice->Close();
+        return(-5);
+    }
+    Exchange.Board.Note(ResetCmd.Bytes, ResetCmd.Length());
+    Exchange.Board.Note(ClearCmd.Bytes, ClearCmd.Length());
+    Exchange.Board.Note(SequenceCmd.Bytes, SequenceCmd.Length());
+    Exchange.Board.Note(Writes.Bytes, Writes.Length);
+
+    if (Verify)
+    {
+        DEBUGECHO("Read back registers");
+        EVM_TRACE_SCOPE("readback");
+
+        auto ReadCmd = EVM_SEQ_READ_REGS_START;
+        long DataLen = 512;
+        bool Match = true;
+
+        if (!SendPacket(USBDevice.get(), ReadCmd.Bytes, ReadCmd.Length(), 100))
+        {
+            USBDevice->Close();
+            return(-5);
         }
-        else
+        USBDevice->BulkInEndPt->TimeOut = 100;
+        if (USBDevice->BulkInEndPt->XferData(DataCap.Data(), DataLen)) ParseRegsReadback(Exchange.Board, DataCap.Data(), DataLen, RegsOut);
+        else Match = false;
+
+        for (int i = 0; i < EVM_REG_COUNT && Match; i++)
         {
+            if (RegEnable[i] == 1 && (RegsOut[i] & 0xFF) != (RegsIn[i] & 0xFF)) Match = false;
+        }
+        if (!Match)
+        {
+            SendPacket(USBDevice.get(), ArmCmd.Bytes, ArmCmd.Length(), 250);
             USBDevice->Close();
-            return(-10);
+            return(-11);
         }
+    }
 
-        DEBUGECHO("Read main bunch of data");
+    // The CONV reset, then the board is left to settle as long as the drain of EVM_DataCap before the start
+    DEBUGECHO("Empty buffer");
 
-        while (BytesRead < BytesOfData)
-        {
-            StringLenRet = StringLen;
-            XferSuccess = false;
-            AllowedWaitCount = 40; //10s at 250
-            while (XferSuccess == false && AllowedWaitCount > 0)
-            {
-                USBDevice->BulkInEndPt->TimeOut = 250;
-                XferSuccess = USBDevice->BulkInEndPt->XferData(DataCap, StringLenRet);
-                AllowedWaitCount--;
-            }
-            if (XferSuccess == false)
-            {
-                USBDevice->Close();
-                return(-4);
-            }
+    if (!SendPacket(USBDevice.get(), ArmCmd.Bytes, ArmCmd.Length(), 250) ||
+        !DrainBulkIn(USBDevice.get(), DataCap.Data(), STRINGLEN, 250, 32))
+    {
+        USBDevice->Close();
+        return(-5);
+    }
+    Exchange.Board.Note(ArmCmd.Bytes, ArmCmd.Length());
 
-            BytesRead += StringLenRet;
+    DEBUGECHO("Starts a conversion");
 
-            if (StringLenRet % 4 != 0)
-            {
-                USBDevice->Close();
-                return(-8);
-            }
+    if (!SendPacket(USBDevice.get(), StartCmd.Bytes, StartCmd.Length(), 250))
+    {
+        USBDevice->Close();
+        return(-5);
+    }
 
-            for (long j = 0; j < StringLenRet; j += 4)
-            {
-                WorkingTemp = DataCap[j + 1] * 0x10000 + DataCap[j + 2] * 0x100 + DataCap[j + 3];
-                DataArray[DAi] = WorkingTemp;
-                DAi++;
-            }
-        }
+    EVM_CaptureTiming().Reset(Channels);
+    Result = ReadCapture(USBDevice.get(), DataCap.Data(), BytesOfData, DataArray, EVM_RawConversion(), AllDataAorBfirst);
+    if (Result != 0)
+    {
+        USBDevice->Close();
+        return(Result);
+    }
 
-        if (USBDevice->BulkOutEndPt) //shifts out 0x1000, which lets the conversion end
+    if (!SendPacket(USBDevice.get(), StopCmd.Bytes, StopCmd.Length(), 250))
+    {
+        USBDevice->Close();
+        return(-6);
+    }
+    USBDevice->Close();
+
+    return(0);
+}
+
+
+// Milliseconds a drain between the captures of a burst waits for more words. The conversions are stopped
+// by then and only what is left in the FIFO comes, so it can be much shorter than the drain of EVM_DataCap.
+static const ULONG REARM_DRAIN_MS = 10;
+
+// Opens USBdev for a burst of captures and starts the first conversion: stop, drain, start. Buffer takes the
+// drained words and must hold STRINGLEN. Returns 0, -2 if it can't open the device, -9/-10 for a missing
+// endpoint or -5; the device is left closed on error.
+static long BurstOpen(CCyUSBDevice* USBDevice, int USBdev, unsigned char* Buffer)
+{
+    auto StartCmd = EVM_SEQ_START_CONVERSIONS;
+    auto StopNopCmd = EVM_Concat(EVM_SEQ_STOP_CONVERSIONS, EVM_SEQ_NOP);
+
+    if (!EVM_OpenDevice(USBDevice, USBdev)) return(-2);
+    if (!USBDevice->BulkOutEndPt) { USBDevice->Close(); return(-9); }
+    if (!USBDevice->BulkInEndPt) { USBDevice->Close(); return(-10); }
+
+    DEBUGECHO("Empty buffer");
+
+    if (!SendPacket(USBDevice, StopNopCmd.Bytes, StopNopCmd.Length(), 250))
+    {
+        USBDevice->Close();
+        return(-5);
+    }
+    DrainBulkIn(USBDevice, Buffer, STRINGLEN, 250, 32);
+
+    if (!SendPacket(USBDevice, StartCmd.Bytes, StartCmd.Length(), 250))
+    {
+        USBDevice->Close();
+        return(-5);
+    }
+    return(0);
+}
+
+// Ends a capture of the burst and starts the next one. The words converted after the last transfer read are
+// still in the FIFO when the stop arrives; they are drained before the start, else they would lead the next
+// capture and shift its channels and A/B side. Returns 0 or -5.
+long BurstRearm(CCyUSBDevice* USBDevice, unsigned char* Buffer)
+{
+    auto StartCmd = EVM_SEQ_START_CONVERSIONS;
+    auto StopNopCmd = EVM_Concat(EVM_SEQ_STOP_CONVERSIONS, EVM_SEQ_NOP);
+
+    EVM_TRACE_SCOPE("rearm");
+    if (!SendPacket(USBDevice, StopNopCmd.Bytes, StopNopCmd.Length(), 250)) return(-5);
+    DrainBulkIn(USBDevice, Buffer, STRINGLEN, REARM_DRAIN_MS, 32);
+    if (!SendPacket(USBDevice, StartCmd.Bytes, StartCmd.Length(), 250)) return(-5);
+    return(0);
+}
+
+// Stops the conversions and closes the device at the end of a burst. Returns Result, or -6 if the burst
+// succeeded but the stop could not be sent.
+static long BurstClose(CCyUSBDevice* USBDevice, long Result)
+{
+    auto StopCmd = EVM_SEQ_STOP_CONVERSIONS;
+
+    if (!SendPacket(USBDevice, StopCmd.Bytes, StopCmd.Length(), 250) && Result == 0) Result = -6;
+    USBDevice->Close();
+    return(Result);
+}
+
+
+// Takes nFrames captures of Channels * nDVALIDReads samples back to back into DataArray, one frame after
+// the other. The device is opened, stopped and drained once; as soon as the last transfer of a frame
+// arrives the conversion is stopped, the words converted meanwhile drained with a short timeout and the
+// next conversion started, then the frame is decoded while the board is already acquiring the following one.
+// AllDataAorBfirst, Timestamps and Status hold one entry per frame. Timestamps are the seconds from the
+// call to the arrival of the first transfer of each frame. Status is 0 or the error code of the frame,
+// -12 for the frames not taken after an error. Timestamps and Status may be null. Returns -7 on invalid sizes.
+long __stdcall EVM_DataCapBatch(int* USBdev, int Channels, int nDVALIDReads, int nFrames, int* DataArray,
+    int* AllDataAorBfirst, double* Timestamps, int* Status)
+{
+    long BytesOfData = Channels * nDVALIDReads * 4;
+    long RawLen = BytesOfData + STRINGLEN;
+    long Result = 0;
+    int Frame;
+    LARGE_INTEGER Freq, T0, TFrame;
+
+    if (nFrames <= 0 || BytesOfData <= 0) return(-7);
+
+    EVM_TRACE_SCOPE_ARG("DataCapBatch", nFrames);
+    EVM_Exchange Exchange(USBdev[0]);
+    if (!Exchange.Held) return(Exchange.Result);
+
+    std::unique_ptr<unsigned char[]> Raw(new unsigned char[RawLen]);
+    std::unique_ptr<CCyUSBDevice> USBDevice(new CCyUSBDevice(NULL));
+    EVM_ScratchBuffer Scratch;
+
+    QueryPerformanceFrequency(&Freq);
+    QueryPerformanceCounter(&T0);
+
+    Result = BurstOpen(USBDevice.get(), USBdev[0], Scratch.Data());
+    if (Result != 0) return(Result);
+
+    EVM_CaptureTiming().Reset(Channels);
+    for (Frame = 0; Frame < nFrames; Frame++)
+    {
+        EVM_TRACE_SCOPE_ARG("frame", Frame);
+        Result = ReadRawCapture(USBDevice.get(), Raw.get(), BytesOfData, &TFrame);
+        if (Result != 0) break;
+
+        if (Frame + 1 < nFrames)
         {
-            inputCmd[0] = 0x10;
-            inputCmd[1] = 0x00;
-            LenVar = 2;
-            USBDevice->BulkOutEndPt->TimeOut = 250;
-            XferSuccess = USBDevice->BulkOutEndPt->XferData(inputCmd, LenVar);
-            if (XferSuccess == false)
-            {
-                USBDevice->Close();
-                return(-6);
-            }
+            Result = BurstRearm(USBDevice.get(), Scratch.Data());
+            if (Result != 0) break;
         }
-        USBDevice->Close();
+
+        AllDataAorBfirst[Frame] = (Raw[0] == 128) ? 0 : 1;
+        EVM_TRACE_SCOPE_ARG("decode", BytesOfData);
+        DecodeSamples(Raw.get(), BytesOfData, DataArray + (size_t)Frame * (BytesOfData / 4));
+        if (Timestamps != nullptr) Timestamps[Frame] = (double)(TFrame.QuadPart - T0.QuadPart) / (double)Freq.QuadPart;
+        if (Status != nullptr) Status[Frame] = 0;
     }
-    else
+
+    if (Status != nullptr)
     {
-        return(-2); //-2 means it couldn't open the USB device.
+        for (int i = Frame; i < nFrames; i++) Status[i] = (i == Frame) ? (int)Result : -12;
+    }
+
+    return BurstClose(USBDevice.get(), Result);
+}
+
+
+// Reads one capture of a conversion already started into Average, one transfer at a time. Side is the A/B flag
+// of the first capture, -1 before it; a capture starting on the other side skips its first DVALID so that every
+// sample is averaged with the same side. Returns 0, -4 on timeout, -8 on a transfer not multiple of 4 bytes.
+static long ReadAverage(CCyUSBDevice* USBDevice, unsigned char* DataCap, long BytesOfData, int Channels,
+    EVM_Average& Average, int Format, int& Side)
+{
+    long StringLenRet;
+    long BytesRead = 0;
+    long Skip = 0;
+    EVM_TimingFit& Timing = EVM_CaptureTiming();
+
+    {
+        EVM_TRACE_SCOPE("first read");
+        StringLenRet = STRINGLEN;
+        USBDevice->BulkInEndPt->SetXferSize(STRINGLEN);
+        if (!ReadTransfer(USBDevice, DataCap, StringLenRet, 10000, 3)) return(-4);
+    }
+    double Stamp = EVM_Now();
+    if (StringLenRet % 4 != 0) return(-8);
+
+    int First = (DataCap[0] == 128) ? 0 : 1;
+    if (Side < 0) Side = First;
+    if (First != Side) Skip = Channels * 4;
+    Timing.NewFrame(Side);
+
+    EVM_TRACE_SCOPE_ARG("read loop", BytesOfData);
+    for (;;)
+    {
+        // Part of the transfer inside the frame, Skip to Skip + BytesOfData of the conversion
+        long From = max(BytesRead, Skip);
+        long To = min(BytesRead + StringLenRet, Skip + BytesOfData);
+        if (To > From)
+        {
+            Timing.Add((To - Skip) / 4, Stamp);
+            EVM_TRACE_SCOPE_ARG("accumulate", To - From);
+            Average.Add(DataCap + (From - BytesRead), To - From, (From - Skip) / 4, Format);
+        }
+        BytesRead += StringLenRet;
+        if (BytesRead >= Skip + BytesOfData) break;
+
+        StringLenRet = STRINGLEN;
+        if (!ReadTransfer(USBDevice, DataCap, StringLenRet, 250, 40)) return(-4);  //10s at 250
+        Stamp = EVM_Now();
+        if (StringLenRet % 4 != 0) return(-8);
     }
 
     return(0);
 }
+
+
+// Averages nCaptures captures of Channels * nDVALIDReads samples without storing any of them: every transfer
+// is added into per sample 64 bits sums as it arrives and the next conversion is started, after the drain of
+// BurstRearm, as soon as a capture is complete. Mean, and Variance if not null, get Channels * nDVALIDReads
+// values interleaved as in EVM_DataCap: codes with CFGHIGH null, pC (pC squared) scaled from its Range and
+// Format bits otherwise. The variance is the unbiased one of the single captures, that of the mean is Variance / captures.
+// With RejectSigma > 0 the codes further than RejectSigma standard deviations from the mean of the captures
+// before are left out, from capture EVM_AVERAGE_WARMUP + 1 on. AllDataAorBfirst gets the side of sample 0.
+// Returns the codes left out, -7 on invalid sizes or more than EVM_AVERAGE_MAX_CAPTURES captures.
+long __stdcall EVM_DataCapAverage(int* USBdev, int Channels, int nDVALIDReads, int nCaptures, byte* CFGHIGH,
+    double RejectSigma, double* Mean, double* Variance, int* AllDataAorBfirst)
+{
+    long BytesOfData = Channels * nDVALIDReads * 4;
+    long Result = 0;
+    int Side = -1;
+
+    if (Channels <= 0 || BytesOfData <= 0 || nCaptures <= 0 || nCaptures > EVM_AVERAGE_MAX_CAPTURES) return(-7);
+    if (Mean == nullptr || AllDataAorBfirst == nullptr) return(-7);
+
+    EVM_Conversion Conv = (CFGHIGH != nullptr) ? EVM_MakeConversion(EVM_SAMPLE_FLOAT64, *CFGHIGH, Channels) : EVM_RawConversion();
+    double Gain = (CFGHIGH != nullptr) ? Conv.Gain : 1.0;
+    double Offset = (CFGHIGH != nullptr) ? Conv.Offset : 0.0;
+
+    EVM_TRACE_SCOPE_ARG("DataCapAverage", nCaptures);
+    EVM_Exchange Exchange(USBdev[0]);
+    if (!Exchange.Held) return(Exchange.Result);
+
+    EVM_Average Average;
+    Average.Setup(BytesOfData / 4, Variance != nullptr, RejectSigma);
+    EVM_ScratchBuffer Scratch;
+    std::unique_ptr<CCyUSBDevice> USBDevice(new CCyUSBDevice(NULL));
+
+    Result = BurstOpen(USBDevice.get(), USBdev[0], Scratch.Data());
+    if (Result != 0) return(Result);
+
+    EVM_CaptureTiming().Reset(Channels);
+    for (int Capture = 0; Capture < nCaptures; Capture++)
+    {
+        EVM_TRACE_SCOPE_ARG("capture", Capture);
+        Average.NextCapture();
+        Result = ReadAverage(USBDevice.get(), Scratch.Data(), BytesOfData, Channels, Average, Conv.Format, Side);
+        if (Result != 0) break;
+
+        if (Capture + 1 < nCaptures)
+        {
+            Result = BurstRearm(USBDevice.get(), Scratch.Data());
+            if (Result != 0) break;
+        }
+    }
+
+    Result = BurstClose(USBDevice.get(), Result);
+    if (Result != 0) return(Result);
+
+    AllDataAorBfirst[0] = Side;
+    return (long)Average.Finish(Mean, Variance, Gain, Offset);
+}
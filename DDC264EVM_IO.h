@@ -39,6 +39,22 @@ int __stdcall ReadInterfaceDescriptors(	int *USBdev, int *bLengthPass, int *bDes
                                         int *bInterfaceClassPass, int *bInterfaceSubClassPass, int *bInterfaceProtocolPass,
                                         int *iInterfacePass);
 
+// Device cache: the boards are enumerated once and again only when one is plugged or unplugged
+int __stdcall EVM_FindDevice(char* Serial);
+
+int __stdcall EVM_DeviceSerial(int USBdev, char* buf, int bufsize);
+
+long __stdcall EVM_DeviceChanges();
+
+int __stdcall EVM_RefreshDevices();
+
+void __stdcall EVM_Shutdown();
+
+// USBdev of the simulated board enabled by EVM_SimulatorSetup, accepted wherever a board number is
+const int EVM_SIMULATED_DEVICE = 0x100;
+
+long __stdcall EVM_SimulatorSetup(int Channels, double DVALIDRate);
+
 int __stdcall XferDataOut(int* USBdev, unsigned char* Data, long* DataLength);
 
 int __stdcall XferDataIn(int* USBdev, unsigned char* Data, long* DataLength);
@@ -61,4 +77,461 @@ int __stdcall EVM_RegNameTable(int RegN, char* buf, int bufsize);
 
 long __stdcall EVM_RegsTransfer(int* USBdev, int* RegsIn, int* RegEnable, int* RegsOut = nullptr);
 
+// Cached state of a board returned by EVM_GetBoardState. While a session or live readout streams from the board
+// the writes of EVM_RegDataOut, EVM_RegsTransfer, XferDataOut and the sequences are queued for its reader, which
+// sends them between two transfers; captures and XferDataIn return -14.
+struct EVM_BoardState
+{
+    int Streaming;          // 1 while a stream reads the board
+    int Busy;               // 1 while an export exchanges with it
+    long long Pending;      // Control writes queued for the stream
+    long long Applied;      // Control writes the streams sent between their transfers
+    long long Failed;       // That they couldn't send
+    int Regs[256];          // Value last written or read back of each register, -1 if unknown
+};
+
+long __stdcall EVM_GetBoardState(int* USBdev, EVM_BoardState* State);
+
 long __stdcall EVM_DataCap(int* USBdev, int Channels, int nDVALIDReads, int* DataArray, int* AllDataAorBfirst);
+
+// Sample types for EVM_DataCapEx and EVM_StreamSetSampleType
+enum EVM_SampleType
+{
+    EVM_SAMPLE_INT32 = 0,   // Raw code
+    EVM_SAMPLE_UINT16 = 1,  // Raw code, 16 bits format only
+    EVM_SAMPLE_FLOAT32 = 2, // pC
+    EVM_SAMPLE_FLOAT64 = 3, // pC
+    EVM_SAMPLE_TYPE_MASK = 0xFF,
+};
+
+// Output layout, or'ed with the sample type
+enum EVM_Layout
+{
+    EVM_LAYOUT_INTERLEAVED = 0x000,   // As delivered: all channels of a DVALID, then the next DVALID
+    EVM_LAYOUT_CHANNEL_MAJOR = 0x100, // All DVALIDs of channel 0, then channel 1... Channels must be a power of 2 up to 256
+    EVM_LAYOUT_MASK = 0xF00,
+};
+
+long __stdcall EVM_DataCapEx(int* USBdev, int Channels, int nDVALIDReads, int SampleType, byte* CFGHIGH,
+                             void* DataArray, int* AllDataAorBfirst);
+
+long __stdcall EVM_DataCapROI(int* USBdev, int Channels, int nDVALIDReads, int SampleType, byte* CFGHIGH,
+                              int nSelected, int* ChannelList, void* DataArray, int* AllDataAorBfirst);
+
+long __stdcall EVM_MapPixels(int Channels, int nPixels, int* PixelMap, int nChips, int* ChipOrder,
+                             int nDead, int* DeadChannels, int* Gather);
+
+long __stdcall EVM_DataCapImage(int* USBdev, int Channels, int nDVALIDReads, int SampleType, byte* CFGHIGH,
+                                int Width, int Height, int* Gather, void* Images, int* AllDataAorBfirst);
+
+long __stdcall EVM_SetMemoryOptions(int Flags, int nBuffers);
+
+long __stdcall EVM_DecodeBenchmark(int SampleType, byte* CFGHIGH, int Channels, int Iterations,
+                                   double* GenericMBs, double* SpecializedMBs);
+
+long __stdcall EVM_ConfigureAndCapture(int* USBdev, byte* CFGHIGH, byte* CFGLOW, int* RegsIn, int* RegEnable, int* RegsOut,
+                                       int Channels, int nDVALIDReads, int* DataArray, int* AllDataAorBfirst);
+
+long __stdcall EVM_DataCapBatch(int* USBdev, int Channels, int nDVALIDReads, int nFrames, int* DataArray,
+                                int* AllDataAorBfirst, double* Timestamps, int* Status);
+
+long __stdcall EVM_DataCapAverage(int* USBdev, int Channels, int nDVALIDReads, int nCaptures, byte* CFGHIGH,
+                                  double RejectSigma, double* Mean, double* Variance, int* AllDataAorBfirst);
+
+// Time of the DVALIDs of a frame, see EVM_GetCaptureTiming and EVM_StreamGetTiming. Times are in seconds of
+// the performance counter (QueryPerformanceCounter / QueryPerformanceFrequency), shared by every process.
+struct EVM_Timing
+{
+    double FirstTransfer;  // Completion of the first transfer
+    double LastTransfer;   // Completion of the last transfer
+    int Transfers;
+    int AorB;              // Side of DVALID 0
+    double Start;          // Estimated time of DVALID 0
+    double PeriodA;        // Estimated seconds to a DVALID of side A from the previous one, drift corrected
+    double PeriodB;        // Same for side B
+    double Drift;          // Rate error of the board against the timebase of EVM_SetTimebase, 0 without one
+};
+
+// Frame to host latency of EVM_LiveGetLatency: the time from the earliest a frame (its A and B DVALIDs) could
+// have reached the host, the lower envelope of the transfer times against the fitted frame period, to the
+// completion of the transfer holding it. In seconds, over the last frames measured.
+struct EVM_Latency
+{
+    long long Frames;       // Received since the start
+    double Period;          // Fitted seconds per frame
+    double Mean;
+    double P50;
+    double P90;
+    double P99;
+    double P999;
+    double Max;
+    double Handover50;      // Median seconds more until EVM_LiveLatest returned the frame
+    double Handover99;
+};
+
+long __stdcall EVM_SetTimebase(double ClockHz, int* Regs);
+
+long __stdcall EVM_GetCaptureTiming(EVM_Timing* Timing);
+
+double __stdcall EVM_SampleTime(EVM_Timing* Timing, long long Row);
+
+// Timeline of the acquisition phases as Chrome trace events, recorded only when the DLL is built with EVM_TRACE
+long __stdcall EVM_TraceSave(char* Path);
+
+void __stdcall EVM_TraceClear();
+
+long __stdcall EVM_ComputePSD(int* DataArray, int Channels, int nDVALIDReads, int AorBfirst, int SegmentLength,
+                              byte* CFGHIGH, double DVALIDRate, double* PSD);
+
+// =============================================================================================================
+// Sessions: one open board streaming into library owned buffers
+
+typedef struct EVM_Session* EVM_HANDLE;
+
+// Description of a buffer returned by EVM_BufferAcquire
+struct EVM_BlockInfo
+{
+    long long Sequence;     // Block number since EVM_StreamStart
+    long long SampleIndex;  // Index of the first sample within its frame, or within its group stream if filtered
+    int Frame;              // Capture number since EVM_StreamStart
+    int Samples;            // Valid samples in the buffer, whole DVALIDs
+    int AorB;               // 0 if the first sample is from side A, 1 if from side B
+    int Status;             // 0, or the error that ended the stream
+    int Group;              // 2 * channel group + side of a filtered block, 0 otherwise
+    double Timestamp;       // Completion of the transfer the block comes from, see EVM_Timing
+    double Time;            // Estimated time of the first DVALID of that transfer
+};
+
+// Pipeline counters returned by EVM_StreamGetStats
+struct EVM_StreamStats
+{
+    long long Transfers;     // Transfers read from the board
+    long long Blocks;        // Blocks published
+    long long TransferWaits; // Times the reader waited for the decoders to free a transfer buffer
+    long long BufferWaits;   // Times the pipeline waited for the caller to release a buffer
+    int DecodeQueueDepth;    // Transfers waiting for a decoder
+    int DecodeQueueMax;
+    int ReadyQueueDepth;     // Blocks waiting for EVM_BufferAcquire
+    int ReadyQueueMax;
+    int Workers;             // Decode threads running
+};
+
+// Record of an event found by EVM_StreamSetEvents or EVM_DetectEvents. Each one is followed by its window of
+// PreSamples + 1 + PostSamples codes of the same channel and side, RecordBytes apart.
+struct EVM_Event
+{
+    long long SampleIndex;  // DVALID of the trigger within its frame
+    int Frame;
+    int Channel;
+    int AorB;               // Side of the trigger, 0 for A, 1 for B
+    int Trigger;            // Index of the trigger code in the window
+    int Samples;            // Codes in the window, fewer at the edges of a frame
+    float Baseline;         // Baseline at the trigger, in codes
+};
+
+// Recording written by EVM_StreamRecord: an EVM_RecordHeader padded to EVM_RECORD_ALIGN bytes, then every block
+// as an EVM_RecordBlock followed by its data, padded to 8 bytes, then the index and an EVM_RecordTrailer
+const int EVM_RECORD_ALIGN = 4096;
+
+enum EVM_RecordContent
+{
+    EVM_RECORD_SAMPLES = 0,   // Blocks of samples
+    EVM_RECORD_FILTERED = 1,  // Blocks of a filter group and side, EVM_BlockInfo.Group
+    EVM_RECORD_EVENTS = 2,    // Blocks of RecordBytes long event records
+};
+
+struct EVM_RecordHeader
+{
+    char Magic[8];          // "EVMREC1"
+    int Version;            // 2
+    int Channels;
+    int nDVALIDReads;
+    int SampleType;         // EVM_SAMPLE_xxx | EVM_LAYOUT_xxx of the blocks
+    int Content;            // EVM_RECORD_xxx
+    int RecordBytes;        // Of an event record
+    int CFGHIGH;
+    int Reserved;
+    double StartTime;       // Performance counter seconds when the stream started
+};
+
+struct EVM_RecordBlock
+{
+    unsigned int Magic;     // EVM_RECORD_BLOCK_MAGIC
+    unsigned int Bytes;     // Of the data that follows
+    int Width;              // Samples per row, 0 for event records
+    int Reserved;
+    EVM_BlockInfo Info;
+};
+
+const unsigned int EVM_RECORD_BLOCK_MAGIC = 0x424D5645; // "EVMB"
+
+// Index of a recording: consecutive blocks of a frame and group are gathered in entries of about
+// EVM_RECORD_ENTRY_BYTES, each followed by Width EVM_RecordSummary, one per channel of the row
+const int EVM_RECORD_ENTRY_BYTES = 1 << 20;
+
+struct EVM_RecordEntry
+{
+    long long Offset;       // Of the EVM_RecordBlock of its first block
+    long long FirstSample;  // EVM_BlockInfo.SampleIndex of the first block
+    long long Samples;      // In all its blocks
+    int Bytes;              // Of its blocks in the file, records included
+    int Blocks;
+    int Frame;
+    int Group;
+    int Width;              // As in EVM_RecordBlock
+    int AorB;               // Of the first block
+    double Time;            // EVM_BlockInfo.Time of the first block
+};
+
+struct EVM_RecordSummary
+{
+    float Min;
+    float Max;
+    float Mean;
+};
+
+// Last bytes of the file, missing if the recording was cut short
+struct EVM_RecordTrailer
+{
+    long long IndexOffset;  // Of the first EVM_RecordEntry
+    int Entries;
+    unsigned int Magic;     // EVM_RECORD_INDEX_MAGIC
+};
+
+const unsigned int EVM_RECORD_INDEX_MAGIC = 0x58444E49; // "INDX"
+
+typedef struct EVM_Archive* EVM_ARCHIVE;
+
+// Stream server of EVM_StreamServe. Over TCP every message is an EVM_ServeFrame followed by Bytes bytes of data.
+enum EVM_ServeKind
+{
+    EVM_SERVE_HELLO = 0,      // Start of a stream: its EVM_RecordHeader, then the EVM_REG_COUNT register bytes
+    EVM_SERVE_BLOCK = 1,      // A block as published
+    EVM_SERVE_END = 2,        // End of the stream, Info.Status holds the error that ended it or 0
+};
+
+struct EVM_ServeFrame
+{
+    unsigned int Magic;     // EVM_SERVE_MAGIC
+    unsigned int Bytes;     // Of the data that follows
+    int Kind;               // EVM_SERVE_xxx
+    int Width;              // Samples per row, 0 for event records
+    long long Sequence;     // Of the message among all the server sent, a gap is a block this client skipped
+    EVM_BlockInfo Info;     // Of a block: its A/B flag, frame, position and time
+};
+
+const unsigned int EVM_SERVE_MAGIC = 0x534D5645; // "EVMS"
+
+// Over UDP a message goes in parts of up to EVM_SERVE_DATAGRAM_BYTES, each after this header
+struct EVM_ServeDatagram
+{
+    unsigned int Magic;     // EVM_SERVE_DATAGRAM_MAGIC
+    unsigned int Offset;    // Of the part in the message
+    unsigned int Bytes;     // Of the whole message
+    unsigned int Reserved;
+    long long Sequence;     // Of the message
+};
+
+const unsigned int EVM_SERVE_DATAGRAM_MAGIC = 0x444D5645; // "EVMD"
+const int EVM_SERVE_DATAGRAM_BYTES = 1400;
+
+// Flags of EVM_StreamServe
+enum EVM_ServeFlags
+{
+    EVM_SERVE_TCP = 1,        // Clients connect to the port
+    EVM_SERVE_UDP = 2,        // Clients send a datagram to the port, first byte 1 to subscribe, 0 to leave
+    EVM_SERVE_DROP_SLOW = 4,  // A client whose queue is full is disconnected, otherwise it skips blocks
+    EVM_SERVE_PUBLISH = 8,    // Blocks are still handed to EVM_BufferAcquire after being sent
+    EVM_SERVE_REMOTE = 16,    // Listens on every interface, otherwise on the loopback one for this machine only
+};
+
+// Server counters returned by EVM_StreamGetServeStats
+struct EVM_ServeStats
+{
+    long long Blocks;       // Sent to the clients
+    long long Bytes;        // Sent over TCP
+    long long Skipped;      // Blocks a client or the datagram queue missed for being behind
+    int Clients;            // TCP clients connected
+    int Subscribers;        // UDP subscribers
+    int Dropped;            // Slow clients disconnected
+    int QueueMax;           // Deepest client queue, in messages
+};
+
+typedef struct EVM_SharedReader* EVM_SHARED;
+
+// Shared memory ring of EVM_StreamShare. The mapping starts with this header, then come Slots slots of
+// SlotStride bytes from FirstSlot, each an EVM_SharedSlot followed by the data of a block.
+struct EVM_SharedHeader
+{
+    char Magic[8];                  // "EVMSHM1"
+    int Version;                    // 1
+    int Slots;
+    long long SlotBytes;            // Room for the data of a block
+    long long SlotStride;
+    long long FirstSlot;            // Offset of the first slot in the mapping
+    volatile long long Head;        // Blocks published since the ring was created: the sequence of the next one
+    volatile long long Stream;      // Streams started, Describe is the one of the last
+    volatile long Status;           // 1 while a stream runs, then the error that ended it or 0
+    int Reserved;
+    EVM_RecordHeader Describe;
+};
+
+struct EVM_SharedSlot
+{
+    volatile long long Sequence;    // Of the block it holds, -1 while it is being written
+    long long Stream;               // That the block belongs to
+    EVM_BlockInfo Info;
+    long long Bytes;                // Of the data that follows
+    int Width;                      // Samples per row, 0 for event records
+    int Reserved;
+};
+
+// Flags of EVM_StreamShare
+enum EVM_ShareFlags
+{
+    EVM_SHARE_PUBLISH = 1,    // Blocks are still handed to EVM_BufferAcquire after being shared
+};
+
+// Counters of a reader returned by EVM_SharedGetStats
+struct EVM_SharedStats
+{
+    long long Blocks;       // Acquired
+    long long Lost;         // Overwritten before the reader got to them
+    long long Overruns;     // Overwritten while the reader held them, see EVM_SharedRelease
+    long long Behind;       // Published and not acquired yet
+};
+
+typedef struct EVM_Live* EVM_LIVE;
+
+// Flags of EVM_StreamRecord
+enum EVM_RecordFlags
+{
+    EVM_RECORD_PUBLISH = 1,   // Blocks are still handed to EVM_BufferAcquire after being recorded
+};
+
+// Recorder counters returned by EVM_StreamGetRecordStats
+struct EVM_RecordStats
+{
+    long long Bytes;        // Written to the file
+    long long Blocks;
+    long long Writes;       // Chunks written
+    long long Waits;        // Times a block waited for a chunk to be written
+    int QueueDepth;         // Chunk writes in flight
+    int QueueMax;
+    double MBs;             // Average throughput since the file was opened
+};
+
+// Buffer memory for EVM_SetMemoryOptions and EVM_StreamSetMemory
+enum EVM_MemoryFlags
+{
+    EVM_MEM_LOCK = 1,         // Locked in physical memory
+    EVM_MEM_LARGE_PAGES = 2,  // Backed by large pages, needs the "Lock pages in memory" right
+};
+
+// Reader thread priority for EVM_StreamSetReaderPriority
+enum EVM_ReaderPriority
+{
+    EVM_PRIORITY_NORMAL = 0,
+    EVM_PRIORITY_HIGH = 1,
+    EVM_PRIORITY_REALTIME = 2,  // Time critical
+};
+
+// Decimation stage for EVM_StreamSetFilter
+enum EVM_FilterMode
+{
+    EVM_FILTER_NONE = 0,
+    EVM_FILTER_BOXCAR = 1,  // Mean of each Factor rows
+    EVM_FILTER_CIC = 2,     // CIC decimator of Order stages, normalized to its gain
+};
+
+EVM_HANDLE __stdcall EVM_SessionOpen(int USBdev);
+
+EVM_HANDLE __stdcall EVM_SessionOpenSerial(char* Serial);
+
+void __stdcall EVM_SessionClose(EVM_HANDLE Session);
+
+long __stdcall EVM_StreamSetSampleType(EVM_HANDLE Session, int SampleType, byte* CFGHIGH);
+
+long __stdcall EVM_StreamSetFilter(EVM_HANDLE Session, int Mode, int Order, int nGroups, int* GroupChannels, int* Factors);
+
+long __stdcall EVM_StreamSetROI(EVM_HANDLE Session, int nSelected, int* ChannelList);
+
+long __stdcall EVM_StreamSetImage(EVM_HANDLE Session, int Width, int Height, int* Gather);
+
+long __stdcall EVM_StreamSetPipeline(EVM_HANDLE Session, int nWorkers, int nTransfers);
+
+long __stdcall EVM_StreamSetMemory(EVM_HANDLE Session, int Flags);
+
+long __stdcall EVM_StreamSetReaderPriority(EVM_HANDLE Session, int Priority, int Core);
+
+long __stdcall EVM_StreamSetPSD(EVM_HANDLE Session, int SegmentLength, double DVALIDRate);
+
+long __stdcall EVM_StreamGetPSD(EVM_HANDLE Session, double* PSD);
+
+long __stdcall EVM_StreamGetTiming(EVM_HANDLE Session, EVM_Timing* Timing);
+
+long __stdcall EVM_StreamSetEvents(EVM_HANDLE Session, int nThresholds, int* Thresholds, int Hysteresis,
+                                   int PreSamples, int PostSamples, int BaselineShift);
+
+long __stdcall EVM_DetectEvents(int* DataArray, int Channels, int nDVALIDReads, int AorBfirst, int nThresholds, int* Thresholds,
+                                int Hysteresis, int PreSamples, int PostSamples, int BaselineShift, void* Events, long EventsBytes);
+
+long __stdcall EVM_StreamRecord(EVM_HANDLE Session, char* Path, int Flags, int QueueDepth, int ChunkKB);
+
+long __stdcall EVM_StreamGetRecordStats(EVM_HANDLE Session, EVM_RecordStats* Stats);
+
+EVM_ARCHIVE __stdcall EVM_ArchiveOpen(char* Path);
+
+void __stdcall EVM_ArchiveClose(EVM_ARCHIVE Archive);
+
+long __stdcall EVM_ArchiveGetHeader(EVM_ARCHIVE Archive, EVM_RecordHeader* Header);
+
+long __stdcall EVM_ArchiveGetIndex(EVM_ARCHIVE Archive, int First, int nEntries, EVM_RecordEntry* Entries);
+
+long long __stdcall EVM_ArchiveRows(EVM_ARCHIVE Archive, int Frame, int Group);
+
+long __stdcall EVM_ArchiveReadChannel(EVM_ARCHIVE Archive, int Frame, int Group, int Channel, long long FirstRow, long nRows,
+                                      double* Out);
+
+long __stdcall EVM_ArchiveOverview(EVM_ARCHIVE Archive, int Frame, int Group, int Channel, long long FirstRow, long long nRows,
+                                   int nBins, float* Min, float* Max, float* Mean);
+
+long __stdcall EVM_StreamServe(EVM_HANDLE Session, int Port, int Flags, int QueueBlocks, int* Regs);
+
+long __stdcall EVM_StreamGetServeStats(EVM_HANDLE Session, EVM_ServeStats* Stats);
+
+long __stdcall EVM_StreamShare(EVM_HANDLE Session, char* Name, int Slots, int SlotKB, int Flags);
+
+EVM_SHARED __stdcall EVM_SharedOpen(char* Name);
+
+void __stdcall EVM_SharedClose(EVM_SHARED Reader);
+
+long long __stdcall EVM_SharedGetHeader(EVM_SHARED Reader, EVM_SharedHeader* Header);
+
+long __stdcall EVM_SharedAcquire(EVM_SHARED Reader, int TimeoutMs, void** Data, EVM_SharedSlot* Block);
+
+long __stdcall EVM_SharedRelease(EVM_SHARED Reader);
+
+long __stdcall EVM_SharedGetStats(EVM_SHARED Reader, EVM_SharedStats* Stats);
+
+EVM_LIVE __stdcall EVM_LiveOpen(int USBdev);
+
+void __stdcall EVM_LiveClose(EVM_LIVE Live);
+
+long __stdcall EVM_LiveStart(EVM_LIVE Live, int Channels, int SampleType, byte* CFGHIGH, int nQueued, int FramesPerTransfer);
+
+long __stdcall EVM_LiveStop(EVM_LIVE Live);
+
+long __stdcall EVM_LiveLatest(EVM_LIVE Live, int TimeoutMs, void* Frame, EVM_BlockInfo* Info);
+
+long __stdcall EVM_LiveGetLatency(EVM_LIVE Live, EVM_Latency* Latency);
+
+long __stdcall EVM_StreamStart(EVM_HANDLE Session, int Channels, int nDVALIDReads, int nFrames, int nBuffers);
+
+long __stdcall EVM_StreamStop(EVM_HANDLE Session);
+
+long __stdcall EVM_BufferAcquire(EVM_HANDLE Session, int TimeoutMs, void** Data, int* Samples, EVM_BlockInfo* Info);
+
+long __stdcall EVM_BufferRelease(EVM_HANDLE Session, int Index);
+
+long __stdcall EVM_StreamGetStats(EVM_HANDLE Session, EVM_StreamStats* Stats);
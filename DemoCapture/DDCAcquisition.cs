@@ -88,50 +88,50 @@ partial class Program
 
         else CHANNEL_COUNT = (int)Math.Pow(2, channelValue);
         // CONV
-        Set_RegIn(0x01, CONV_LOW_INT - 1 >> 16);
-        Set_RegIn(0x02, CONV_LOW_INT - 1 >> 8);
-        Set_RegIn(0x03, CONV_LOW_INT - 1);
-        Set_RegIn(0x04, CONV_HIGH_INT - 1 >> 16);
-        Set_RegIn(0x05, CONV_HIGH_INT - 1 >> 8);
-        Set_RegIn(0x06, CONV_HIGH_INT - 1);
+        Set_RegIn(EVMReg.CONV_LOW_MSB, CONV_LOW_INT - 1 >> 16);
+        Set_RegIn(EVMReg.CONV_LOW_MIDB, CONV_LOW_INT - 1 >> 8);
+        Set_RegIn(EVMReg.CONV_LOW_LSB, CONV_LOW_INT - 1);
+        Set_RegIn(EVMReg.CONV_HIGH_MSB, CONV_HIGH_INT - 1 >> 16);
+        Set_RegIn(EVMReg.CONV_HIGH_MIDB, CONV_HIGH_INT - 1 >> 8);
+        Set_RegIn(EVMReg.CONV_HIGH_LSB, CONV_HIGH_INT - 1);
 
         // DDC Sys Clock
-        Set_RegIn(0x07, (CLC_HIGH << 4) | (CLC_LOW & 0x0F));
-        Set_RegIn(0x08, DDC_CLK_CONFIG);
+        Set_RegIn(EVMReg.DIVXCLK, (CLC_HIGH << 4) | (CLC_LOW & 0x0F));
+        Set_RegIn(EVMReg.DDC_CLK_SEL, DDC_CLK_CONFIG);
 
         // Format and Channel Count
         int FORMAT = CFGHIGH & 1;
-        Set_RegIn(0x09, (FORMAT << 4) + channelValue);
+        Set_RegIn(EVMReg.FORMAT_CHANNELS, (FORMAT << 4) + channelValue);
 
         // DDC Data Clock
-        Set_RegIn(0x0A, (DCLK_HIGH << 4) | (DCLK_LOW & 0x0F));
-        Set_RegIn(0x0B, DCLK_CONFIG);
+        Set_RegIn(EVMReg.DIVXCLK_DATA, (DCLK_HIGH << 4) | (DCLK_LOW & 0x0F));
+        Set_RegIn(EVMReg.DDC_DATA_CLK_SEL, DCLK_CONFIG);
 
         // nDVALIDS
-        Set_RegIn(0x0C, NDVALID_IGNORE);
-        Set_RegIn(0x0D, NDVALID_READ);
-        Set_RegIn(0x0E, NDVALID_READ >> 8);
-        Set_RegIn(0x0F, NDVALID_READ >> 16);
+        Set_RegIn(EVMReg.NDVALIDS_IGNORE, NDVALID_IGNORE);
+        Set_RegIn(EVMReg.NDVALIDS_READ_LSB, NDVALID_READ);
+        Set_RegIn(EVMReg.NDVALIDS_READ_MIDB, NDVALID_READ >> 8);
+        Set_RegIn(EVMReg.NDVALIDS_READ_MSB, NDVALID_READ >> 16);
 
         // DCLK Wait
-        Set_RegIn(0x13, DCLK_WAIT_MCLK >> 8);
-        Set_RegIn(0x14, DCLK_WAIT_MCLK);
+        Set_RegIn(EVMReg.DCLK_WAIT_COUNT_MSB, DCLK_WAIT_MCLK >> 8);
+        Set_RegIn(EVMReg.DCLK_WAIT_COUNT_LSB, DCLK_WAIT_MCLK);
 
         //// Format
-        Set_RegIn(0x1F, FORMAT);
+        Set_RegIn(EVMReg.FORMAT_DIN_CFG, FORMAT);
 
         // CLK CFG
-        Set_RegIn(0x20, (CLK_CFG_HI << 4) | (CLK_CFG_LO & 0x0F));
+        Set_RegIn(EVMReg.FREQ_DIV_DIN_CLK, (CLK_CFG_HI << 4) | (CLK_CFG_LO & 0x0F));
 
         // CONV Config 
-        Set_RegIn(0x57, CONV_CONFIG); // 0-Freerun, 1-Freerun, 2-Low, 3-High
+        Set_RegIn(EVMReg.CONV_CONFIG, CONV_CONFIG); // 0-Freerun, 1-Freerun, 2-Low, 3-High
 
         // Aditional undocummented registers
-        Set_RegIn(0x51, CONV_WAIT_LOW >> 8);
-        Set_RegIn(0x52, CONV_WAIT_LOW);
-        Set_RegIn(0x53, CONV_WAIT_HIGH >> 8);
-        Set_RegIn(0x54, CONV_WAIT_HIGH);
-        Set_RegIn(0xEB, CLKDELAY_AROUND_CONV);
+        Set_RegIn(EVMReg.CONV_WAIT_LOW_MSB, CONV_WAIT_LOW >> 8);
+        Set_RegIn(EVMReg.CONV_WAIT_LOW_LSB, CONV_WAIT_LOW);
+        Set_RegIn(EVMReg.CONV_WAIT_HIGH_MSB, CONV_WAIT_HIGH >> 8);
+        Set_RegIn(EVMReg.CONV_WAIT_HIGH_LSB, CONV_WAIT_HIGH);
+        Set_RegIn(EVMReg.CLKDELAY_AROUND_CONV, CLKDELAY_AROUND_CONV);
     }
 
     bool EVM_ShowRegisters()
@@ -150,7 +150,7 @@ partial class Program
         if (ErrorFlag == 0)
         {
             // Print EVM Firmware version
-            Console.WriteLine($"Firmware version: {RegsOut[0x5E] * 256 + RegsOut[0x5F]}");
+            Console.WriteLine($"Firmware version: {RegsOut[EVMReg.FIRMWARE_VERSION_MSB] * 256 + RegsOut[EVMReg.FIRMWARE_VERSION_LSB]}");
             for (int i = 1; i < regsSize; i++) Console.WriteLine($"Register {FPGARegStr(i)} [0x{i:X2}] : 0x{RegsOut[i]:X2}");
             return true;
         }
@@ -21,6 +21,26 @@ partial class Program
     [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
     public static extern int ReadInterfaceDescriptors(ref int USBdev, ref int bLengthPass, ref int bDescriptorTypePass, ref int bInterfaceNumberPass, ref int bAlternateSettingPass, ref short bNumEndpointsPass, ref int bInterfaceClassPass, ref int bInterfaceSubClassPass, ref int bInterfaceProtocolPass, ref int iInterfacePass);
 
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_FindDevice([MarshalAs(UnmanagedType.LPStr)] string Serial);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_DeviceSerial(int USBdev, [MarshalAs(UnmanagedType.LPStr)] StringBuilder buf, int bufsize);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_DeviceChanges();
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_RefreshDevices();
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern void EVM_Shutdown();
+
+    public const int EVM_SIMULATED_DEVICE = 0x100;
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_SimulatorSetup(int Channels, double DVALIDRate);
+
     [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
     public static extern int XferDataOut(ref int USBdev, [MarshalAs(UnmanagedType.LPArray)] byte[] Data, ref long DataLength);
 
@@ -53,7 +73,402 @@ partial class Program
     [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
     public static extern int EVM_RegsTransfer(ref int USBdev, ref int Array_RegsIn, ref int Array_RegEnable, ref int Array_RegsOut);
 
+    [StructLayout(LayoutKind.Sequential)]
+    public struct EVM_BoardState
+    {
+        public int Streaming;
+        public int Busy;
+        public long Pending;
+        public long Applied;
+        public long Failed;
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 256)]
+        public int[] Regs;
+    }
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_GetBoardState(ref int USBdev, out EVM_BoardState State);
+
     [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
     public static extern int EVM_DataCap(ref int USBdev, int Channels, int Samples, ref int AllData, ref int AllDataAorBfirst);
 
+    // Sample types for EVM_DataCapEx and EVM_StreamSetSampleType
+    public const int EVM_SAMPLE_INT32 = 0;   // Raw code
+    public const int EVM_SAMPLE_UINT16 = 1;  // Raw code, 16 bits format only
+    public const int EVM_SAMPLE_FLOAT32 = 2; // pC
+    public const int EVM_SAMPLE_FLOAT64 = 3; // pC
+
+    // Output layout, or'ed with the sample type
+    public const int EVM_LAYOUT_INTERLEAVED = 0x000;
+    public const int EVM_LAYOUT_CHANNEL_MAJOR = 0x100;  // Channels must be a power of 2 up to 256
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_DataCapEx(ref int USBdev, int Channels, int Samples, int SampleType, ref byte CFGHIGH, ref double AllData, ref int AllDataAorBfirst);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_DataCapROI(ref int USBdev, int Channels, int Samples, int SampleType, ref byte CFGHIGH, int nSelected, int[] ChannelList, ref double AllData, ref int AllDataAorBfirst);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_MapPixels(int Channels, int nPixels, int[] PixelMap, int nChips, int[] ChipOrder, int nDead, int[] DeadChannels, int[] Gather);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_DataCapImage(ref int USBdev, int Channels, int Samples, int SampleType, ref byte CFGHIGH, int Width, int Height, int[] Gather, ref double Images, ref int AllDataAorBfirst);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_SetMemoryOptions(int Flags, int nBuffers);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_DecodeBenchmark(int SampleType, ref byte CFGHIGH, int Channels, int Iterations, out double GenericMBs, out double SpecializedMBs);
+
+    // Array_RegsOut null to skip the register readback
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_ConfigureAndCapture(ref int USBdev, ref byte CFGHIGH, ref byte CFGLOW, ref int Array_RegsIn, ref int Array_RegEnable, int[] Array_RegsOut, int Channels, int Samples, ref int AllData, ref int AllDataAorBfirst);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_DataCapBatch(ref int USBdev, int Channels, int Samples, int Frames, ref int AllData, ref int AllDataAorBfirst, ref double Timestamps, ref int Status);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_DataCapAverage(ref int USBdev, int Channels, int Samples, int Captures, ref byte CFGHIGH, double RejectSigma, ref double Mean, ref double Variance, ref int AllDataAorBfirst);
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct EVM_Timing
+    {
+        public double FirstTransfer;
+        public double LastTransfer;
+        public int Transfers;
+        public int AorB;
+        public double Start;
+        public double PeriodA;
+        public double PeriodB;
+        public double Drift;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct EVM_Latency
+    {
+        public long Frames;
+        public double Period;
+        public double Mean;
+        public double P50;
+        public double P90;
+        public double P99;
+        public double P999;
+        public double Max;
+        public double Handover50;
+        public double Handover99;
+    }
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_SetTimebase(double ClockHz, int[] Regs);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_TraceSave([MarshalAs(UnmanagedType.LPStr)] string Path);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern void EVM_TraceClear();
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_GetCaptureTiming(out EVM_Timing Timing);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern double EVM_SampleTime(ref EVM_Timing Timing, long Row);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_ComputePSD(ref int AllData, int Channels, int Samples, int AorBfirst, int SegmentLength, ref byte CFGHIGH, double DVALIDRate, double[] PSD);
+
+    // =============================================================================================================
+    // Sessions: the DLL owns the sample buffers, a completed buffer is read in place through a span
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct EVM_BlockInfo
+    {
+        public long Sequence;
+        public long SampleIndex;
+        public int Frame;
+        public int Samples;
+        public int AorB;
+        public int Status;
+        public int Group;
+        public double Timestamp;
+        public double Time;
+    }
+
+    // Header of an event record, followed by its window of codes
+    [StructLayout(LayoutKind.Sequential)]
+    public struct EVM_Event
+    {
+        public long SampleIndex;
+        public int Frame;
+        public int Channel;
+        public int AorB;
+        public int Trigger;
+        public int Samples;
+        public float Baseline;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct EVM_StreamStats
+    {
+        public long Transfers;
+        public long Blocks;
+        public long TransferWaits;
+        public long BufferWaits;
+        public int DecodeQueueDepth;
+        public int DecodeQueueMax;
+        public int ReadyQueueDepth;
+        public int ReadyQueueMax;
+        public int Workers;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct EVM_RecordStats
+    {
+        public long Bytes;
+        public long Blocks;
+        public long Writes;
+        public long Waits;
+        public int QueueDepth;
+        public int QueueMax;
+        public double MBs;
+    }
+
+    // Flags of EVM_StreamRecord
+    public const int EVM_RECORD_PUBLISH = 1;
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct EVM_RecordHeader
+    {
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 8)]
+        public byte[] Magic;
+        public int Version;
+        public int Channels;
+        public int nDVALIDReads;
+        public int SampleType;
+        public int Content;
+        public int RecordBytes;
+        public int CFGHIGH;
+        public int Reserved;
+        public double StartTime;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct EVM_RecordEntry
+    {
+        public long Offset;
+        public long FirstSample;
+        public long Samples;
+        public int Bytes;
+        public int Blocks;
+        public int Frame;
+        public int Group;
+        public int Width;
+        public int AorB;
+        public double Time;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct EVM_ServeStats
+    {
+        public long Blocks;
+        public long Bytes;
+        public long Skipped;
+        public int Clients;
+        public int Subscribers;
+        public int Dropped;
+        public int QueueMax;
+    }
+
+    // Flags of EVM_StreamServe
+    public const int EVM_SERVE_TCP = 1;
+    public const int EVM_SERVE_UDP = 2;
+    public const int EVM_SERVE_DROP_SLOW = 4;
+    public const int EVM_SERVE_PUBLISH = 8;
+    public const int EVM_SERVE_REMOTE = 16;
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct EVM_SharedHeader
+    {
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 8)]
+        public byte[] Magic;
+        public int Version;
+        public int Slots;
+        public long SlotBytes;
+        public long SlotStride;
+        public long FirstSlot;
+        public long Head;
+        public long Stream;
+        public int Status;
+        public int Reserved;
+        public EVM_RecordHeader Describe;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct EVM_SharedSlot
+    {
+        public long Sequence;
+        public long Stream;
+        public EVM_BlockInfo Info;
+        public long Bytes;
+        public int Width;
+        public int Reserved;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct EVM_SharedStats
+    {
+        public long Blocks;
+        public long Lost;
+        public long Overruns;
+        public long Behind;
+    }
+
+    // Flags of EVM_StreamShare
+    public const int EVM_SHARE_PUBLISH = 1;
+
+    // Decimation stage for EVM_StreamSetFilter
+    public const int EVM_FILTER_NONE = 0;
+    public const int EVM_FILTER_BOXCAR = 1;
+    public const int EVM_FILTER_CIC = 2;
+
+    public const int EVM_MEM_LOCK = 1;
+    public const int EVM_MEM_LARGE_PAGES = 2;
+
+    public const int EVM_PRIORITY_NORMAL = 0;
+    public const int EVM_PRIORITY_HIGH = 1;
+    public const int EVM_PRIORITY_REALTIME = 2;
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern IntPtr EVM_SessionOpen(int USBdev);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern IntPtr EVM_SessionOpenSerial([MarshalAs(UnmanagedType.LPStr)] string Serial);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern void EVM_SessionClose(IntPtr Session);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_StreamSetSampleType(IntPtr Session, int SampleType, ref byte CFGHIGH);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_StreamSetROI(IntPtr Session, int nSelected, int[] ChannelList);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_StreamSetImage(IntPtr Session, int Width, int Height, int[] Gather);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_StreamSetFilter(IntPtr Session, int Mode, int Order, int nGroups, int[] GroupChannels, int[] Factors);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_StreamSetPipeline(IntPtr Session, int nWorkers, int nTransfers);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_StreamSetMemory(IntPtr Session, int Flags);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_StreamSetReaderPriority(IntPtr Session, int Priority, int Core);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_StreamSetPSD(IntPtr Session, int SegmentLength, double DVALIDRate);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_StreamGetPSD(IntPtr Session, double[] PSD);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_StreamGetTiming(IntPtr Session, out EVM_Timing Timing);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_StreamSetEvents(IntPtr Session, int nThresholds, int[] Thresholds, int Hysteresis, int PreSamples, int PostSamples, int BaselineShift);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_DetectEvents(ref int AllData, int Channels, int Samples, int AorBfirst, int nThresholds, int[] Thresholds, int Hysteresis, int PreSamples, int PostSamples, int BaselineShift, byte[] Events, int EventsBytes);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_StreamRecord(IntPtr Session, [MarshalAs(UnmanagedType.LPStr)] string Path, int Flags, int QueueDepth, int ChunkKB);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_StreamGetRecordStats(IntPtr Session, out EVM_RecordStats Stats);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern IntPtr EVM_ArchiveOpen([MarshalAs(UnmanagedType.LPStr)] string Path);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern void EVM_ArchiveClose(IntPtr Archive);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_ArchiveGetHeader(IntPtr Archive, out EVM_RecordHeader Header);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_ArchiveGetIndex(IntPtr Archive, int First, int nEntries, [Out] EVM_RecordEntry[] Entries);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern long EVM_ArchiveRows(IntPtr Archive, int Frame, int Group);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_ArchiveReadChannel(IntPtr Archive, int Frame, int Group, int Channel, long FirstRow, int nRows, double[] Out);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_ArchiveOverview(IntPtr Archive, int Frame, int Group, int Channel, long FirstRow, long nRows, int nBins, float[] Min, float[] Max, float[] Mean);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_StreamServe(IntPtr Session, int Port, int Flags, int QueueBlocks, int[] Regs);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_StreamGetServeStats(IntPtr Session, out EVM_ServeStats Stats);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_StreamShare(IntPtr Session, [MarshalAs(UnmanagedType.LPStr)] string Name, int Slots, int SlotKB, int Flags);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern IntPtr EVM_SharedOpen([MarshalAs(UnmanagedType.LPStr)] string Name);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern void EVM_SharedClose(IntPtr Reader);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern long EVM_SharedGetHeader(IntPtr Reader, out EVM_SharedHeader Header);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_SharedAcquire(IntPtr Reader, int TimeoutMs, out IntPtr Data, out EVM_SharedSlot Block);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_SharedRelease(IntPtr Reader);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_SharedGetStats(IntPtr Reader, out EVM_SharedStats Stats);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern IntPtr EVM_LiveOpen(int USBdev);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern void EVM_LiveClose(IntPtr Live);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_LiveStart(IntPtr Live, int Channels, int SampleType, ref byte CFGHIGH, int nQueued, int FramesPerTransfer);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_LiveStop(IntPtr Live);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_LiveLatest(IntPtr Live, int TimeoutMs, IntPtr Frame, out EVM_BlockInfo Info);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_LiveGetLatency(IntPtr Live, out EVM_Latency Latency);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_StreamStart(IntPtr Session, int Channels, int Samples, int Frames, int Buffers);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_StreamStop(IntPtr Session);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_BufferAcquire(IntPtr Session, int TimeoutMs, out IntPtr Data, out int Samples, out EVM_BlockInfo Info);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_BufferRelease(IntPtr Session, int Index);
+
+    [DllImport(dllFile, CallingConvention = CallingConvention.StdCall)]
+    public static extern int EVM_StreamGetStats(IntPtr Session, out EVM_StreamStats Stats);
+
+    // View of an acquired buffer, valid until EVM_BufferRelease. T matches the stream sample type.
+    public static unsafe ReadOnlySpan<T> BufferSpan<T>(IntPtr Data, int Samples) where T : unmanaged => new((void*)Data, Samples);
+
 }
@@ -0,0 +1,42 @@
+﻿/**
+ * Acquisition software demo for the DDC264EVM_IO DLL
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.2
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ */
+
+// FPGA register addresses, mirrors EVM_Registers.h
+static class EVMReg
+{
+    public const int CONV_LOW_MSB = 0x01;
+    public const int CONV_LOW_MIDB = 0x02;
+    public const int CONV_LOW_LSB = 0x03;
+    public const int CONV_HIGH_MSB = 0x04;
+    public const int CONV_HIGH_MIDB = 0x05;
+    public const int CONV_HIGH_LSB = 0x06;
+    public const int DIVXCLK = 0x07;
+    public const int DDC_CLK_SEL = 0x08;
+    public const int FORMAT_CHANNELS = 0x09;
+    public const int DIVXCLK_DATA = 0x0A;
+    public const int DDC_DATA_CLK_SEL = 0x0B;
+    public const int NDVALIDS_IGNORE = 0x0C;
+    public const int NDVALIDS_READ_LSB = 0x0D;
+    public const int NDVALIDS_READ_MIDB = 0x0E;
+    public const int NDVALIDS_READ_MSB = 0x0F;
+    public const int DCLK_WAIT_COUNT_MSB = 0x13;
+    public const int DCLK_WAIT_COUNT_LSB = 0x14;
+    public const int FORMAT_DIN_CFG = 0x1F;
+    public const int FREQ_DIV_DIN_CLK = 0x20;
+    public const int CONV_WAIT_LOW_MSB = 0x51;
+    public const int CONV_WAIT_LOW_LSB = 0x52;
+    public const int CONV_WAIT_HIGH_MSB = 0x53;
+    public const int CONV_WAIT_HIGH_LSB = 0x54;
+    public const int CONV_CONFIG = 0x57;
+    public const int FIRMWARE_VERSION_MSB = 0x5E;
+    public const int FIRMWARE_VERSION_LSB = 0x5F;
+    public const int CLKDELAY_AROUND_CONV = 0xEB;
+}
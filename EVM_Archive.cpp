@@ -0,0 +1,419 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ */
+
+#include "StdAfx.h"
+#include "DDC264EVM_IO.h"
+#include "EVM_Decode.h"
+#include "EVM_Archive.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+static const double NaN = std::numeric_limits<double>::quiet_NaN();
+
+static double Value(const unsigned char* Data, int SampleType, size_t i)
+{
+    switch (SampleType & EVM_SAMPLE_TYPE_MASK)
+    {
+    case EVM_SAMPLE_UINT16: return ((const unsigned short*)Data)[i];
+    case EVM_SAMPLE_FLOAT32: return ((const float*)Data)[i];
+    case EVM_SAMPLE_FLOAT64: return ((const double*)Data)[i];
+    }
+    return ((const int*)Data)[i];
+}
+
+// Bytes of a block in the file, its record included
+static size_t RecordSize(size_t Bytes)
+{
+    return sizeof(EVM_RecordBlock) + ((Bytes + 7) & ~(size_t)7);
+}
+
+// Adds n samples, the first being sample First of rows of Width, to the per channel extremes and sums
+template <typename T>
+static void Fold(const T* x, long n, long long First, int Width, bool ChannelMajor, double* Min, double* Max, double* Sum, long long* Count)
+{
+    if (ChannelMajor)
+    {
+        long Rows = n / Width;
+        for (int c = 0; c < Width; c++, x += Rows)
+        {
+            double Lo = Min[c], Hi = Max[c], s = 0;
+            for (long r = 0; r < Rows; r++)
+            {
+                double v = x[r];
+                Lo = (v < Lo) ? v : Lo;
+                Hi = (v > Hi) ? v : Hi;
+                s += v;
+            }
+            Min[c] = Lo;
+            Max[c] = Hi;
+            Sum[c] += s;
+            Count[c] += Rows;
+        }
+        return;
+    }
+
+    int c = (int)(First % Width);
+    for (long i = 0; i < n; i++)
+    {
+        double v = x[i];
+        Min[c] = (v < Min[c]) ? v : Min[c];
+        Max[c] = (v > Max[c]) ? v : Max[c];
+        Sum[c] += v;
+        Count[c]++;
+        if (++c == Width) c = 0;
+    }
+}
+
+EVM_RecordIndexer::EVM_RecordIndexer() : SampleType(EVM_SAMPLE_INT32), nEntries(0), Open(false)
+{
+    memset(&Entry, 0, sizeof(Entry));
+}
+
+void EVM_RecordIndexer::Start(int SampleType)
+{
+    this->SampleType = SampleType;
+    Out.clear();
+    nEntries = 0;
+    Open = false;
+}
+
+void EVM_RecordIndexer::Add(long long Offset, const EVM_BlockInfo& Info, const void* Data, size_t Bytes, int Width)
+{
+    // A block goes on the open entry if it follows it in the file and in the stream
+    bool Follows = Open && Info.Frame == Entry.Frame && Info.Group == Entry.Group && Width == Entry.Width &&
+                   Offset == Entry.Offset + Entry.Bytes && Entry.Bytes < EVM_RECORD_ENTRY_BYTES &&
+                   (Width == 0 || Info.SampleIndex == Entry.FirstSample + Entry.Samples);
+    if (!Follows)
+    {
+        Flush();
+        Entry.Offset = Offset;
+        Entry.FirstSample = Info.SampleIndex;
+        Entry.Samples = 0;
+        Entry.Bytes = 0;
+        Entry.Blocks = 0;
+        Entry.Frame = Info.Frame;
+        Entry.Group = Info.Group;
+        Entry.Width = Width;
+        Entry.AorB = Info.AorB;
+        Entry.Time = Info.Time;
+        Min.assign(Width, HUGE_VAL);
+        Max.assign(Width, -HUGE_VAL);
+        Sum.assign(Width, 0.0);
+        Count.assign(Width, 0);
+        Open = true;
+    }
+    Entry.Samples += Info.Samples;
+    Entry.Bytes += (int)RecordSize(Bytes);
+    Entry.Blocks++;
+    if (Width == 0) return;
+
+    // A channel major block cut within a row can't be told apart by channel, it is left out of the summary
+    const bool ChannelMajor = (SampleType & EVM_LAYOUT_MASK) == EVM_LAYOUT_CHANNEL_MAJOR;
+    const long n = Info.Samples;
+    if (ChannelMajor && (n % Width != 0 || Info.SampleIndex % Width != 0)) return;
+    switch (SampleType & EVM_SAMPLE_TYPE_MASK)
+    {
+    case EVM_SAMPLE_INT32: Fold((const int*)Data, n, Info.SampleIndex, Width, ChannelMajor, Min.data(), Max.data(), Sum.data(), Count.data()); break;
+    case EVM_SAMPLE_UINT16: Fold((const unsigned short*)Data, n, Info.SampleIndex, Width, ChannelMajor, Min.data(), Max.data(), Sum.data(), Count.data()); break;
+    case EVM_SAMPLE_FLOAT32: Fold((const float*)Data, n, Info.SampleIndex, Width, ChannelMajor, Min.data(), Max.data(), Sum.data(), Count.data()); break;
+    case EVM_SAMPLE_FLOAT64: Fold((const double*)Data, n, Info.SampleIndex, Width, ChannelMajor, Min.data(), Max.data(), Sum.data(), Count.data()); break;
+    }
+}
+
+void EVM_RecordIndexer::Flush()
+{
+    if (!Open) return;
+    size_t At = Out.size();
+    Out.resize(At + sizeof(Entry) + Entry.Width * sizeof(EVM_RecordSummary));
+    memcpy(Out.data() + At, &Entry, sizeof(Entry));
+
+    EVM_RecordSummary* S = (EVM_RecordSummary*)(Out.data() + At + sizeof(Entry));
+    for (int c = 0; c < Entry.Width; c++)
+    {
+        bool Any = (Count[c] > 0);
+        S[c].Min = Any ? (float)Min[c] : 0.0f;
+        S[c].Max = Any ? (float)Max[c] : 0.0f;
+        S[c].Mean = Any ? (float)(Sum[c] / Count[c]) : 0.0f;
+    }
+    nEntries++;
+    Open = false;
+}
+
+//===================================================================================================================
+
+EVM_Archive::EVM_Archive() : File(INVALID_HANDLE_VALUE), Loaded(nullptr)
+{
+    memset(&Header, 0, sizeof(Header));
+}
+
+EVM_Archive::~EVM_Archive()
+{
+    if (File != INVALID_HANDLE_VALUE) CloseHandle(File);
+}
+
+bool EVM_Archive::Open(const char* Path)
+{
+    File = CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (File == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER Size;
+    if (!GetFileSizeEx(File, &Size) || Size.QuadPart < EVM_RECORD_ALIGN) return false;
+    if (!Read(0, &Header, sizeof(Header))) return false;
+    if (memcmp(Header.Magic, "EVMREC1", 8) != 0 || Header.Version != 2) return false;
+
+    EVM_RecordTrailer Trailer;
+    const long long End = Size.QuadPart - (long long)sizeof(Trailer);
+    bool Indexed = Read(End, &Trailer, sizeof(Trailer)) && Trailer.Magic == EVM_RECORD_INDEX_MAGIC &&
+                   Trailer.IndexOffset >= EVM_RECORD_ALIGN && Trailer.IndexOffset <= End;
+    if (Indexed)
+    {
+        Index.resize((size_t)(End - Trailer.IndexOffset));
+        if (!Read(Trailer.IndexOffset, Index.data(), Index.size())) return false;
+    }
+    else if (!Rebuild(Size.QuadPart)) return false;
+
+    Entries.clear();
+    for (size_t o = 0; o + sizeof(EVM_RecordEntry) <= Index.size();)
+    {
+        const EVM_RecordEntry* E = (const EVM_RecordEntry*)(Index.data() + o);
+        Entries.push_back(E);
+        o += sizeof(EVM_RecordEntry) + E->Width * sizeof(EVM_RecordSummary);
+    }
+    return !Indexed || (int)Entries.size() == Trailer.Entries;
+}
+
+bool EVM_Archive::Read(long long Offset, void* Data, size_t Bytes)
+{
+    OVERLAPPED Ov;
+    memset(&Ov, 0, sizeof(Ov));
+    Ov.Offset = (DWORD)Offset;
+    Ov.OffsetHigh = (DWORD)(Offset >> 32);
+    DWORD Done = 0;
+    return ReadFile(File, Data, (DWORD)Bytes, &Done, &Ov) && Done == Bytes;
+}
+
+// Indexes the blocks of a recording that has none, up to the first one that is incomplete
+bool EVM_Archive::Rebuild(long long End)
+{
+    EVM_RecordIndexer Indexer;
+    Indexer.Start(Header.SampleType);
+
+    long long Offset = EVM_RECORD_ALIGN;
+    EVM_RecordBlock B;
+    while (Offset + (long long)sizeof(B) <= End && Read(Offset, &B, sizeof(B)) && B.Magic == EVM_RECORD_BLOCK_MAGIC)
+    {
+        long long Next = Offset + (long long)RecordSize(B.Bytes);
+        if (Next > End) break;
+        Buffer.resize(B.Bytes);
+        if (!Read(Offset + sizeof(B), Buffer.data(), B.Bytes)) return false;
+        Indexer.Add(Offset, B.Info, Buffer.data(), B.Bytes, B.Width);
+        Offset = Next;
+    }
+    Indexer.Flush();
+    Index = Indexer.Index();
+    return true;
+}
+
+// Reads the blocks of entry E into Buffer
+bool EVM_Archive::Load(const EVM_RecordEntry* E)
+{
+    if (Loaded == E) return true;
+    Loaded = nullptr;
+    Buffer.resize(E->Bytes);
+    if (!Read(E->Offset, Buffer.data(), E->Bytes)) return false;
+    Loaded = E;
+    return true;
+}
+
+bool EVM_Archive::Selects(const EVM_RecordEntry* E, int Frame, int Group, int Channel) const
+{
+    return Channel < E->Width && (Frame < 0 || E->Frame == Frame) && E->Group == Group;
+}
+
+template <typename F>
+void EVM_Archive::Scan(int Channel, long long FirstRow, long long EndRow, F Fn) const
+{
+    const int Type = Header.SampleType;
+    const bool ChannelMajor = (Type & EVM_LAYOUT_MASK) == EVM_LAYOUT_CHANNEL_MAJOR;
+
+    for (size_t o = 0; o < Buffer.size();)
+    {
+        const EVM_RecordBlock* B = (const EVM_RecordBlock*)(Buffer.data() + o);
+        const unsigned char* Data = (const unsigned char*)(B + 1);
+        o += RecordSize(B->Bytes);
+
+        const long long W = B->Width;
+        const long long First = B->Info.SampleIndex;
+        const long long Last = First + B->Info.Samples - 1;
+        if (ChannelMajor)
+        {
+            if (B->Info.Samples % W != 0 || First % W != 0) continue;
+            long long Rows = B->Info.Samples / W;
+            long long Row0 = First / W;
+            long long a = max(Row0, FirstRow), b = min(Row0 + Rows, EndRow);
+            for (long long r = a; r < b; r++) Fn(r, Value(Data, Type, (size_t)(Channel * Rows + r - Row0)));
+        }
+        else
+        {
+            // Rows whose sample of Channel falls in the block
+            long long a = max((First - Channel + W - 1) / W, FirstRow);
+            long long b = min((Last >= Channel) ? (Last - Channel) / W + 1 : 0, EndRow);
+            for (long long r = a; r < b; r++) Fn(r, Value(Data, Type, (size_t)(r * W + Channel - First)));
+        }
+    }
+}
+
+// Rows of the frame and group recorded, counted from row 0
+long long EVM_Archive::Rows(int Frame, int Group) const
+{
+    long long n = 0;
+    for (const EVM_RecordEntry* E : Entries)
+    {
+        if (Selects(E, Frame, Group, 0)) n = max(n, (E->FirstSample + E->Samples + E->Width - 1) / E->Width);
+    }
+    return n;
+}
+
+long EVM_Archive::ReadChannel(int Frame, int Group, int Channel, long long FirstRow, long nRows, double* Out)
+{
+    for (long r = 0; r < nRows; r++) Out[r] = NaN;
+
+    const long long EndRow = FirstRow + nRows;
+    long Filled = 0;
+    for (const EVM_RecordEntry* E : Entries)
+    {
+        if (!Selects(E, Frame, Group, Channel)) continue;
+        long long a = E->FirstSample / E->Width, b = (E->FirstSample + E->Samples - 1) / E->Width + 1;
+        if (b <= FirstRow || a >= EndRow) continue;
+
+        if (!Load(E)) return(-17);
+        Scan(Channel, FirstRow, EndRow, [&](long long Row, double v) {
+            Out[Row - FirstRow] = v;
+            Filled++;
+        });
+    }
+    return(Filled);
+}
+
+long EVM_Archive::Overview(int Frame, int Group, int Channel, long long FirstRow, long long nRows, int nBins, float* Min, float* Max, float* Mean)
+{
+    std::vector<double> Lo(nBins, HUGE_VAL), Hi(nBins, -HUGE_VAL), Sum(nBins, 0.0), n(nBins, 0.0);
+    const long long EndRow = FirstRow + nRows;
+    const double Scale = (double)nBins / nRows;
+    auto Bin = [&](long long Row) { return min((int)((Row - FirstRow) * Scale), nBins - 1); };
+
+    for (const EVM_RecordEntry* E : Entries)
+    {
+        if (!Selects(E, Frame, Group, Channel)) continue;
+        long long a = E->FirstSample / E->Width, b = (E->FirstSample + E->Samples - 1) / E->Width + 1;
+        if (b <= FirstRow || a >= EndRow) continue;
+
+        // An entry within one bin is taken from its summary, only the ones spread over several are read
+        if (a >= FirstRow && b <= EndRow && Bin(a) == Bin(b - 1))
+        {
+            const EVM_RecordSummary& S = ((const EVM_RecordSummary*)(E + 1))[Channel];
+            int k = Bin(a);
+            Lo[k] = min(Lo[k], (double)S.Min);
+            Hi[k] = max(Hi[k], (double)S.Max);
+            Sum[k] += (double)S.Mean * (b - a);
+            n[k] += (double)(b - a);
+            continue;
+        }
+        if (!Load(E)) return(-17);
+        Scan(Channel, FirstRow, EndRow, [&](long long Row, double v) {
+            int k = Bin(Row);
+            Lo[k] = min(Lo[k], v);
+            Hi[k] = max(Hi[k], v);
+            Sum[k] += v;
+            n[k] += 1.0;
+        });
+    }
+
+    long Filled = 0;
+    for (int k = 0; k < nBins; k++)
+    {
+        bool Any = (n[k] > 0);
+        Min[k] = (float)(Any ? Lo[k] : NaN);
+        Max[k] = (float)(Any ? Hi[k] : NaN);
+        Mean[k] = (float)(Any ? Sum[k] / n[k] : NaN);
+        if (Any) Filled++;
+    }
+    return(Filled);
+}
+
+//===================================================================================================================
+
+// Opens a recording of EVM_StreamRecord for reading, null if it can't be read. Only its index is loaded; a
+// recording cut short, without one, is indexed by reading it through once.
+EVM_ARCHIVE __stdcall EVM_ArchiveOpen(char* Path)
+{
+    if (Path == nullptr) return(nullptr);
+    EVM_Archive* Archive = new EVM_Archive();
+    if (!Archive->Open(Path))
+    {
+        delete Archive;
+        return(nullptr);
+    }
+    return(Archive);
+}
+
+void __stdcall EVM_ArchiveClose(EVM_ARCHIVE Archive)
+{
+    delete Archive;
+}
+
+// Copies the header of the recording, returns the entries of its index
+long __stdcall EVM_ArchiveGetHeader(EVM_ARCHIVE Archive, EVM_RecordHeader* Header)
+{
+    if (Archive == nullptr || Header == nullptr) return(-7);
+    *Header = Archive->Header;
+    return (long)Archive->Entries.size();
+}
+
+// Copies up to nEntries entries of the index from entry First, without their summaries. Returns the entries copied.
+long __stdcall EVM_ArchiveGetIndex(EVM_ARCHIVE Archive, int First, int nEntries, EVM_RecordEntry* Entries)
+{
+    if (Archive == nullptr || First < 0 || nEntries < 0 || (nEntries > 0 && Entries == nullptr)) return(-7);
+    long n = max(0L, min((long)nEntries, (long)Archive->Entries.size() - First));
+    for (long i = 0; i < n; i++) Entries[i] = *Archive->Entries[First + i];
+    return(n);
+}
+
+// Rows recorded in frame Frame of Group, counted from its first row. Frame -1 for any frame, as for the filter
+// groups whose rows carry on across frames. 0 for event records.
+long long __stdcall EVM_ArchiveRows(EVM_ARCHIVE Archive, int Frame, int Group)
+{
+    if (Archive == nullptr) return(-7);
+    return Archive->Rows(Frame, Group);
+}
+
+// Reads the samples of Channel (its position in the row, as recorded) in rows FirstRow to FirstRow + nRows - 1
+// of Frame and Group into Out, as doubles of the recorded unit. Only the entries holding them are read. Rows
+// not recorded are set to NaN. Returns the rows read, -17 if the file can't be read.
+long __stdcall EVM_ArchiveReadChannel(EVM_ARCHIVE Archive, int Frame, int Group, int Channel, long long FirstRow, long nRows,
+                                      double* Out)
+{
+    if (Archive == nullptr || Channel < 0 || FirstRow < 0 || nRows < 0 || (nRows > 0 && Out == nullptr)) return(-7);
+    return Archive->ReadChannel(Frame, Group, Channel, FirstRow, nRows, Out);
+}
+
+// Minimum, maximum and mean of Channel over nBins equal bins of rows FirstRow to FirstRow + nRows - 1, for a
+// zoomed out view. Bins wider than the entries of the index come from their summaries without reading the
+// data. Bins without data are NaN. Returns the bins filled, -17 if the file can't be read.
+long __stdcall EVM_ArchiveOverview(EVM_ARCHIVE Archive, int Frame, int Group, int Channel, long long FirstRow, long long nRows,
+                                   int nBins, float* Min, float* Max, float* Mean)
+{
+    if (Archive == nullptr || Channel < 0 || FirstRow < 0 || nRows <= 0 || nBins <= 0) return(-7);
+    if (Min == nullptr || Max == nullptr || Mean == nullptr) return(-7);
+    return Archive->Overview(Frame, Group, Channel, FirstRow, nRows, nBins, Min, Max, Mean);
+}
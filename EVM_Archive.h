@@ -0,0 +1,83 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ *
+ * Index of a recording and random access to it. The recorder feeds every block it writes
+ * to an EVM_RecordIndexer, which gathers them in entries of about a megabyte with the
+ * minimum, maximum and mean of each channel, and appends the index at the end of the
+ * file. A reader loads only the index, then reads the entries a slice overlaps, or none
+ * at all for an overview whose bins are wider than the entries.
+ */
+
+#ifndef EVM_ARCHIVE_H
+#define EVM_ARCHIVE_H
+
+#include <vector>
+
+class EVM_RecordIndexer
+{
+public:
+    EVM_RecordIndexer();
+
+    // Clears the index for blocks of SampleType, EVM_SAMPLE_xxx | EVM_LAYOUT_xxx
+    void Start(int SampleType);
+
+    // Adds the block of Bytes bytes of data whose record starts at Offset in the file
+    void Add(long long Offset, const EVM_BlockInfo& Info, const void* Data, size_t Bytes, int Width);
+
+    // Closes the last entry, the index is then complete
+    void Flush();
+
+    const std::vector<unsigned char>& Index() const { return Out; }
+    int Entries() const { return nEntries; }
+
+private:
+    int SampleType;
+    std::vector<unsigned char> Out;
+    int nEntries;
+
+    // Entry being gathered
+    bool Open;
+    EVM_RecordEntry Entry;
+    std::vector<double> Min, Max, Sum;
+    std::vector<long long> Count;
+};
+
+struct EVM_Archive
+{
+    HANDLE File;
+    EVM_RecordHeader Header;
+    std::vector<unsigned char> Index;
+    std::vector<const EVM_RecordEntry*> Entries;
+    std::vector<unsigned char> Buffer;        // Blocks of the entry last read
+    const EVM_RecordEntry* Loaded;
+
+    EVM_Archive();
+    ~EVM_Archive();
+
+    // Loads the index of the recording at Path, rebuilding it if the recording was cut short
+    bool Open(const char* Path);
+    long long Rows(int Frame, int Group) const;
+    long ReadChannel(int Frame, int Group, int Channel, long long FirstRow, long nRows, double* Out);
+    long Overview(int Frame, int Group, int Channel, long long FirstRow, long long nRows, int nBins, float* Min, float* Max, float* Mean);
+
+private:
+    EVM_Archive(const EVM_Archive&);
+    EVM_Archive& operator=(const EVM_Archive&);
+
+    bool Read(long long Offset, void* Data, size_t Bytes);
+    bool Rebuild(long long End);
+    bool Load(const EVM_RecordEntry* E);
+    bool Selects(const EVM_RecordEntry* E, int Frame, int Group, int Channel) const;
+
+    // Calls Fn(Row, Value) for every sample of Channel in the blocks of the loaded entry within [FirstRow, EndRow)
+    template <typename F> void Scan(int Channel, long long FirstRow, long long EndRow, F Fn) const;
+};
+
+#endif // EVM_ARCHIVE_H
@@ -0,0 +1,100 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ */
+
+#include "StdAfx.h"
+#include "DDC264EVM_IO.h"
+#include "EVM_Average.h"
+
+#include <algorithm>
+#include <math.h>
+
+EVM_Average::EVM_Average() : Samples(0), Capture(0), RejectSigma(0), Rejecting(false)
+{
+}
+
+void EVM_Average::Setup(long n, bool Squares, double RejectSigma)
+{
+    Samples = n;
+    Capture = 0;
+    this->RejectSigma = RejectSigma;
+    Rejecting = false;
+    Ref.assign(n, 0);
+    Sum.assign(n, 0);
+    SumSq.assign((Squares || RejectSigma > 0) ? n : 0, 0);
+    Count.assign(n, 0);
+    Lo.assign((RejectSigma > 0) ? n : 0, 0);
+    Hi.assign((RejectSigma > 0) ? n : 0, 0);
+}
+
+void EVM_Average::NextCapture()
+{
+    Capture++;
+    if (Capture == 1)
+    {
+        // The first capture only sets the reference: its deviations are all 0
+        std::fill(Count.begin(), Count.end(), 1);
+        return;
+    }
+    Rejecting = (RejectSigma > 0 && Capture > EVM_AVERAGE_WARMUP);
+    if (!Rejecting)
+    {
+        // Every code of the capture is kept, a rejecting pass counts the ones it keeps itself
+        for (long i = 0; i < Samples; i++) Count[i]++;
+        return;
+    }
+
+    for (long i = 0; i < Samples; i++)
+    {
+        double Mean = (double)Sum[i] / Count[i];
+        double Spread = sqrt(max(0.0, (double)SumSq[i] / Count[i] - Mean * Mean));
+        double Limit = RejectSigma * max(Spread, 1.0);
+        Lo[i] = (int)ceil(Mean - Limit);
+        Hi[i] = (int)floor(Mean + Limit);
+    }
+}
+
+void EVM_Average::Add(const unsigned char* DataCap, long Len, long First, int Format)
+{
+    long n = Len / 4;
+    if (Capture == 0 || First < 0 || First + n > Samples) return;
+
+    if (Capture == 1)
+    {
+        // Same masking as the accumulation: deviations from a zero reference are the codes
+        EVM_AverageSums Codes = { Ref.data(), Sum.data(), nullptr, nullptr, nullptr, nullptr };
+        AccumulateSamples(DataCap, Len, First, Codes, Format);
+        std::copy(Sum.begin() + First, Sum.begin() + First + n, Ref.begin() + First);
+        std::fill(Sum.begin() + First, Sum.begin() + First + n, 0);
+        return;
+    }
+
+    EVM_AverageSums Sums = { Ref.data(), Sum.data(), SumSq.empty() ? nullptr : SumSq.data(), Count.data(),
+                             Rejecting ? Lo.data() : nullptr, Rejecting ? Hi.data() : nullptr };
+    AccumulateSamples(DataCap, Len, First, Sums, Format);
+}
+
+long long EVM_Average::Finish(double* Mean, double* Variance, double Gain, double Offset) const
+{
+    long long Left = 0;
+    for (long i = 0; i < Samples; i++)
+    {
+        int n = (Capture > 0) ? Count[i] : 0;
+        Left += Capture - n;
+        double m = (n > 0) ? (double)Sum[i] / n : 0.0;
+        Mean[i] = (Ref[i] + m - Offset) * Gain;
+        if (Variance != nullptr && !SumSq.empty())
+        {
+            double v = (n > 1) ? ((double)SumSq[i] - m * (double)Sum[i]) / (n - 1) : 0.0;
+            Variance[i] = max(0.0, v) * Gain * Gain;
+        }
+    }
+    return Left;
+}
@@ -0,0 +1,65 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ *
+ * Averaging of repeated captures on the host. Each transfer is added into per sample
+ * 64 bits sums as it is decoded, so the memory is a few frames of sums whatever the
+ * number of captures and no capture is ever stored. Samples far from the mean of the
+ * captures before them can be left out of the average.
+ */
+
+#ifndef EVM_AVERAGE_H
+#define EVM_AVERAGE_H
+
+#include "EVM_Decode.h"
+
+#include <vector>
+
+// Captures always kept before outliers are looked for, the mean and spread come from them
+const int EVM_AVERAGE_WARMUP = 4;
+
+// Deviations of up to 24 bits squared fit 63 bits for this many captures
+const int EVM_AVERAGE_MAX_CAPTURES = 32767;
+
+class EVM_Average
+{
+public:
+    EVM_Average();
+
+    // Sums for n samples per capture. The squares are kept for the variance and the rejection, which leaves
+    // out the codes further than RejectSigma standard deviations from the mean; 0 keeps every code.
+    void Setup(long n, bool Squares, double RejectSigma);
+
+    // Starts the next capture. From capture EVM_AVERAGE_WARMUP on the limits of each sample are set
+    // from the codes kept so far, the spread taken as at least one code.
+    void NextCapture();
+
+    // Adds Len bytes of raw words holding samples First onwards of the current capture, Format EVM_DECODE_xxx
+    void Add(const unsigned char* DataCap, long Len, long First, int Format);
+
+    // Mean and, if Variance is not null, unbiased variance of the codes kept for every sample,
+    // scaled as (code - Offset) * Gain. Returns the codes left out.
+    long long Finish(double* Mean, double* Variance, double Gain, double Offset) const;
+
+    int Captures() const { return Capture; }
+
+private:
+    long Samples;
+    int Capture;
+    double RejectSigma;
+    bool Rejecting;
+    std::vector<int> Ref;
+    std::vector<long long> Sum;
+    std::vector<long long> SumSq;
+    std::vector<int> Count;
+    std::vector<int> Lo;
+    std::vector<int> Hi;
+};
+
+#endif // EVM_AVERAGE_H
@@ -0,0 +1,204 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ */
+
+#include "StdAfx.h"
+#include "CyApi.h"
+#include "DDC264EVM_IO.h"
+#include "EVM_Registers.h"
+#include "EVM_Internal.h"
+#include "EVM_Board.h"
+
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <memory>
+
+EVM_Board::EVM_Board() : Busy(false), Streaming(false), HasPending(false), Queued(0), Sending(0), Withdrawn(0), Applied(0), FailedTicket(0),
+    Failed(0)
+{
+    for (int i = 0; i < EVM_REG_COUNT; i++) Regs[i] = -1;
+}
+
+long EVM_Board::BeginExchange()
+{
+    std::unique_lock<std::mutex> L(Lock);
+    Changed.wait(L, [this] { return !Busy; });
+    if (Streaming) return(-14);
+    Busy = true;
+    return(0);
+}
+
+void EVM_Board::EndExchange()
+{
+    std::lock_guard<std::mutex> L(Lock);
+    Busy = false;
+    Changed.notify_all();
+}
+
+long EVM_Board::Control(const unsigned char* Bytes, long Length, int TimeoutMs)
+{
+    std::unique_lock<std::mutex> L(Lock);
+    Changed.wait(L, [this] { return !Busy; });
+    if (!Streaming)
+    {
+        Busy = true;
+        return(1);
+    }
+
+    // Nothing to write, as a RegsTransfer with no register enabled: the cache answers it
+    if (Length <= 0) return(0);
+
+    Pending.insert(Pending.end(), Bytes, Bytes + Length);
+    const long long Ticket = ++Queued;
+    PendingEnds.push_back(std::make_pair(Ticket, Pending.size()));
+    HasPending = true;
+    // The stream left queued writes to EndStream, so they are always handled
+    if (!Changed.wait_for(L, std::chrono::milliseconds(TimeoutMs), [&] { return Applied >= Ticket; }))
+    {
+        // Still queued: taken back, so a write reported as failed is never sent later. The writes queued before
+        // and after it stay, and the next send still counts its ticket as handled.
+        if (Ticket > Sending)
+        {
+            size_t i = 0;
+            while (PendingEnds[i].first != Ticket) i++;
+            size_t Begin = (i > 0) ? PendingEnds[i - 1].second : 0;
+            Pending.erase(Pending.begin() + Begin, Pending.begin() + PendingEnds[i].second);
+            for (size_t j = i + 1; j < PendingEnds.size(); j++) PendingEnds[j].second -= Length;
+            PendingEnds.erase(PendingEnds.begin() + i);
+            Withdrawn++;
+            return(-4);
+        }
+        // Already on its way, its outcome comes within the timeout of the send
+        Changed.wait(L, [&] { return Applied >= Ticket; });
+    }
+    return (FailedTicket >= Ticket) ? -5 : 0;
+}
+
+long EVM_Board::BeginStream()
+{
+    std::unique_lock<std::mutex> L(Lock);
+    Changed.wait(L, [this] { return !Busy; });
+    if (Streaming) return(-14);
+    Streaming = true;
+    return(0);
+}
+
+void EVM_Board::EndStream(CCyUSBDevice* USBDevice)
+{
+    std::unique_lock<std::mutex> L(Lock);
+    // A write queued while the last batch was being sent is still to go
+    while (HasPending) Send(USBDevice, L);
+    Streaming = false;
+    Changed.notify_all();
+}
+
+void EVM_Board::ApplyControl(CCyUSBDevice* USBDevice)
+{
+    // Looked at after every transfer, the lock is only taken when there is something to send
+    if (!HasPending.load(std::memory_order_relaxed)) return;
+    std::unique_lock<std::mutex> L(Lock);
+    if (HasPending) Send(USBDevice, L);
+}
+
+// Sends the queued writes with the lock released, so the exports can queue more meanwhile
+long EVM_Board::Send(CCyUSBDevice* USBDevice, std::unique_lock<std::mutex>& L)
+{
+    std::vector<unsigned char> Bytes;
+    Bytes.swap(Pending);
+    PendingEnds.clear();
+    const long long Ticket = Queued;
+    const long long Taken = Withdrawn;
+    Sending = Ticket;
+    Withdrawn = 0;
+    HasPending = false;
+
+    // Every write of the batch may have been taken back
+    L.unlock();
+    bool Sent = Bytes.empty() || SendPacket(USBDevice, Bytes.data(), (long)Bytes.size(), 250);
+    L.lock();
+
+    if (Sent) for (size_t i = 0; i + 1 < Bytes.size(); i += 2) Regs[Bytes[i]] = Bytes[i + 1];
+    else
+    {
+        Failed += Ticket - Applied - Taken;
+        FailedTicket = Ticket;
+    }
+    // The writes taken back were not sent
+    Failed += Taken;
+    Applied = Ticket;
+    Changed.notify_all();
+    return Sent ? 0 : -5;
+}
+
+void EVM_Board::Note(const unsigned char* Pairs, long Length)
+{
+    std::lock_guard<std::mutex> L(Lock);
+    for (long i = 0; i + 1 < Length; i += 2) Regs[Pairs[i]] = Pairs[i + 1];
+}
+
+void EVM_Board::Registers(int* Regs)
+{
+    std::lock_guard<std::mutex> L(Lock);
+    memcpy(Regs, this->Regs, sizeof(this->Regs));
+}
+
+void EVM_Board::Registers(unsigned char* Regs)
+{
+    std::lock_guard<std::mutex> L(Lock);
+    for (int i = 0; i < EVM_REG_COUNT; i++) Regs[i] = (this->Regs[i] >= 0) ? (unsigned char)this->Regs[i] : 0;
+}
+
+void EVM_Board::GetState(EVM_BoardState* State)
+{
+    std::lock_guard<std::mutex> L(Lock);
+    State->Streaming = Streaming ? 1 : 0;
+    State->Busy = Busy ? 1 : 0;
+    State->Pending = Queued - Applied - Withdrawn;
+    State->Applied = Applied - Failed;
+    State->Failed = Failed;
+    memcpy(State->Regs, Regs, sizeof(Regs));
+}
+
+EVM_Board& EVM_GetBoard(int USBdev)
+{
+    static std::mutex Lock;
+    static std::map<int, std::unique_ptr<EVM_Board>> Boards;
+
+    std::lock_guard<std::mutex> L(Lock);
+    std::unique_ptr<EVM_Board>& B = Boards[USBdev];
+    if (!B) B.reset(new EVM_Board());
+    return(*B);
+}
+
+EVM_Exchange::EVM_Exchange(int USBdev) : Board(EVM_GetBoard(USBdev)), Result(Board.BeginExchange()), Held(Result == 0)
+{
+}
+
+EVM_Exchange::EVM_Exchange(int USBdev, const unsigned char* Bytes, long Length, int TimeoutMs) :
+    Board(EVM_GetBoard(USBdev)), Result(Board.Control(Bytes, Length, TimeoutMs)), Held(Result == 1)
+{
+}
+
+EVM_Exchange::~EVM_Exchange()
+{
+    if (Held) Board.EndExchange();
+}
+
+//===================================================================================================================
+
+// State of board USBdev from the cache: whether a stream reads it, the control writes queued for it and the
+// register values last written or read back. Never touches the bus, so it can be polled during a capture.
+long __stdcall EVM_GetBoardState(int* USBdev, EVM_BoardState* State)
+{
+    if (USBdev == nullptr || State == nullptr) return(-7);
+    EVM_GetBoard(USBdev[0]).GetState(State);
+    return(0);
+}
@@ -0,0 +1,103 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ *
+ * State of each board shared by the exports that open it by USBdev and by the sessions and
+ * live readouts streaming from it. The exports hold the board for a whole exchange, so two
+ * threads never interleave their bulk traffic. While a stream reads the board it owns the
+ * data path: captures are refused and control writes are queued for its reader thread,
+ * which sends them between two transfers. Register values written or read back are cached,
+ * so status queries never touch the bus.
+ */
+
+#ifndef EVM_BOARD_H
+#define EVM_BOARD_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+class CCyUSBDevice;
+
+class EVM_Board
+{
+public:
+    EVM_Board();
+
+    // Waits for the exchange in progress and holds the board for this one. Returns 0, -14 if a stream reads it.
+    long BeginExchange();
+    void EndExchange();
+
+    // Command bytes of an export. While a stream reads the board they are queued for it and this waits up to
+    // TimeoutMs until they are sent: returns 0, -4 if they are still queued then, taken back and never sent, or
+    // -5 if they couldn't be sent. Returns 0 at once for no bytes. Otherwise it holds the board as BeginExchange
+    // for the caller to send them and returns 1.
+    long Control(const unsigned char* Bytes, long Length, int TimeoutMs);
+
+    // For a session or live readout starting, -14 if the board already streams
+    long BeginStream();
+    // Sends the control writes still queued, then gives the board back to the exports
+    void EndStream(CCyUSBDevice* USBDevice);
+    // Sends the control writes queued since the last call. Called by the reader thread between transfers.
+    void ApplyControl(CCyUSBDevice* USBDevice);
+
+    // Notes the register values of (address, value) pairs written or read back
+    void Note(const unsigned char* Pairs, long Length);
+    // Register values last written or read back, -1 if unknown
+    void Registers(int* Regs);
+    void Registers(unsigned char* Regs);
+    void GetState(EVM_BoardState* State);
+
+private:
+    EVM_Board(const EVM_Board&);
+    EVM_Board& operator=(const EVM_Board&);
+
+    long Send(CCyUSBDevice* USBDevice, std::unique_lock<std::mutex>& L);
+
+    std::mutex Lock;
+    std::condition_variable Changed;
+    bool Busy;                          // An export is exchanging with the board
+    bool Streaming;
+    std::vector<unsigned char> Pending; // Control writes for the reader thread
+    std::vector<std::pair<long long, size_t>> PendingEnds;  // Ticket of each and where its bytes end
+    std::atomic<bool> HasPending;
+    long long Queued;                   // Control writes queued, the ticket of the last one
+    long long Sending;                  // Ticket of the last one the reader thread took to send
+    long long Withdrawn;                // Taken back on timeout since, the reader still counts them
+    long long Applied;                  // Tickets handled by the reader thread
+    long long FailedTicket;             // Last one it couldn't send
+    long long Failed;
+    int Regs[EVM_REG_COUNT];
+};
+
+// The state of board USBdev, created on first use and kept for the life of the DLL
+EVM_Board& EVM_GetBoard(int USBdev);
+
+// Holds a board for the exchange of an export until it goes out of scope
+class EVM_Exchange
+{
+public:
+    // Result is 0 when held, -14 if a stream reads the board
+    explicit EVM_Exchange(int USBdev);
+    // Hands the command bytes to EVM_Board::Control: Result is 1 when held to send them, else what Control returned
+    EVM_Exchange(int USBdev, const unsigned char* Bytes, long Length, int TimeoutMs);
+    ~EVM_Exchange();
+
+    EVM_Board& Board;
+    const long Result;
+    const bool Held;
+
+private:
+    EVM_Exchange(const EVM_Exchange&);
+    EVM_Exchange& operator=(const EVM_Exchange&);
+};
+
+#endif // EVM_BOARD_H
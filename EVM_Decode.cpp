@@ -0,0 +1,594 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ */
+
+#include "StdAfx.h"
+#include "DDC264EVM_IO.h"
+#include "EVM_Registers.h"
+#include "EVM_Internal.h"
+#include "EVM_Decode.h"
+
+#include <limits>
+#include <math.h>
+#include <memory>
+#include <utility>
+
+#if defined(_M_IX86) || defined(_M_X64)
+  #include <intrin.h>
+  #include <tmmintrin.h>
+  #define EVM_DECODE_SSSE3
+#endif
+
+// Nominal full scale charge of the DDC264 for each Range[1:0] setting, in pC
+static const double FullScalePC[4] = { 12.5, 50.0, 100.0, 150.0 };
+
+// Channel counts with a dedicated channel major decoder: 1, 2, 4 ... 256
+static const int CHANNEL_EXPONENTS = 9;
+
+static int ChannelExponent(int Channels)
+{
+    for (int e = 0; e < CHANNEL_EXPONENTS; e++)
+    {
+        if (Channels == (1 << e)) return e;
+    }
+    return -1;
+}
+
+size_t EVM_SampleSize(int SampleType)
+{
+    switch (SampleType & EVM_SAMPLE_TYPE_MASK)
+    {
+    case EVM_SAMPLE_INT32: return sizeof(int);
+    case EVM_SAMPLE_UINT16: return sizeof(unsigned short);
+    case EVM_SAMPLE_FLOAT32: return sizeof(float);
+    case EVM_SAMPLE_FLOAT64: return sizeof(double);
+    }
+    return 0;
+}
+
+//===================================================================================================================
+// Decoders
+
+template <int Format> struct FormatOf;
+template <> struct FormatOf<EVM_DECODE_RAW24> { enum { Mask = 0xFFFFFF }; };
+template <> struct FormatOf<EVM_DECODE_16BIT> { enum { Mask = 0xFFFF }; };
+template <> struct FormatOf<EVM_DECODE_20BIT> { enum { Mask = 0xFFFFF }; };
+
+template <int Type> struct SampleOf;
+template <> struct SampleOf<EVM_SAMPLE_INT32> { typedef int T; };
+template <> struct SampleOf<EVM_SAMPLE_UINT16> { typedef unsigned short T; };
+template <> struct SampleOf<EVM_SAMPLE_FLOAT32> { typedef float T; };
+template <> struct SampleOf<EVM_SAMPLE_FLOAT64> { typedef double T; };
+
+static inline int Code(const unsigned char* w)
+{
+    return w[1] * 0x10000 + w[2] * 0x100 + w[3];
+}
+
+template <int Format, int Type>
+static inline typename SampleOf<Type>::T ToSample(const unsigned char* w, double Gain, double Bias)
+{
+    typedef typename SampleOf<Type>::T T;
+    int c = (Format == EVM_DECODE_RAW24) ? Code(w) : (Code(w) & FormatOf<Format>::Mask);
+    if (Type == EVM_SAMPLE_INT32 || Type == EVM_SAMPLE_UINT16) return (T)c;
+    return (T)(c * Gain + Bias);
+}
+
+// Scalar decode of n consecutive words, also used for the tail of the vector loops
+template <int Format, int Type>
+static void DecodeScalar(const unsigned char* Raw, long n, typename SampleOf<Type>::T* Out, const EVM_Conversion& Conv)
+{
+    const double Bias = -Conv.Offset * Conv.Gain;
+    for (long i = 0; i < n; i++, Raw += 4) Out[i] = ToSample<Format, Type>(Raw, Conv.Gain, Bias);
+}
+
+#ifdef EVM_DECODE_SSSE3
+
+static bool CpuHasSSSE3()
+{
+    int Info[4];
+    __cpuid(Info, 1);
+    return (Info[2] & (1 << 9)) != 0;
+}
+
+static const bool UseSSSE3 = CpuHasSSSE3();
+
+// Four words per vector: drop the A/B byte and swap each 24 bits value to little endian
+static inline __m128i Unpack4(const unsigned char* Raw)
+{
+    const __m128i Shuffle = _mm_setr_epi8(3, 2, 1, -128, 7, 6, 5, -128, 11, 10, 9, -128, 15, 14, 13, -128);
+    return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)Raw), Shuffle);
+}
+
+template <int Format, int Type>
+static void DecodeSSSE3(const unsigned char* Raw, long n, typename SampleOf<Type>::T* Out, const EVM_Conversion& Conv)
+{
+    const __m128i Mask = _mm_set1_epi32(FormatOf<Format>::Mask);
+    const __m128 GainPS = _mm_set1_ps((float)Conv.Gain);
+    const __m128 BiasPS = _mm_set1_ps((float)(-Conv.Offset * Conv.Gain));
+    const __m128d GainPD = _mm_set1_pd(Conv.Gain);
+    const __m128d BiasPD = _mm_set1_pd(-Conv.Offset * Conv.Gain);
+    const __m128i Pack16 = _mm_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, -128, -128, -128, -128, -128, -128, -128, -128);
+    long i = 0;
+
+    for (; i + 4 <= n; i += 4, Raw += 16)
+    {
+        __m128i v = Unpack4(Raw);
+        if (Format != EVM_DECODE_RAW24) v = _mm_and_si128(v, Mask);
+        switch (Type)
+        {
+        case EVM_SAMPLE_INT32:
+            _mm_storeu_si128((__m128i*)(Out + i), v);
+            break;
+        case EVM_SAMPLE_UINT16:
+            _mm_storel_epi64((__m128i*)(Out + i), _mm_shuffle_epi8(v, Pack16));
+            break;
+        case EVM_SAMPLE_FLOAT32:
+            _mm_storeu_ps((float*)(Out + i), _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(v), GainPS), BiasPS));
+            break;
+        case EVM_SAMPLE_FLOAT64:
+            _mm_storeu_pd((double*)(Out + i), _mm_add_pd(_mm_mul_pd(_mm_cvtepi32_pd(v), GainPD), BiasPD));
+            _mm_storeu_pd((double*)(Out + i + 2), _mm_add_pd(_mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(v, 8)), GainPD), BiasPD));
+            break;
+        }
+    }
+    DecodeScalar<Format, Type>(Raw, n - i, Out + i, Conv);
+}
+
+#endif
+
+template <int Format, int Type>
+static inline void DecodeRun(const unsigned char* Raw, long n, typename SampleOf<Type>::T* Out, const EVM_Conversion& Conv)
+{
+#ifdef EVM_DECODE_SSSE3
+    if (UseSSSE3)
+    {
+        DecodeSSSE3<Format, Type>(Raw, n, Out, Conv);
+        return;
+    }
+#endif
+    DecodeScalar<Format, Type>(Raw, n, Out, Conv);
+}
+
+// Samples in the order they arrive: channel count and Rows play no part
+template <int Format, int Type>
+static void DecodeInterleaved(const unsigned char* Raw, long n, long First, void* Out, long Rows, const EVM_Conversion& Conv)
+{
+    DecodeRun<Format, Type>(Raw, n, (typename SampleOf<Type>::T*)Out + First, Conv);
+}
+
+// Sample s goes to channel s % Channels, row s / Channels, stored at channel * Rows + row.
+// Whole rows are decoded a tile at a time and written out channel by channel with a fixed, unrolled stride.
+template <int Format, int Type, int ChExp>
+static void DecodeChannelMajor(const unsigned char* Raw, long n, long First, void* Out, long Rows, const EVM_Conversion& Conv)
+{
+    typedef typename SampleOf<Type>::T T;
+    const int Channels = 1 << ChExp;
+    const int TileRows = 8;
+    T* Dst = (T*)Out;
+    T Tile[TileRows * Channels];
+    long s = First;
+    long End = First + n;
+
+    for (; s < End && (s & (Channels - 1)) != 0; s++, Raw += 4)
+    {
+        DecodeScalar<Format, Type>(Raw, 1, Tile, Conv);
+        Dst[(s & (Channels - 1)) * Rows + (s >> ChExp)] = Tile[0];
+    }
+    while (s + Channels <= End)
+    {
+        int nRows = (int)min((long)TileRows, (End - s) >> ChExp);
+        DecodeRun<Format, Type>(Raw, nRows * Channels, Tile, Conv);
+        T* Col = Dst + (s >> ChExp);
+        for (int ch = 0; ch < Channels; ch++, Col += Rows)
+        {
+            for (int r = 0; r < nRows; r++) Col[r] = Tile[r * Channels + ch];
+        }
+        s += nRows * Channels;
+        Raw += 4 * nRows * Channels;
+    }
+    for (; s < End; s++, Raw += 4)
+    {
+        DecodeScalar<Format, Type>(Raw, 1, Tile, Conv);
+        Dst[(s & (Channels - 1)) * Rows + (s >> ChExp)] = Tile[0];
+    }
+}
+
+// Only the channels of Conv.Roi, in its order: row k of the output holds the selected samples of DVALID k.
+// Whole rows gather the selected words straight from the index list, so the work and the output scale with
+// the selection. Rows cut by the start or end of a transfer go through the position of each channel.
+template <int Format, int Type, int Layout>
+static void DecodeRoi(const unsigned char* Raw, long n, long First, void* Out, long Rows, const EVM_Conversion& Conv)
+{
+    typedef typename SampleOf<Type>::T T;
+    const int Channels = Conv.Channels;
+    const int* Index = Conv.Roi->Index.data();
+    const int* Position = Conv.Roi->Position.data();
+    const int nSel = (int)Conv.Roi->Index.size();
+    const long RowStride = (Layout == EVM_LAYOUT_CHANNEL_MAJOR) ? 1 : nSel;
+    const long SelStride = (Layout == EVM_LAYOUT_CHANNEL_MAJOR) ? Rows : 1;
+    const int* Masked = Conv.Roi->Masked.data();
+    const int nMasked = (int)Conv.Roi->Masked.size();
+    const T Fill = std::numeric_limits<T>::has_quiet_NaN ? std::numeric_limits<T>::quiet_NaN() : T(0);
+    const double Bias = -Conv.Offset * Conv.Gain;
+    T* Dst = (T*)Out;
+    long End = First + n;
+    long s = First;
+    long k = First / Channels;
+    int ch = (int)(First % Channels);
+
+    for (; s < End && ch != 0; s++, Raw += 4)
+    {
+        if (Position[ch] >= 0) Dst[k * RowStride + Position[ch] * SelStride] = ToSample<Format, Type>(Raw, Conv.Gain, Bias);
+        if (++ch == Channels) { ch = 0; k++; }
+    }
+    for (; s + Channels <= End; s += Channels, Raw += 4 * Channels, k++)
+    {
+        // Masked positions gather channel 0 and are overwritten after, the gather loop stays branch free
+        T* Row = Dst + k * RowStride;
+        for (int p = 0; p < nSel; p++) Row[p * SelStride] = ToSample<Format, Type>(Raw + 4 * Index[p], Conv.Gain, Bias);
+        for (int m = 0; m < nMasked; m++) Row[Masked[m] * SelStride] = Fill;
+    }
+    if (s < End)
+    {
+        // A row cut at the end of the transfer: its masked positions are filled here, where it starts
+        for (int m = 0; m < nMasked; m++) Dst[k * RowStride + Masked[m] * SelStride] = Fill;
+    }
+    for (; s < End; s++, Raw += 4, ch++)
+    {
+        if (Position[ch] >= 0) Dst[k * RowStride + Position[ch] * SelStride] = ToSample<Format, Type>(Raw, Conv.Gain, Bias);
+    }
+}
+
+// Every decoder, indexed by format, sample type and log2 of the channel count or layout
+struct DecodeTable
+{
+    EVM_DecodeFn Interleaved[3][4];
+    EVM_DecodeFn ChannelMajor[3][4][CHANNEL_EXPONENTS];
+    EVM_DecodeFn Roi[3][4][2];
+
+    DecodeTable()
+    {
+        AddFormat<EVM_DECODE_RAW24>();
+        AddFormat<EVM_DECODE_16BIT>();
+        AddFormat<EVM_DECODE_20BIT>();
+    }
+
+    template <int Format> void AddFormat()
+    {
+        AddType<Format, EVM_SAMPLE_INT32>();
+        AddType<Format, EVM_SAMPLE_UINT16>();
+        AddType<Format, EVM_SAMPLE_FLOAT32>();
+        AddType<Format, EVM_SAMPLE_FLOAT64>();
+    }
+
+    template <int Format, int Type> void AddType()
+    {
+        Interleaved[Format][Type] = &DecodeInterleaved<Format, Type>;
+        Roi[Format][Type][0] = &DecodeRoi<Format, Type, EVM_LAYOUT_INTERLEAVED>;
+        Roi[Format][Type][1] = &DecodeRoi<Format, Type, EVM_LAYOUT_CHANNEL_MAJOR>;
+        AddChannels<Format, Type>(std::make_integer_sequence<int, CHANNEL_EXPONENTS>());
+    }
+
+    template <int Format, int Type, int... ChExp> void AddChannels(std::integer_sequence<int, ChExp...>)
+    {
+        const EVM_DecodeFn Fn[] = { &DecodeChannelMajor<Format, Type, ChExp>... };
+        for (int e = 0; e < CHANNEL_EXPONENTS; e++) ChannelMajor[Format][Type][e] = Fn[e];
+        ChannelMajor[Format][Type][0] = Interleaved[Format][Type];  // One channel: both layouts are the same
+    }
+};
+
+static const DecodeTable Decoders;
+
+//===================================================================================================================
+
+static bool TypeValid(const EVM_Conversion& Conv)
+{
+    if (EVM_SampleSize(Conv.SampleType) == 0) return false;
+    if (Conv.Layout != EVM_LAYOUT_INTERLEAVED && Conv.Layout != EVM_LAYOUT_CHANNEL_MAJOR) return false;
+    return !(Conv.SampleType == EVM_SAMPLE_UINT16 && Conv.Format == EVM_DECODE_20BIT);
+}
+
+static EVM_DecodeFn SelectDecoder(const EVM_Conversion& Conv)
+{
+    if (!TypeValid(Conv)) return nullptr;
+    int Layout = (Conv.Layout == EVM_LAYOUT_CHANNEL_MAJOR) ? 1 : 0;
+
+    if (Conv.Roi != nullptr)
+    {
+        if ((int)Conv.Roi->Position.size() != Conv.Channels) return nullptr;
+        return Decoders.Roi[Conv.Format][Conv.SampleType][Layout];
+    }
+    if (Layout == 0) return Decoders.Interleaved[Conv.Format][Conv.SampleType];
+
+    int e = ChannelExponent(Conv.Channels);
+    return (e >= 0) ? Decoders.ChannelMajor[Conv.Format][Conv.SampleType][e] : nullptr;
+}
+
+EVM_Conversion EVM_MakeConversion(int SampleType, unsigned char CFGHIGH, int Channels)
+{
+    // The output code for zero input is about 0.4% of full scale: 4096 in 20 bits, 256 in 16 bits
+    bool Format20 = (EVM_CFG_FORMAT::Get(CFGHIGH) == 1);
+    double MaxCode = Format20 ? 1048575.0 : 65535.0;
+    double Offset = Format20 ? 4096.0 : 256.0;
+
+    EVM_Conversion Conv;
+    Conv.SampleType = SampleType & EVM_SAMPLE_TYPE_MASK;
+    Conv.Layout = SampleType & EVM_LAYOUT_MASK;
+    Conv.Format = Format20 ? EVM_DECODE_20BIT : EVM_DECODE_16BIT;
+    Conv.Channels = Channels;
+    Conv.Offset = Offset;
+    Conv.Gain = FullScalePC[EVM_CFG_RANGE::Get(CFGHIGH)] / (MaxCode - Offset);
+    Conv.Roi = nullptr;
+    Conv.Fn = SelectDecoder(Conv);
+    return Conv;
+}
+
+EVM_Conversion EVM_RawConversion()
+{
+    EVM_Conversion Conv = EVM_MakeConversion(EVM_SAMPLE_INT32, 0, 0);
+    Conv.Format = EVM_DECODE_RAW24;
+    Conv.Fn = SelectDecoder(Conv);
+    return Conv;
+}
+
+bool EVM_MakeRoi(EVM_Roi& Roi, int Channels, int nSelected, const int* ChannelList)
+{
+    if (Channels <= 0 || nSelected <= 0 || nSelected > Channels || ChannelList == nullptr) return false;
+
+    Roi.Index.assign(ChannelList, ChannelList + nSelected);
+    Roi.Position.assign(Channels, -1);
+    Roi.Masked.clear();
+    for (int p = 0; p < nSelected; p++)
+    {
+        int ch = ChannelList[p];
+        if (ch < 0 || ch >= Channels || Roi.Position[ch] >= 0) return false;
+        Roi.Position[ch] = p;
+    }
+    return true;
+}
+
+bool EVM_MakeImageRoi(EVM_Roi& Roi, int Channels, int nPixels, const int* ChannelList)
+{
+    if (Channels <= 0 || nPixels <= 0 || ChannelList == nullptr) return false;
+
+    Roi.Index.assign(nPixels, 0);
+    Roi.Position.assign(Channels, -1);
+    Roi.Masked.clear();
+    for (int p = 0; p < nPixels; p++)
+    {
+        int ch = ChannelList[p];
+        if (ch == -1)
+        {
+            Roi.Masked.push_back(p);
+            continue;
+        }
+        if (ch < 0 || ch >= Channels || Roi.Position[ch] >= 0) return false;
+        Roi.Index[p] = ch;
+        Roi.Position[ch] = p;
+    }
+    return true;
+}
+
+void EVM_ApplyRoi(EVM_Conversion& Conv, const EVM_Roi* Roi)
+{
+    Conv.Roi = Roi;
+    Conv.Fn = SelectDecoder(Conv);
+}
+
+void DecodeSamples(const unsigned char* DataCap, long Len, long First, void* Out, long Rows, const EVM_Conversion& Conv)
+{
+    Conv.Fn(DataCap, Len / 4, First, Out, Rows, Conv);
+}
+
+void DecodeSamples(const unsigned char* DataCap, long Len, int* DataArray)
+{
+    static const EVM_Conversion Raw = EVM_RawConversion();
+    DecodeSamples(DataCap, Len, 0, DataArray, 0, Raw);
+}
+
+void StoreCodes(const double* Codes, long n, void* Out, const EVM_Conversion& Conv)
+{
+    const double Bias = -Conv.Offset * Conv.Gain;
+    for (long i = 0; i < n; i++)
+    {
+        switch (Conv.SampleType)
+        {
+        case EVM_SAMPLE_INT32: ((int*)Out)[i] = (int)floor(Codes[i] + 0.5); break;
+        case EVM_SAMPLE_UINT16: ((unsigned short*)Out)[i] = (unsigned short)floor(Codes[i] + 0.5); break;
+        case EVM_SAMPLE_FLOAT32: ((float*)Out)[i] = (float)(Codes[i] * Conv.Gain + Bias); break;
+        case EVM_SAMPLE_FLOAT64: ((double*)Out)[i] = Codes[i] * Conv.Gain + Bias; break;
+        }
+    }
+}
+
+//===================================================================================================================
+// Averaging
+
+template <int Format, bool Squares, bool Reject>
+static void AccumulateScalar(const unsigned char* Raw, long n, long First, const EVM_AverageSums& S)
+{
+    for (long i = First; i < First + n; i++, Raw += 4)
+    {
+        int c = (Format == EVM_DECODE_RAW24) ? Code(Raw) : (Code(Raw) & FormatOf<Format>::Mask);
+        int d = c - S.Ref[i];
+        if (Reject)
+        {
+            if (d < S.Lo[i] || d > S.Hi[i]) continue;
+            S.Count[i]++;
+        }
+        S.Sum[i] += d;
+        if (Squares) S.SumSq[i] += (long long)d * d;
+    }
+}
+
+#ifdef EVM_DECODE_SSSE3
+
+// Four deviations per vector, widened to two pairs of 64 bits sums. The squares come from the unsigned
+// 32 x 32 bits multiply of the even lanes, on the absolute deviations.
+template <int Format, bool Squares, bool Reject>
+static void AccumulateSSSE3(const unsigned char* Raw, long n, long First, const EVM_AverageSums& S)
+{
+    const __m128i Mask = _mm_set1_epi32(FormatOf<Format>::Mask);
+    const __m128i Ones = _mm_set1_epi32(-1);
+    long i = First;
+
+    for (; i + 4 <= First + n; i += 4, Raw += 16)
+    {
+        __m128i v = Unpack4(Raw);
+        if (Format != EVM_DECODE_RAW24) v = _mm_and_si128(v, Mask);
+        __m128i d = _mm_sub_epi32(v, _mm_loadu_si128((const __m128i*)(S.Ref + i)));
+        if (Reject)
+        {
+            __m128i Out = _mm_or_si128(_mm_cmplt_epi32(d, _mm_loadu_si128((const __m128i*)(S.Lo + i))),
+                                       _mm_cmpgt_epi32(d, _mm_loadu_si128((const __m128i*)(S.Hi + i))));
+            __m128i Keep = _mm_xor_si128(Out, Ones);
+            d = _mm_and_si128(d, Keep);
+            __m128i* Count = (__m128i*)(S.Count + i);
+            _mm_storeu_si128(Count, _mm_sub_epi32(_mm_loadu_si128(Count), Keep));
+        }
+
+        __m128i Sign = _mm_srai_epi32(d, 31);
+        __m128i* Sum = (__m128i*)(S.Sum + i);
+        _mm_storeu_si128(Sum, _mm_add_epi64(_mm_loadu_si128(Sum), _mm_unpacklo_epi32(d, Sign)));
+        _mm_storeu_si128(Sum + 1, _mm_add_epi64(_mm_loadu_si128(Sum + 1), _mm_unpackhi_epi32(d, Sign)));
+
+        if (Squares)
+        {
+            __m128i a = _mm_abs_epi32(d);
+            __m128i Even = _mm_mul_epu32(a, a);
+            __m128i Odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(a, 32));
+            __m128i* SumSq = (__m128i*)(S.SumSq + i);
+            _mm_storeu_si128(SumSq, _mm_add_epi64(_mm_loadu_si128(SumSq), _mm_unpacklo_epi64(Even, Odd)));
+            _mm_storeu_si128(SumSq + 1, _mm_add_epi64(_mm_loadu_si128(SumSq + 1), _mm_unpackhi_epi64(Even, Odd)));
+        }
+    }
+    AccumulateScalar<Format, Squares, Reject>(Raw, First + n - i, i, S);
+}
+
+#endif
+
+template <int Format, bool Squares, bool Reject>
+static void AccumulateRun(const unsigned char* Raw, long n, long First, const EVM_AverageSums& S)
+{
+#ifdef EVM_DECODE_SSSE3
+    if (UseSSSE3)
+    {
+        AccumulateSSSE3<Format, Squares, Reject>(Raw, n, First, S);
+        return;
+    }
+#endif
+    AccumulateScalar<Format, Squares, Reject>(Raw, n, First, S);
+}
+
+template <int Format>
+static void AccumulateFormat(const unsigned char* Raw, long n, long First, const EVM_AverageSums& S)
+{
+    bool Squares = (S.SumSq != nullptr);
+    bool Reject = (S.Lo != nullptr && S.Hi != nullptr);
+    if (Squares && Reject) AccumulateRun<Format, true, true>(Raw, n, First, S);
+    else if (Squares) AccumulateRun<Format, true, false>(Raw, n, First, S);
+    else if (Reject) AccumulateRun<Format, false, true>(Raw, n, First, S);
+    else AccumulateRun<Format, false, false>(Raw, n, First, S);
+}
+
+void AccumulateSamples(const unsigned char* DataCap, long Len, long First, const EVM_AverageSums& Sums, int Format)
+{
+    switch (Format)
+    {
+    case EVM_DECODE_16BIT: AccumulateFormat<EVM_DECODE_16BIT>(DataCap, Len / 4, First, Sums); break;
+    case EVM_DECODE_20BIT: AccumulateFormat<EVM_DECODE_20BIT>(DataCap, Len / 4, First, Sums); break;
+    default: AccumulateFormat<EVM_DECODE_RAW24>(DataCap, Len / 4, First, Sums); break;
+    }
+}
+
+//===================================================================================================================
+// Benchmark
+
+// The loop the table replaces: format, layout and channel count looked at for every sample
+static void DecodeGeneric(const unsigned char* Raw, long n, long First, void* Out, long Rows, const EVM_Conversion& Conv)
+{
+    const int Mask = (Conv.Format == EVM_DECODE_16BIT) ? 0xFFFF : (Conv.Format == EVM_DECODE_20BIT) ? 0xFFFFF : 0xFFFFFF;
+    for (long i = 0; i < n; i++, Raw += 4)
+    {
+        long s = First + i;
+        long k = (Conv.Layout == EVM_LAYOUT_CHANNEL_MAJOR) ? (s % Conv.Channels) * Rows + s / Conv.Channels : s;
+        int c = Code(Raw) & Mask;
+        switch (Conv.SampleType)
+        {
+        case EVM_SAMPLE_INT32: ((int*)Out)[k] = c; break;
+        case EVM_SAMPLE_UINT16: ((unsigned short*)Out)[k] = (unsigned short)c; break;
+        case EVM_SAMPLE_FLOAT32: ((float*)Out)[k] = (float)((c - Conv.Offset) * Conv.Gain); break;
+        case EVM_SAMPLE_FLOAT64: ((double*)Out)[k] = (c - Conv.Offset) * Conv.Gain; break;
+        }
+    }
+}
+
+static double Seconds(const LARGE_INTEGER& From, const LARGE_INTEGER& To, const LARGE_INTEGER& Freq)
+{
+    return (double)(To.QuadPart - From.QuadPart) / (double)Freq.QuadPart;
+}
+
+// Decodes Iterations synthetic transfers of STRINGLEN bytes with the runtime generic loop and with the decoder
+// picked from the table for SampleType (layout included), CFGHIGH and Channels, and returns the throughput of
+// both in MB/s of raw data. Returns 0, -7 for an unsupported combination or -16 if the outputs differ.
+long __stdcall EVM_DecodeBenchmark(int SampleType, byte* CFGHIGH, int Channels, int Iterations,
+    double* GenericMBs, double* SpecializedMBs)
+{
+    EVM_Conversion Conv = EVM_MakeConversion(SampleType, *CFGHIGH, Channels);
+    if (Conv.Fn == nullptr || Channels <= 0 || Iterations <= 0) return(-7);
+
+    const long Words = STRINGLEN / 4;
+    const long Rows = (Words + Channels - 1) / Channels;
+    const size_t OutBytes = (size_t)Rows * Channels * EVM_SampleSize(SampleType);
+    std::unique_ptr<unsigned char[]> Raw(new unsigned char[STRINGLEN]);
+    std::unique_ptr<unsigned char[]> Generic(new unsigned char[OutBytes]());
+    std::unique_ptr<unsigned char[]> Specialized(new unsigned char[OutBytes]());
+
+    unsigned int Seed = 12345;
+    for (long i = 0; i < Words; i++)
+    {
+        Seed = Seed * 1103515245 + 12345;
+        unsigned int c = (Seed >> 8) & ((Conv.Format == EVM_DECODE_16BIT) ? 0xFFFF : 0xFFFFF);
+        Raw[4 * i] = (i & 1) ? 0 : 128;
+        Raw[4 * i + 1] = (unsigned char)(c >> 16);
+        Raw[4 * i + 2] = (unsigned char)(c >> 8);
+        Raw[4 * i + 3] = (unsigned char)c;
+    }
+
+    LARGE_INTEGER Freq, t0, t1, t2;
+    QueryPerformanceFrequency(&Freq);
+    QueryPerformanceCounter(&t0);
+    for (int i = 0; i < Iterations; i++) DecodeGeneric(Raw.get(), Words, 0, Generic.get(), Rows, Conv);
+    QueryPerformanceCounter(&t1);
+    for (int i = 0; i < Iterations; i++) DecodeSamples(Raw.get(), STRINGLEN, 0, Specialized.get(), Rows, Conv);
+    QueryPerformanceCounter(&t2);
+
+    double MB = (double)STRINGLEN * Iterations / 1e6;
+    if (GenericMBs != nullptr) *GenericMBs = MB / Seconds(t0, t1, Freq);
+    if (SpecializedMBs != nullptr) *SpecializedMBs = MB / Seconds(t1, t2, Freq);
+
+    // Float results may differ in the last bit between the two formulas
+    size_t n = (size_t)Words;
+    for (size_t i = 0; i < n; i++)
+    {
+        size_t k = (Conv.Layout == EVM_LAYOUT_CHANNEL_MAJOR) ? (i % Channels) * Rows + i / Channels : i;
+        double a = 0, b = 0;
+        switch (Conv.SampleType)
+        {
+        case EVM_SAMPLE_INT32: a = ((int*)Generic.get())[k]; b = ((int*)Specialized.get())[k]; break;
+        case EVM_SAMPLE_UINT16: a = ((unsigned short*)Generic.get())[k]; b = ((unsigned short*)Specialized.get())[k]; break;
+        case EVM_SAMPLE_FLOAT32: a = ((float*)Generic.get())[k]; b = ((float*)Specialized.get())[k]; break;
+        case EVM_SAMPLE_FLOAT64: a = ((double*)Generic.get())[k]; b = ((double*)Specialized.get())[k]; break;
+        }
+        if (fabs(a - b) > 1e-4 * (fabs(a) + 1.0)) return(-16);
+    }
+    return(0);
+}
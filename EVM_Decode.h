@@ -0,0 +1,98 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ *
+ * Decoding of the raw 4 bytes words read from the bulk in endpoint into samples.
+ * A decoder is instantiated for every (format, channel count, layout, sample type)
+ * combination and picked once per capture by EVM_MakeConversion.
+ */
+
+#ifndef EVM_DECODE_H
+#define EVM_DECODE_H
+
+#include <stddef.h>
+#include <vector>
+
+// Width of the code inside each word
+enum EVM_DecodeFormat
+{
+    EVM_DECODE_RAW24 = 0,   // Format not known, all 24 bits are kept
+    EVM_DECODE_16BIT = 1,
+    EVM_DECODE_20BIT = 2,
+};
+
+struct EVM_Conversion;
+
+// Channels kept by the decoder, in output order
+struct EVM_Roi
+{
+    std::vector<int> Index;     // Selected channels, 0 at the masked positions
+    std::vector<int> Position;  // Output position of each channel, -1 if not selected
+    std::vector<int> Masked;    // Output positions without a channel, written as 0 (NaN for the float types)
+};
+
+// Decodes n words of Raw holding samples First to First + n - 1 of a block of Rows DVALIDs into Out,
+// which points to the start of the block.
+typedef void (*EVM_DecodeFn)(const unsigned char* Raw, long n, long First, void* Out, long Rows, const EVM_Conversion& Conv);
+
+// Output sample type, layout and conversion, built once per capture from the DDC configuration
+struct EVM_Conversion
+{
+    int SampleType;   // EVM_SAMPLE_xxx
+    int Layout;       // EVM_LAYOUT_xxx
+    int Format;       // EVM_DECODE_xxx
+    int Channels;
+    double Gain;      // pC per code
+    double Offset;    // code for zero input
+    const EVM_Roi* Roi;  // Channels to keep, null for all
+    EVM_DecodeFn Fn;     // null if the combination is not valid
+};
+
+// Conversion for SampleType (optionally or'ed with a layout) with the range and format held in CFGHIGH
+EVM_Conversion EVM_MakeConversion(int SampleType, unsigned char CFGHIGH, int Channels);
+
+// Raw int32 codes, interleaved, format unknown: the output of EVM_DataCap
+EVM_Conversion EVM_RawConversion();
+
+// Builds the selection of nSelected distinct channels out of Channels. Returns false if the list is not valid.
+bool EVM_MakeRoi(EVM_Roi& Roi, int Channels, int nSelected, const int* ChannelList);
+
+// Same as EVM_MakeRoi for the pixels of an image: ChannelList holds the channel shown by each pixel in row
+// major order, -1 for the masked ones
+bool EVM_MakeImageRoi(EVM_Roi& Roi, int Channels, int nPixels, const int* ChannelList);
+
+// Makes Conv keep only the channels of Roi, which must outlive it. A row of the output then holds
+// Roi.Index.size() samples and the channel major layout takes any channel count.
+void EVM_ApplyRoi(EVM_Conversion& Conv, const EVM_Roi* Roi);
+
+// Size in bytes of one output sample, 0 for an unknown type. The layout bits are ignored.
+size_t EVM_SampleSize(int SampleType);
+
+// Decodes Len bytes of raw words holding samples First onwards of a block of Rows DVALIDs into Out
+void DecodeSamples(const unsigned char* DataCap, long Len, long First, void* Out, long Rows, const EVM_Conversion& Conv);
+
+// Stores n codes, possibly fractional, as the sample type of Conv. The layout is ignored.
+void StoreCodes(const double* Codes, long n, void* Out, const EVM_Conversion& Conv);
+
+// Per sample sums of a multi capture average, every array indexed by sample. The codes are summed as
+// deviations from Ref, the codes of the first capture, which keeps the sums exact and small.
+struct EVM_AverageSums
+{
+    const int* Ref;
+    long long* Sum;
+    long long* SumSq;   // Null when the squares are not needed
+    int* Count;         // Codes kept, only updated when Lo and Hi are given
+    const int* Lo;      // Deviations kept are Lo to Hi, null to keep all
+    const int* Hi;
+};
+
+// Adds the codes of Len bytes of raw words holding samples First onwards to Sums, at the speed of a decode
+void AccumulateSamples(const unsigned char* DataCap, long Len, long First, const EVM_AverageSums& Sums, int Format);
+
+#endif // EVM_DECODE_H
@@ -0,0 +1,228 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ */
+
+#include "StdAfx.h"
+#include "CyApi.h"
+#include "DDC264EVM_IO.h"
+#include "EVM_Internal.h"
+#include "EVM_Devices.h"
+
+#include <dbt.h>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <mutex>
+
+static std::mutex DevicesLock;
+static std::vector<EVM_DeviceEntry> Devices;
+static long Changes = 0;
+
+static std::once_flag WatchOnce;
+static HWND WatchWindow = NULL;
+static HANDLE WatchThread = NULL;
+static HMODULE WatchModule = NULL;   // Reference to this DLL held by the watcher thread
+
+// Events of one plug or unplug come in bursts, the list is read again once they settle
+static const UINT RESCAN_DELAY_MS = 250;
+static const UINT_PTR RESCAN_TIMER = 1;
+
+static std::string Narrow(const wchar_t* Text)
+{
+    char Buf[USB_STRING_MAXLEN * 4];
+    int Len = WideCharToMultiByte(CP_UTF8, 0, Text, -1, Buf, sizeof(Buf), NULL, NULL);
+    return (Len > 0) ? std::string(Buf) : std::string();
+}
+
+// Opens every board in turn, the only place that walks the bus
+static std::vector<EVM_DeviceEntry> Enumerate()
+{
+    CCyUSBDevice USBDevice(NULL, CYUSBDRV_GUID, false);
+    int Count = USBDevice.DeviceCount();
+
+    std::vector<EVM_DeviceEntry> List(Count);
+    for (int i = 0; i < Count; i++)
+    {
+        EVM_DeviceEntry& E = List[i];
+        memset(&E.Device, 0, sizeof(E.Device));
+        memset(&E.Interface, 0, sizeof(E.Interface));
+        E.Opened = USBDevice.Open(i);
+        if (E.Opened)
+        {
+            USBDevice.GetDeviceDescriptor(&E.Device);
+            USBDevice.GetIntfcDescriptor(&E.Interface);
+            E.Path = USBDevice.DevPath;
+            E.Serial = Narrow(USBDevice.SerialNumber);
+            USBDevice.Close();
+        }
+    }
+    return List;
+}
+
+int EVM_RescanDevices()
+{
+    std::vector<EVM_DeviceEntry> List = Enumerate();
+
+    std::lock_guard<std::mutex> L(DevicesLock);
+    Devices.swap(List);
+    Changes++;
+    return (int)Devices.size();
+}
+
+static LRESULT CALLBACK WatchProc(HWND Wnd, UINT Msg, WPARAM wParam, LPARAM lParam)
+{
+    switch (Msg)
+    {
+    case WM_DEVICECHANGE:
+        if (wParam == DBT_DEVICEARRIVAL || wParam == DBT_DEVICEREMOVECOMPLETE) SetTimer(Wnd, RESCAN_TIMER, RESCAN_DELAY_MS, NULL);
+        return TRUE;
+    case WM_TIMER:
+        KillTimer(Wnd, RESCAN_TIMER);
+        EVM_RescanDevices();
+        return 0;
+    case WM_CLOSE:
+        DestroyWindow(Wnd);
+        return 0;
+    case WM_DESTROY:
+        PostQuitMessage(0);
+        return 0;
+    }
+    return DefWindowProcA(Wnd, Msg, wParam, lParam);
+}
+
+// Message only window receiving the PnP notifications of the CyUSB driver
+static void WatchLoop(std::promise<HWND>* Started)
+{
+    WNDCLASSEXA Class;
+    memset(&Class, 0, sizeof(Class));
+    Class.cbSize = sizeof(Class);
+    Class.lpfnWndProc = WatchProc;
+    Class.hInstance = EVM_Module;
+    Class.lpszClassName = "DDC264EVM_IO_DeviceWatch";
+    RegisterClassExA(&Class);
+
+    HWND Wnd = CreateWindowExA(0, Class.lpszClassName, "", 0, 0, 0, 0, 0, HWND_MESSAGE, NULL, EVM_Module, NULL);
+
+    // Given a window, CyAPI registers it for the arrival and removal of the devices of its driver
+    std::unique_ptr<CCyUSBDevice> Notifier;
+    if (Wnd != NULL) Notifier.reset(new CCyUSBDevice(Wnd, CYUSBDRV_GUID, false));
+    Started->set_value(Wnd);
+    if (Wnd == NULL) return;
+
+    MSG Msg;
+    while (GetMessageA(&Msg, NULL, 0, 0) > 0) DispatchMessageA(&Msg);
+
+    Notifier.reset();
+    UnregisterClassA(Class.lpszClassName, EVM_Module);
+}
+
+// The thread runs code of this DLL until it leaves, so it keeps the DLL loaded meanwhile: a FreeLibrary
+// of the host can't unmap it under the thread, which drops its reference only as it exits.
+static DWORD WINAPI WatchThreadProc(LPVOID Param)
+{
+    WatchLoop((std::promise<HWND>*)Param);
+    FreeLibraryAndExitThread(WatchModule, 0);
+    return 0;
+}
+
+static void StartWatch()
+{
+    if (!GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, (LPCSTR)&WatchThreadProc, &WatchModule))
+    {
+        EVM_RescanDevices();
+        return;
+    }
+
+    // Registered before the first enumeration so no board is missed in between
+    std::promise<HWND> Started;
+    std::future<HWND> Window = Started.get_future();
+    WatchThread = CreateThread(NULL, 0, WatchThreadProc, &Started, 0, NULL);
+    if (WatchThread != NULL) WatchWindow = Window.get();
+    else FreeLibrary(WatchModule);
+
+    EVM_RescanDevices();
+}
+
+long EVM_GetDevices(std::vector<EVM_DeviceEntry>& List)
+{
+    std::call_once(WatchOnce, StartWatch);
+
+    // Without notifications the list can't be trusted, the boards are enumerated on every call as before
+    if (WatchWindow == NULL) EVM_RescanDevices();
+
+    std::lock_guard<std::mutex> L(DevicesLock);
+    List = Devices;
+    return Changes;
+}
+
+void EVM_StopDeviceWatch()
+{
+    std::call_once(WatchOnce, [] {});   // Not started after this
+    if (WatchThread == NULL) return;
+
+    // The list is enumerated on every call from now on
+    HWND Window = WatchWindow;
+    WatchWindow = NULL;
+    if (Window != NULL) PostMessageA(Window, WM_CLOSE, 0, 0);
+    WaitForSingleObject(WatchThread, INFINITE);
+    CloseHandle(WatchThread);
+    WatchThread = NULL;
+}
+
+//===================================================================================================================
+
+// Index (USBdev) of the board with serial number Serial, -1 if it is not attached
+int __stdcall EVM_FindDevice(char* Serial)
+{
+    if (Serial == nullptr) return(-1);
+
+    std::vector<EVM_DeviceEntry> List;
+    EVM_GetDevices(List);
+    for (size_t i = 0; i < List.size(); i++)
+    {
+        if (List[i].Opened && List[i].Serial == Serial) return (int)i;
+    }
+    return(-1);
+}
+
+// Copies the serial number of board USBdev into buf, returns its length or -1 if there is no such board
+int __stdcall EVM_DeviceSerial(int USBdev, char* buf, int bufsize)
+{
+    std::vector<EVM_DeviceEntry> List;
+    EVM_GetDevices(List);
+    if (USBdev < 0 || USBdev >= (int)List.size() || buf == nullptr || bufsize < 1) return(-1);
+
+    int textSize = min(bufsize - 1, (int)List[USBdev].Serial.size());
+    memcpy(buf, List[USBdev].Serial.c_str(), textSize);
+    buf[textSize] = 0;
+    return textSize;
+}
+
+// Grows by one every time the device list changes: a caller holding USBdev numbers looks them up again
+long __stdcall EVM_DeviceChanges()
+{
+    std::vector<EVM_DeviceEntry> List;
+    return EVM_GetDevices(List);
+}
+
+// Enumerates the boards now rather than waiting for a notification, returns how many there are
+int __stdcall EVM_RefreshDevices()
+{
+    std::call_once(WatchOnce, StartWatch);
+    return EVM_RescanDevices();
+}
+
+// Stops the hotplug watcher thread and waits for it, to call before FreeLibrary of the DLL. The thread keeps
+// the DLL loaded while it runs, so without this call a FreeLibrary leaves it loaded until the process exits.
+// The device functions keep working afterwards, enumerating the boards on every call.
+void __stdcall EVM_Shutdown()
+{
+    EVM_StopDeviceWatch();
+}
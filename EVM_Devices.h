@@ -0,0 +1,42 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ *
+ * Cache of the attached boards. The devices are opened once to read their descriptors
+ * and serial number; the list is then only refreshed when the CyUSB driver reports a
+ * board arriving or leaving, so lookups never touch the bus.
+ */
+
+#ifndef EVM_DEVICES_H
+#define EVM_DEVICES_H
+
+#include <string>
+#include <vector>
+
+// What is known of one board, USBdev being its position in the list. CyApi.h must come first.
+struct EVM_DeviceEntry
+{
+    std::string Path;    // Driver device path
+    std::string Serial;  // Serial number string, may be empty
+    USB_DEVICE_DESCRIPTOR Device;
+    USB_INTERFACE_DESCRIPTOR Interface;
+    bool Opened;         // False if the board could not be opened, its descriptors are then zero
+};
+
+// Copies the device list, enumerating the boards on the first call. Returns the change count, see
+// EVM_DeviceChanges.
+long EVM_GetDevices(std::vector<EVM_DeviceEntry>& List);
+
+// Enumerates the boards again and returns how many there are
+int EVM_RescanDevices();
+
+// Stops watching for hotplug events and waits for the watcher thread to leave. Not under the loader lock.
+void EVM_StopDeviceWatch();
+
+#endif // EVM_DEVICES_H
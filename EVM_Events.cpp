@@ -0,0 +1,264 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ */
+
+#include "StdAfx.h"
+#include "DDC264EVM_IO.h"
+#include "EVM_Events.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdlib.h>
+
+#if defined(_M_IX86) || defined(_M_X64)
+  #include <emmintrin.h>
+  #define EVM_EVENTS_SSE2
+#endif
+
+static const int MAX_WINDOW_SIDE = 4096;
+static const int MAX_BASELINE_SHIFT = 20;
+
+// True if a channel of the row crosses its level: an idle one its threshold, a busy one its re-arm level
+static bool Crossed(const int* Codes, const double* Base, const double* Slope, const double* Level, int n)
+{
+    int c = 0;
+#ifdef EVM_EVENTS_SSE2
+    __m128d Any = _mm_setzero_pd();
+    for (; c + 2 <= n; c += 2)
+    {
+        __m128d x = _mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i*)(Codes + c)));
+        __m128d d = _mm_mul_pd(_mm_sub_pd(x, _mm_loadu_pd(Base + c)), _mm_loadu_pd(Slope + c));
+        Any = _mm_or_pd(Any, _mm_cmpge_pd(d, _mm_loadu_pd(Level + c)));
+    }
+    if (_mm_movemask_pd(Any) != 0) return true;
+#endif
+    bool Hit = false;
+    for (; c < n; c++) Hit |= ((Codes[c] - Base[c]) * Slope[c] >= Level[c]);
+    return Hit;
+}
+
+// Moves the baselines of the idle channels towards the row
+static void Track(const int* Codes, double* Base, const double* Gain, int n)
+{
+    int c = 0;
+#ifdef EVM_EVENTS_SSE2
+    for (; c + 2 <= n; c += 2)
+    {
+        __m128d x = _mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i*)(Codes + c)));
+        __m128d b = _mm_loadu_pd(Base + c);
+        _mm_storeu_pd(Base + c, _mm_add_pd(b, _mm_mul_pd(_mm_sub_pd(x, b), _mm_loadu_pd(Gain + c))));
+    }
+#endif
+    for (; c < n; c++) Base[c] += (Codes[c] - Base[c]) * Gain[c];
+}
+
+EVM_EventDetector::EVM_EventDetector() : Hysteresis(0), Pre(0), Post(0), BaselineShift(0), Channels(0)
+{
+    for (int s = 0; s < 2; s++)
+    {
+        Primed[s] = false;
+        HistPos[s] = 0;
+        HistFill[s] = 0;
+    }
+}
+
+bool EVM_EventDetector::Setup(int nThresholds, const int* Thresholds, int Hysteresis, int PreSamples, int PostSamples, int BaselineShift)
+{
+    if (nThresholds == 0)
+    {
+        this->Thresholds.clear();
+        return true;
+    }
+    if (nThresholds < 0 || Thresholds == nullptr || Hysteresis < 0) return false;
+    if (PreSamples < 0 || PreSamples > MAX_WINDOW_SIDE || PostSamples < 0 || PostSamples > MAX_WINDOW_SIDE) return false;
+    if (BaselineShift < 0 || BaselineShift > MAX_BASELINE_SHIFT) return false;
+    for (int i = 0; i < nThresholds; i++)
+    {
+        // The re-arm level must stay on the baseline side of the threshold
+        if (Thresholds[i] == 0 || Hysteresis >= abs(Thresholds[i])) return false;
+    }
+
+    this->Thresholds.assign(Thresholds, Thresholds + nThresholds);
+    this->Hysteresis = Hysteresis;
+    Pre = PreSamples;
+    Post = PostSamples;
+    this->BaselineShift = BaselineShift;
+    return true;
+}
+
+long EVM_EventDetector::RecordBytes() const
+{
+    return (long)((sizeof(EVM_Event) + Window() * sizeof(int) + 7) & ~(size_t)7);
+}
+
+bool EVM_EventDetector::Start(int Channels)
+{
+    int n = (int)Thresholds.size();
+    if (n != 1 && n != Channels) return false;
+
+    this->Channels = Channels;
+    Sign.resize(Channels);
+    Threshold.resize(Channels);
+    Rearm.resize(Channels);
+    for (int c = 0; c < Channels; c++)
+    {
+        int t = Thresholds[(n == 1) ? 0 : c];
+        Sign[c] = (t > 0) ? 1.0 : -1.0;
+        Threshold[c] = abs(t);
+        Rearm[c] = abs(t) - Hysteresis;
+    }
+
+    const double Alpha = 1.0 / (1 << BaselineShift);
+    for (int s = 0; s < 2; s++)
+    {
+        Primed[s] = false;
+        Base[s].assign(Channels, 0.0);
+        Gain[s].assign(Channels, Alpha);
+        Slope[s] = Sign;
+        Level[s] = Threshold;
+        Busy[s].assign(Channels, 0);
+        History[s].resize((size_t)Pre * Channels);
+        HistPos[s] = 0;
+        HistFill[s] = 0;
+    }
+    Open.clear();
+    Out.clear();
+    return true;
+}
+
+void EVM_EventDetector::Feed(const int* Codes, long Rows, long long Row, int Frame, int AorB)
+{
+    for (long r = 0; r < Rows; r++) AddRow(Codes + (size_t)r * Channels, Row + r, Frame, (AorB + r) & 1);
+}
+
+void EVM_EventDetector::AddRow(const int* Codes, long long Row, int Frame, int Side)
+{
+    // Post samples of the open events of this side; they complete in the order they opened
+    for (size_t i = 0; i < Open.size(); i++)
+    {
+        Pending& P = Open[i];
+        if (P.Side != Side) continue;
+        EVM_Event* E = (EVM_Event*)(Out.data() + P.Offset);
+        ((int*)(E + 1))[E->Samples++] = Codes[P.Channel];
+        P.Left--;
+    }
+    while (!Open.empty() && Open.front().Left == 0) Open.pop_front();
+
+    double* B = Base[Side].data();
+    if (!Primed[Side])
+    {
+        for (int c = 0; c < Channels; c++) B[c] = Codes[c];
+        Primed[Side] = true;
+    }
+
+    if (Crossed(Codes, B, Slope[Side].data(), Level[Side].data(), Channels))
+    {
+        for (int c = 0; c < Channels; c++)
+        {
+            double d = (Codes[c] - B[c]) * Slope[Side][c];
+            if (d < Level[Side][c]) continue;
+
+            if (Busy[Side][c])
+            {
+                Busy[Side][c] = 0;
+                Slope[Side][c] = Sign[c];
+                Level[Side][c] = Threshold[c];
+                Gain[Side][c] = 1.0 / (1 << BaselineShift);
+            }
+            else
+            {
+                Trigger(c, Side, Codes, Row, Frame);
+                Busy[Side][c] = 1;
+                Slope[Side][c] = -Sign[c];
+                Level[Side][c] = -Rearm[c];
+                Gain[Side][c] = 0;
+            }
+        }
+    }
+    Track(Codes, B, Gain[Side].data(), Channels);
+
+    if (Pre > 0)
+    {
+        memcpy(History[Side].data() + (size_t)HistPos[Side] * Channels, Codes, Channels * sizeof(int));
+        HistPos[Side] = (HistPos[Side] + 1) % Pre;
+        HistFill[Side] = min(HistFill[Side] + 1, Pre);
+    }
+}
+
+// Opens the record of an event with the rows held before it
+void EVM_EventDetector::Trigger(int Channel, int Side, const int* Codes, long long Row, int Frame)
+{
+    size_t Offset = Out.size();
+    Out.resize(Offset + RecordBytes());
+    EVM_Event* E = (EVM_Event*)(Out.data() + Offset);
+    int* Window = (int*)(E + 1);
+
+    E->SampleIndex = Row;
+    E->Frame = Frame;
+    E->Channel = Channel;
+    E->AorB = Side;
+    E->Trigger = HistFill[Side];
+    E->Baseline = (float)Base[Side][Channel];
+    E->Samples = 0;
+    for (int i = HistFill[Side]; i > 0; i--)
+    {
+        int h = (HistPos[Side] - i + Pre) % Pre;
+        Window[E->Samples++] = History[Side][(size_t)h * Channels + Channel];
+    }
+    Window[E->Samples++] = Codes[Channel];
+
+    // The samples after it are counted in as they come, the unused tail of the window stays zero
+    Pending P = { Offset, Channel, Side, Post };
+    if (Post > 0) Open.push_back(P);
+}
+
+void EVM_EventDetector::EndFrame()
+{
+    Open.clear();
+    HistFill[0] = HistFill[1] = 0;
+}
+
+long EVM_EventDetector::Ready() const
+{
+    size_t Bytes = Open.empty() ? Out.size() : Open.front().Offset;
+    return (long)(Bytes / RecordBytes());
+}
+
+void EVM_EventDetector::Drop(long n)
+{
+    size_t Bytes = (size_t)n * RecordBytes();
+    Out.erase(Out.begin(), Out.begin() + Bytes);
+    for (Pending& P : Open) P.Offset -= Bytes;
+}
+
+//===================================================================================================================
+
+// Finds the events of a capture as returned by EVM_DataCap: nDVALIDReads rows of Channels codes, sides A and B
+// alternating from AorBfirst, with the detector settings of EVM_StreamSetEvents. Writes as many records as fit
+// in EventsBytes bytes of Events and returns the events found, -7 if the settings are invalid.
+long __stdcall EVM_DetectEvents(int* DataArray, int Channels, int nDVALIDReads, int AorBfirst, int nThresholds, int* Thresholds,
+                                int Hysteresis, int PreSamples, int PostSamples, int BaselineShift, void* Events, long EventsBytes)
+{
+    if (DataArray == nullptr || Channels <= 0 || nDVALIDReads <= 0 || nThresholds <= 0 || EventsBytes < 0) return(-7);
+    if (Events == nullptr && EventsBytes > 0) return(-7);
+
+    thread_local EVM_EventDetector Detector;
+    if (!Detector.Setup(nThresholds, Thresholds, Hysteresis, PreSamples, PostSamples, BaselineShift)) return(-7);
+    if (!Detector.Start(Channels)) return(-7);
+
+    Detector.Feed(DataArray, nDVALIDReads, 0, 0, AorBfirst & 1);
+    Detector.EndFrame();
+
+    long Found = Detector.Ready();
+    long Fit = min(Found, EventsBytes / Detector.RecordBytes());
+    if (Fit > 0) memcpy(Events, Detector.Records(), (size_t)Fit * Detector.RecordBytes());
+    Detector.Drop(Found);
+    return(Found);
+}
@@ -0,0 +1,89 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ *
+ * Event detection stage: every channel of each side runs against a threshold over its
+ * tracked baseline, with hysteresis, and only a window of codes around each trigger is
+ * kept. A row is scanned for crossings in one vector pass; the per channel bookkeeping
+ * only runs for the rare rows that have one.
+ */
+
+#ifndef EVM_EVENTS_H
+#define EVM_EVENTS_H
+
+#include <deque>
+#include <vector>
+
+class EVM_EventDetector
+{
+public:
+    EVM_EventDetector();
+
+    // nThresholds 0 (off), 1 (every channel) or one per channel, in codes over the baseline, negative for
+    // pulses going down. A channel re-arms once back within Hysteresis of the baseline side of its threshold.
+    // The baseline follows idle channels with a time constant of 2^BaselineShift samples. Returns false if invalid.
+    bool Setup(int nThresholds, const int* Thresholds, int Hysteresis, int PreSamples, int PostSamples, int BaselineShift);
+    bool Active() const { return !Thresholds.empty(); }
+
+    // Sizes the state for Channels codes per row and clears it. Returns false if the thresholds don't match.
+    bool Start(int Channels);
+
+    int Window() const { return Pre + 1 + Post; }
+    long RecordBytes() const;
+
+    // Adds Rows rows of Channels codes, rows Row onwards of frame Frame, sides alternating from AorB
+    void Feed(const int* Codes, long Rows, long long Row, int Frame, int AorB);
+
+    // Closes the events still waiting for samples with what they have and forgets the rows held
+    void EndFrame();
+
+    // Completed records, in trigger order, and dropping the first n of them
+    long Ready() const;
+    const unsigned char* Records() const { return Out.data(); }
+    void Drop(long n);
+
+private:
+    struct Pending
+    {
+        size_t Offset;  // Of the record in Out
+        int Channel;
+        int Side;
+        int Left;       // Samples still to come
+    };
+
+    void AddRow(const int* Codes, long long Row, int Frame, int Side);
+    void Trigger(int Channel, int Side, const int* Codes, long long Row, int Frame);
+
+    std::vector<int> Thresholds;
+    int Hysteresis;
+    int Pre;
+    int Post;
+    int BaselineShift;
+
+    int Channels;
+    std::vector<double> Sign;       // +1 or -1, the direction of the pulses
+    std::vector<double> Threshold;  // Magnitude
+    std::vector<double> Rearm;
+
+    // Per side
+    bool Primed[2];
+    std::vector<double> Base[2];
+    std::vector<double> Gain[2];    // Of the baseline, 0 while the channel is in an event
+    std::vector<double> Slope[2];   // Sign, negated while in an event, so a crossing is always Slope * d >= Level
+    std::vector<double> Level[2];
+    std::vector<char> Busy[2];
+    std::vector<int> History[2];    // Last Pre rows, a ring
+    int HistPos[2];
+    int HistFill[2];
+
+    std::deque<Pending> Open;       // Events waiting for their post samples
+    std::vector<unsigned char> Out;
+};
+
+#endif // EVM_EVENTS_H
@@ -0,0 +1,138 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ */
+
+#include "StdAfx.h"
+#include "DDC264EVM_IO.h"
+#include "EVM_Filter.h"
+
+#include <algorithm>
+#include <math.h>
+
+// Codes are at most 24 bits and a CIC grows Order * log2(Factor) bits, keep it inside 63
+static const int MAX_CIC_GROWTH = 38;
+
+EVM_Decimator::EVM_Decimator() : Mode(EVM_FILTER_NONE), Order(1)
+{
+}
+
+bool EVM_Decimator::Setup(int Mode, int Order, int nGroups, const int* GroupChannels, const int* Factors)
+{
+    if (Mode == EVM_FILTER_NONE)
+    {
+        this->Mode = Mode;
+        Group.clear();
+        return true;
+    }
+    if (Mode != EVM_FILTER_BOXCAR && Mode != EVM_FILTER_CIC) return false;
+    if (Mode == EVM_FILTER_BOXCAR) Order = 1;
+    if (Order < 1 || nGroups < 1 || GroupChannels == nullptr || Factors == nullptr) return false;
+
+    std::vector<GroupState> NewGroup(nGroups);
+    int First = 0;
+    for (int g = 0; g < nGroups; g++)
+    {
+        if (GroupChannels[g] <= 0 || Factors[g] <= 0) return false;
+        if (Order * log2((double)Factors[g]) > MAX_CIC_GROWTH) return false;
+
+        GroupState& G = NewGroup[g];
+        G.First = First;
+        G.Channels = GroupChannels[g];
+        G.Factor = Factors[g];
+        G.Scale = 1.0 / pow((double)Factors[g], Order);
+        for (SideState& Side : G.Side)
+        {
+            Side.Integrator.resize((size_t)Order * G.Channels);
+            Side.Comb.resize((size_t)Order * G.Channels);
+        }
+        G.Work.resize(G.Channels);
+        First += G.Channels;
+    }
+    this->Mode = Mode;
+    this->Order = Order;
+    Group.swap(NewGroup);
+    Reset();
+    return true;
+}
+
+void EVM_Decimator::Reset()
+{
+    for (GroupState& G : Group)
+    {
+        for (SideState& Side : G.Side)
+        {
+            Side.Phase = 0;
+            Side.Emitted = 0;
+            std::fill(Side.Integrator.begin(), Side.Integrator.end(), 0);
+            std::fill(Side.Comb.begin(), Side.Comb.end(), 0);
+        }
+    }
+}
+
+int EVM_Decimator::UsedChannels() const
+{
+    return Group.empty() ? 0 : Group.back().First + Group.back().Channels;
+}
+
+// The inner loops run along the channels of the group, contiguous in both the codes and the state,
+// so they vectorize. Boxcar is the single stage case: accumulate Factor rows, then dump.
+long EVM_Decimator::Process(int g, int Side, const int* Codes, long Rows, int Stride, double* Out)
+{
+    GroupState& G = Group[g];
+    SideState& S = G.Side[Side];
+    const int n = G.Channels;
+    unsigned long long* Acc = S.Integrator.data();
+    unsigned long long* Comb = S.Comb.data();
+    long OutRows = 0;
+
+    Codes += G.First;
+    for (long r = 0; r < Rows; r++, Codes += Stride)
+    {
+        // Integrators at the input rate, wrapping arithmetic is fine for a CIC
+        for (int c = 0; c < n; c++) Acc[c] += (unsigned long long)(long long)Codes[c];
+        for (int k = 1; k < Order; k++)
+        {
+            unsigned long long* I = Acc + (size_t)k * n;
+            const unsigned long long* Prev = I - n;
+            for (int c = 0; c < n; c++) I[c] += Prev[c];
+        }
+        if (++S.Phase < G.Factor) continue;
+        S.Phase = 0;
+
+        double* y = Out + (size_t)OutRows * n;
+        const unsigned long long* Last = Acc + (size_t)(Order - 1) * n;
+        if (Mode == EVM_FILTER_BOXCAR)
+        {
+            for (int c = 0; c < n; c++) y[c] = (long long)Acc[c] * G.Scale;
+            std::fill(Acc, Acc + n, 0);
+        }
+        else
+        {
+            // Combs at the output rate, differential delay of one output sample. The output fits
+            // MAX_CIC_GROWTH bits, so the wrapped difference read as signed is exact.
+            unsigned long long* v = G.Work.data();
+            std::copy(Last, Last + n, v);
+            for (int k = 0; k < Order; k++)
+            {
+                unsigned long long* C = Comb + (size_t)k * n;
+                for (int c = 0; c < n; c++)
+                {
+                    unsigned long long d = v[c] - C[c];
+                    C[c] = v[c];
+                    v[c] = d;
+                }
+            }
+            for (int c = 0; c < n; c++) y[c] = (long long)v[c] * G.Scale;
+        }
+        OutRows++;
+    }
+    S.Emitted += OutRows;
+    return OutRows;
+}
@@ -0,0 +1,69 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ *
+ * Decimation stage of the stream: boxcar averaging or CIC decimation of consecutive
+ * groups of channels, each with its own factor. Sides A and B have their own filter
+ * state, as their offsets differ, and each side outputs rows of its own. The state
+ * lives here and is carried from one transfer to the next.
+ */
+
+#ifndef EVM_FILTER_H
+#define EVM_FILTER_H
+
+#include <vector>
+
+class EVM_Decimator
+{
+public:
+    EVM_Decimator();
+
+    // Mode is EVM_FILTER_xxx, Order the number of CIC stages. Group g takes the next GroupChannels[g]
+    // channels of a row and outputs one row every Factors[g] input rows. Returns false if invalid.
+    bool Setup(int Mode, int Order, int nGroups, const int* GroupChannels, const int* Factors);
+    bool Active() const { return Mode != EVM_FILTER_NONE; }
+
+    // Clears the filter state for a new stream
+    void Reset();
+
+    int Groups() const { return (int)Group.size(); }
+    int GroupChannels(int g) const { return Group[g].Channels; }
+    int UsedChannels() const;
+    long long Emitted(int g, int Side) const { return Group[g].Side[Side].Emitted; }
+
+    // Filters Rows rows of side Side (0 = A, 1 = B), Stride codes apart, for group g and writes the mean
+    // code of every completed output row to Out, which must hold Rows / Factor + 1 rows. Returns the rows written.
+    long Process(int g, int Side, const int* Codes, long Rows, int Stride, double* Out);
+
+private:
+    // Unsigned: the CIC integrators overflow by design and only wrap around defined in unsigned arithmetic
+    struct SideState
+    {
+        int Phase;
+        long long Emitted;
+        std::vector<unsigned long long> Integrator;  // Order * Channels, stage major
+        std::vector<unsigned long long> Comb;        // Order * Channels, stage major
+    };
+
+    struct GroupState
+    {
+        int First;
+        int Channels;
+        int Factor;
+        double Scale;                              // 1 / gain of the filter
+        SideState Side[2];
+        std::vector<unsigned long long> Work;      // One row going through the combs
+    };
+
+    int Mode;
+    int Order;
+    std::vector<GroupState> Group;
+};
+
+#endif // EVM_FILTER_H
@@ -0,0 +1,51 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ *
+ * Helpers shared by the translation units of the library, not exported from the DLL.
+ */
+
+#ifndef EVM_INTERNAL_H
+#define EVM_INTERNAL_H
+
+#define STRINGLEN 65536 //the larger this number is, the faster the data is shifted in.
+#define MAX_CHANNELS_FAST 4096 // 2048 = 1024A + 1024B
+
+#ifdef DEBUG
+  #include<iostream>
+  #define DEBUGECHO(TXT) std::cout << TXT << "\n"
+#else
+  #define DEBUGECHO(TXT) {}
+#endif
+
+class CCyUSBDevice;
+
+// Module handle of the DLL, set by DllMain
+extern HINSTANCE EVM_Module;
+
+// Opens board USBdev, or attaches the simulated board when USBdev is EVM_SIMULATED_DEVICE
+bool EVM_OpenDevice(CCyUSBDevice* USBDevice, int USBdev);
+
+// Sends a command packet through the bulk out endpoint
+bool SendPacket(CCyUSBDevice* USBDevice, unsigned char* Bytes, long Length, ULONG TimeOut);
+
+// Empties the bulk in pipe. Returns false if it never timed out, probably more data in the pipe.
+bool DrainBulkIn(CCyUSBDevice* USBDevice, unsigned char* Buffer, long BufLen, ULONG TimeOut, int AllowedWaitCount);
+
+// Reads one transfer, retrying on timeout up to AllowedWaitCount times. Len is the buffer size in, bytes read out.
+bool ReadTransfer(CCyUSBDevice* USBDevice, unsigned char* Buffer, long& Len, ULONG TimeOut, int AllowedWaitCount);
+
+// Stops the conversions, drains what the FIFO still holds and starts the next capture. Buffer takes the drained
+// words and must hold STRINGLEN. Returns 0 or -5.
+long BurstRearm(CCyUSBDevice* USBDevice, unsigned char* Buffer);
+
+// Each sample arrives as 4 bytes: the A/B flag followed by the 24 bits value, MSB first
+void DecodeSamples(const unsigned char* DataCap, long Len, int* DataArray);
+
+#endif // EVM_INTERNAL_H
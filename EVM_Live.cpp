@@ -0,0 +1,313 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ */
+
+#include "StdAfx.h"
+#include "CyApi.h"
+#include "DDC264EVM_IO.h"
+#include "EVM_Registers.h"
+#include "EVM_Internal.h"
+#include "EVM_Decode.h"
+#include "EVM_Timing.h"
+#include "EVM_Board.h"
+#include "EVM_Trace.h"
+#include "EVM_Live.h"
+
+#include <cstring>
+
+// Seconds without a transfer before the readout gives up, as the other reads
+static const int READ_TIMEOUT_MS = 10000;
+
+static long Gcd(long a, long b)
+{
+    while (b != 0)
+    {
+        long r = a % b;
+        a = b;
+        b = r;
+    }
+    return(a);
+}
+
+EVM_Live::EVM_Live(int USBdev) : USBdev(USBdev), Board(&EVM_GetBoard(USBdev)), Channels(0), FrameBytes(0), TransferBytes(0), nQueued(0), CarryBytes(0), Newest(0), Returned(0),
+    Running(false), Error(0), StopRequest(false)
+{
+    memset(&NewestInfo, 0, sizeof(NewestInfo));
+}
+
+EVM_Live::~EVM_Live()
+{
+    Stop();
+    if (USBDevice) USBDevice->Close();
+}
+
+bool EVM_Live::Open()
+{
+    USBDevice.reset(new CCyUSBDevice(NULL));
+    if (!EVM_OpenDevice(USBDevice.get(), USBdev)) return false;
+    return (USBDevice->BulkInEndPt != nullptr && USBDevice->BulkOutEndPt != nullptr);
+}
+
+long EVM_Live::Start(int Channels, int SampleType, byte CFGHIGH, int nQueued, int FramesPerTransfer)
+{
+    if (Channels <= 0 || nQueued < 0 || nQueued > 64 || FramesPerTransfer < 0) return(-7);
+    if (EVM_SampleSize(SampleType) == 0) return(-7);
+    if ((SampleType & EVM_SAMPLE_TYPE_MASK) == EVM_SAMPLE_UINT16 && EVM_CFG_FORMAT::Get(CFGHIGH) != 0) return(-7);
+
+    std::lock_guard<std::mutex> L(Lock);
+    if (Running) return(-14);
+    if (Reader.joinable()) Reader.join();
+
+    Conv = (SampleType == EVM_SAMPLE_INT32) ? EVM_RawConversion() : EVM_MakeConversion(SampleType, CFGHIGH, Channels);
+    Conv.Channels = Channels;
+    if (Conv.Fn == nullptr) return(-7);
+
+    // A bulk in request takes whole packets: the transfers hold whole frames in whole packets
+    FrameBytes = Channels * 8;
+    long Packet = max((long)USBDevice->BulkInEndPt->MaxPktSize, 1L);
+    long Unit = FrameBytes / Gcd(FrameBytes, Packet) * Packet;
+    TransferBytes = (FrameBytes * max(FramesPerTransfer, 1) + Unit - 1) / Unit * Unit;
+    if (TransferBytes > STRINGLEN) return(-7);
+
+    if (Board->BeginStream() != 0) return(-14);
+    this->Channels = Channels;
+    this->nQueued = (nQueued > 0) ? nQueued : 4;
+    Raw.resize(max((size_t)this->nQueued * TransferBytes, (size_t)STRINGLEN));
+    Carry.resize(FrameBytes);
+    CarryBytes = 0;
+    NewestFrame.assign(2 * Channels * EVM_SampleSize(Conv.SampleType), 0);
+    Newest = Returned = 0;
+    Error = 0;
+    Latency.Reset();
+    StopRequest = false;
+    Running = true;
+    Reader = std::thread(&EVM_Live::ReaderLoop, this);
+    return(0);
+}
+
+long EVM_Live::Stop()
+{
+    StopRequest = true;
+    {
+        // The reads posted only return with data, abort them until the reader is out
+        std::unique_lock<std::mutex> L(Lock);
+        while (Running)
+        {
+            USBDevice->BulkInEndPt->Abort();
+            Arrived.wait_for(L, std::chrono::milliseconds(20));
+        }
+    }
+    if (Reader.joinable()) Reader.join();
+    return(Error);
+}
+
+long EVM_Live::Latest(int TimeoutMs, void* Frame, EVM_BlockInfo* Info)
+{
+    std::unique_lock<std::mutex> L(Lock);
+    auto Fresh = [this] { return Newest > Returned || !Running; };
+
+    if (TimeoutMs < 0) Arrived.wait(L, Fresh);
+    else if (!Arrived.wait_for(L, std::chrono::milliseconds(TimeoutMs), Fresh)) return(-4);
+
+    if (Newest <= Returned) return (Error != 0) ? Error : -13;
+
+    if (Frame != nullptr) memcpy(Frame, NewestFrame.data(), NewestFrame.size());
+    if (Info != nullptr) *Info = NewestInfo;
+    long Skipped = (long)(Newest - Returned - 1);
+    Returned = Newest;
+    Latency.Handover(EVM_Now() - NewestInfo.Timestamp);
+    return(Skipped);
+}
+
+void EVM_Live::ReaderLoop()
+{
+    // Completions are serviced as soon as they come, a late wake up is latency
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+    EVM_TRACE_THREAD("live reader");
+
+    auto StopNopCmd = EVM_Concat(EVM_SEQ_STOP_CONVERSIONS, EVM_SEQ_NOP);
+    auto StopCmd = EVM_SEQ_STOP_CONVERSIONS;
+    long Result;
+
+    if (SendPacket(USBDevice.get(), StopNopCmd.Bytes, StopNopCmd.Length(), 250))
+    {
+        DrainBulkIn(USBDevice.get(), Raw.data(), STRINGLEN, 250, 32);
+        Result = ReadLoop();
+        if (!SendPacket(USBDevice.get(), StopCmd.Bytes, StopCmd.Length(), 250) && Result == 0) Result = -6;
+    }
+    else Result = -5;
+    Board->EndStream(USBDevice.get());
+
+    std::lock_guard<std::mutex> L(Lock);
+    Error = Result;
+    Running = false;
+    Arrived.notify_all();
+}
+
+// Runs the conversions and keeps nQueued reads posted until stopped. Returns 0, -4 if no transfer completes
+// within READ_TIMEOUT_MS, -5 if one fails.
+long EVM_Live::ReadLoop()
+{
+    auto StartCmd = EVM_SEQ_START_CONVERSIONS;
+    CCyBulkEndPoint* In = USBDevice->BulkInEndPt;
+    std::vector<OVERLAPPED> Ov(nQueued);
+    std::vector<PUCHAR> Context(nQueued, nullptr);
+    long Result = 0;
+    long long Received = 0;
+
+    DEBUGECHO("Starts the conversions");
+
+    if (!SendPacket(USBDevice.get(), StartCmd.Bytes, StartCmd.Length(), 250)) return(-5);
+    Timing.Reset(Channels);
+    In->TimeOut = READ_TIMEOUT_MS;
+    for (int i = 0; i < nQueued; i++)
+    {
+        memset(&Ov[i], 0, sizeof(OVERLAPPED));
+        Ov[i].hEvent = CreateEventA(NULL, FALSE, FALSE, NULL);
+        Context[i] = In->BeginDataXfer(Raw.data() + i * TransferBytes, TransferBytes, &Ov[i]);
+    }
+
+    // The reads complete in the order they were posted
+    for (int i = 0; !StopRequest; i = (i + 1) % nQueued)
+    {
+        unsigned char* Data = Raw.data() + i * TransferBytes;
+        int Waited = 0;
+        bool Done;
+        while (!(Done = In->WaitForXfer(&Ov[i], 50)) && !StopRequest && (Waited += 50) < READ_TIMEOUT_MS) {}
+        if (!Done)
+        {
+            Result = StopRequest ? 0 : -4;
+            break;
+        }
+
+        LONG Len = TransferBytes;
+        bool Ok = In->FinishDataXfer(Data, Len, &Ov[i], Context[i]);
+        double Stamp = EVM_Now();
+        EVM_TRACE_SCOPE_ARG("frame", Len);
+        Context[i] = nullptr;
+        if (!Ok)
+        {
+            Result = StopRequest ? 0 : -5;
+            break;
+        }
+
+        // A short read leaves a frame cut, its start goes in front of the next read so the frames stay aligned
+        long Frames = (CarryBytes + Len) / FrameBytes;
+        if (Frames == 0)
+        {
+            memcpy(Carry.data() + CarryBytes, Data, Len);
+            CarryBytes += Len;
+        }
+        else
+        {
+            const unsigned char* First = (CarryBytes > 0) ? Carry.data() : Data;
+            const unsigned char* Last = Data + (Frames - 1) * FrameBytes - CarryBytes;
+            if (Frames == 1 && CarryBytes > 0)
+            {
+                memcpy(Carry.data() + CarryBytes, Data, FrameBytes - CarryBytes);
+                Last = Carry.data();
+            }
+            if (Received == 0) Timing.NewFrame((First[0] == 128) ? 0 : 1);
+            Timing.Add((Received + Frames) * 2 * Channels, Stamp);
+            Latency.Add(Received + Frames - 1, Frames, Stamp);
+            Received += Frames;
+
+            // Only the newest frame is decoded, the older ones of the transfer are already stale
+            {
+                std::lock_guard<std::mutex> L(Lock);
+                DecodeSamples(Last, FrameBytes, 0, NewestFrame.data(), 2, Conv);
+                NewestInfo.Sequence = Received - 1;
+                NewestInfo.SampleIndex = (Received - 1) * 2 * Channels;
+                NewestInfo.Frame = 0;
+                NewestInfo.Samples = 2 * Channels;
+                NewestInfo.AorB = (Last[0] == 128) ? 0 : 1;
+                NewestInfo.Status = 0;
+                NewestInfo.Group = 0;
+                NewestInfo.Timestamp = Stamp;
+                NewestInfo.Time = Timing.Time(2 * (Received - 1));
+                Newest = Received;
+                Arrived.notify_all();
+            }
+
+            CarryBytes = (CarryBytes + Len) - Frames * FrameBytes;
+            memcpy(Carry.data(), Data + Len - CarryBytes, CarryBytes);
+        }
+        Context[i] = In->BeginDataXfer(Data, TransferBytes, &Ov[i]);
+        Board->ApplyControl(USBDevice.get());
+    }
+
+    // The buffers of the reads still posted are released only once they are given back
+    In->Abort();
+    for (int i = 0; i < nQueued; i++)
+    {
+        if (Context[i] != nullptr)
+        {
+            In->WaitForXfer(&Ov[i], 250);
+            LONG Len = TransferBytes;
+            In->FinishDataXfer(Raw.data() + i * TransferBytes, Len, &Ov[i], Context[i]);
+        }
+        CloseHandle(Ov[i].hEvent);
+    }
+    return(Result);
+}
+
+//===================================================================================================================
+
+// Opens the board for a live readout, returns null if it can't be opened
+EVM_LIVE __stdcall EVM_LiveOpen(int USBdev)
+{
+    EVM_Live* Live = new EVM_Live(USBdev);
+    if (!Live->Open())
+    {
+        delete Live;
+        return(nullptr);
+    }
+    return(Live);
+}
+
+// Stops the readout and closes the board
+void __stdcall EVM_LiveClose(EVM_LIVE Live)
+{
+    delete Live;
+}
+
+// Starts the conversions of Channels channels, delivered as SampleType as in EVM_DataCapEx, keeping nQueued reads
+// posted (0 = 4) of FramesPerTransfer frames (0 = 1), rounded up to whole USB packets. A frame is the A and B
+// DVALIDs, 2 * Channels samples. STRINGLEN / (8 * Channels) frames per transfer and one read posted reproduce
+// the transfers of EVM_DataCap, to compare their latency.
+long __stdcall EVM_LiveStart(EVM_LIVE Live, int Channels, int SampleType, byte* CFGHIGH, int nQueued, int FramesPerTransfer)
+{
+    if (Live == nullptr || CFGHIGH == nullptr) return(-7);
+    return Live->Start(Channels, SampleType, *CFGHIGH, nQueued, FramesPerTransfer);
+}
+
+// Stops the conversions. Returns the error that ended the readout or 0.
+long __stdcall EVM_LiveStop(EVM_LIVE Live)
+{
+    if (Live == nullptr) return(-7);
+    return Live->Stop();
+}
+
+// Waits up to TimeoutMs (-1 = forever) for a frame newer than the last one returned and copies the newest into
+// Frame, 2 * Channels samples. Returns the frames that came in between and were skipped, -4 on timeout, -13 or
+// the error that ended the readout once it is over.
+long __stdcall EVM_LiveLatest(EVM_LIVE Live, int TimeoutMs, void* Frame, EVM_BlockInfo* Info)
+{
+    if (Live == nullptr) return(-7);
+    return Live->Latest(TimeoutMs, Frame, Info);
+}
+
+// Frame to host latency percentiles of the readout so far, see EVM_Latency
+long __stdcall EVM_LiveGetLatency(EVM_LIVE Live, EVM_Latency* Latency)
+{
+    if (Live == nullptr || Latency == nullptr) return(-7);
+    Live->Latency.Get(Latency);
+    return(0);
+}
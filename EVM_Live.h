@@ -0,0 +1,81 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ *
+ * Live readout for closed loop control. The conversions run without pause while a thread
+ * keeps a few small reads posted, each of about one frame (the A and B DVALIDs), so a frame
+ * reaches the host as soon as it is converted instead of waiting for a large transfer to
+ * fill. Only the newest frame of each transfer is decoded and the caller always gets the
+ * most recent one; the frames it had no time for are counted, not queued.
+ */
+
+#ifndef EVM_LIVE_H
+#define EVM_LIVE_H
+
+#include "EVM_Timing.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class CCyUSBDevice;
+class EVM_Board;
+
+struct EVM_Live
+{
+    int USBdev;
+    std::unique_ptr<CCyUSBDevice> USBDevice;
+    EVM_Board* Board;           // Owned by the data path while the reader runs
+
+    int Channels;
+    EVM_Conversion Conv;
+    long FrameBytes;            // Raw bytes of a frame
+    long TransferBytes;         // Whole frames, rounded up to whole USB packets
+    int nQueued;
+    std::vector<unsigned char> Raw;
+
+    // Start of a frame cut by the end of a read, completed by the next one. Reader thread only.
+    std::vector<unsigned char> Carry;
+    long CarryBytes;
+
+    // Newest frame, guarded by Lock
+    std::mutex Lock;
+    std::condition_variable Arrived;
+    std::vector<unsigned char> NewestFrame;
+    EVM_BlockInfo NewestInfo;
+    long long Newest;           // Frames received
+    long long Returned;         // Newest frame given to the caller
+    bool Running;
+    long Error;
+
+    EVM_TimingFit Timing;       // Reader thread only
+    EVM_LatencyMeter Latency;
+    std::thread Reader;
+    std::atomic<bool> StopRequest;
+
+    EVM_Live(int USBdev);
+    ~EVM_Live();
+
+    bool Open();
+    long Start(int Channels, int SampleType, byte CFGHIGH, int nQueued, int FramesPerTransfer);
+    long Stop();
+    long Latest(int TimeoutMs, void* Frame, EVM_BlockInfo* Info);
+
+private:
+    EVM_Live(const EVM_Live&);
+    EVM_Live& operator=(const EVM_Live&);
+
+    void ReaderLoop();
+    long ReadLoop();
+};
+
+#endif // EVM_LIVE_H
@@ -0,0 +1,194 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ */
+
+#include "StdAfx.h"
+#include "DDC264EVM_IO.h"
+#include "EVM_Internal.h"
+#include "EVM_Queue.h"
+#include "EVM_Memory.h"
+
+#include <mutex>
+
+// Large pages need the "Lock pages in memory" right, which is held disabled in the token until asked for
+static bool EnableLockMemoryPrivilege()
+{
+    HANDLE Token;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &Token)) return false;
+
+    TOKEN_PRIVILEGES Tp;
+    Tp.PrivilegeCount = 1;
+    Tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    bool Ok = LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &Tp.Privileges[0].Luid) &&
+              AdjustTokenPrivileges(Token, FALSE, &Tp, 0, NULL, NULL) && GetLastError() == ERROR_SUCCESS;
+    CloseHandle(Token);
+    return Ok;
+}
+
+// VirtualLock is limited by the minimum working set, grow it by what is about to be locked
+static bool GrowWorkingSet(size_t Bytes, bool Grow)
+{
+    SIZE_T Min, Max;
+    if (!GetProcessWorkingSetSize(GetCurrentProcess(), &Min, &Max)) return false;
+    if (Grow) return SetProcessWorkingSetSize(GetCurrentProcess(), Min + Bytes, Max + Bytes) != 0;
+    if (Min < Bytes || Max < Bytes) return false;
+    return SetProcessWorkingSetSize(GetCurrentProcess(), Min - Bytes, Max - Bytes) != 0;
+}
+
+bool EVM_PageBlock::Allocate(size_t Bytes, int Flags)
+{
+    Free();
+    if (Bytes == 0) return true;
+
+    if (Flags & EVM_MEM_LARGE_PAGES)
+    {
+        static const bool Privilege = EnableLockMemoryPrivilege();
+        SIZE_T LargePage = GetLargePageMinimum();
+        if (Privilege && LargePage > 0)
+        {
+            size_t Rounded = (Bytes + LargePage - 1) / LargePage * LargePage;
+            Ptr = (unsigned char*)VirtualAlloc(NULL, Rounded, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            if (Ptr != nullptr)
+            {
+                // Large pages are never paged out: already resident and locked
+                Size = Rounded;
+                Large = true;
+                Locked = true;
+                return true;
+            }
+        }
+    }
+
+    Ptr = (unsigned char*)VirtualAlloc(NULL, Bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (Ptr == nullptr) return false;
+    Size = Bytes;
+
+    // Touch every page now rather than on the first transfer
+    for (size_t i = 0; i < Size; i += 4096) Ptr[i] = 0;
+    Ptr[Size - 1] = 0;
+
+    if (Flags & EVM_MEM_LOCK)
+    {
+        if (GrowWorkingSet(Size, true))
+        {
+            Locked = (VirtualLock(Ptr, Size) != 0);
+            if (!Locked) GrowWorkingSet(Size, false);
+        }
+    }
+    return true;
+}
+
+void EVM_PageBlock::Free()
+{
+    if (Ptr == nullptr) return;
+    if (Locked && !Large)
+    {
+        VirtualUnlock(Ptr, Size);
+        GrowWorkingSet(Size, false);
+    }
+    VirtualFree(Ptr, 0, MEM_RELEASE);
+    Ptr = nullptr;
+    Size = 0;
+    Large = false;
+    Locked = false;
+}
+
+//===================================================================================================================
+
+struct EVM_BufferPool::FreeList
+{
+    EVM_BoundedQueue<int> Queue;
+};
+
+EVM_BufferPool::EVM_BufferPool() : Free(new FreeList), N(0), BufSize(0)
+{
+}
+
+EVM_BufferPool::~EVM_BufferPool()
+{
+}
+
+bool EVM_BufferPool::Setup(int Count, size_t Size, int Flags)
+{
+    // Buffers start on a cache line
+    Size = (Size + 63) & ~(size_t)63;
+    if (!Block.Allocate((size_t)Count * Size, Flags)) return false;
+
+    N = Count;
+    BufSize = Size;
+    Free->Queue.Reset(Count);
+    for (int i = 0; i < Count; i++) Free->Queue.TryPush(i);
+    return true;
+}
+
+int EVM_BufferPool::Take()
+{
+    int i;
+    return Free->Queue.TryPop(i) ? i : -1;
+}
+
+void EVM_BufferPool::Give(int i)
+{
+    Free->Queue.TryPush(i);
+}
+
+//===================================================================================================================
+
+static std::mutex SharedLock;
+static std::shared_ptr<EVM_BufferPool> SharedPool;
+
+// Default shared pool: one buffer per thread that may be capturing at a time, plain pageable memory
+static const int SHARED_BUFFERS = 4;
+
+static std::shared_ptr<EVM_BufferPool> CurrentPool()
+{
+    std::lock_guard<std::mutex> L(SharedLock);
+    if (!SharedPool)
+    {
+        std::shared_ptr<EVM_BufferPool> Pool(new EVM_BufferPool);
+        if (Pool->Setup(SHARED_BUFFERS, STRINGLEN, 0)) SharedPool = Pool;
+    }
+    return SharedPool;
+}
+
+EVM_ScratchBuffer::EVM_ScratchBuffer() : Pool(CurrentPool()), Index(-1), Ptr(nullptr)
+{
+    if (Pool) Index = Pool->Take();
+    if (Index >= 0) Ptr = Pool->Buffer(Index);
+    else
+    {
+        Fallback.reset(new unsigned char[STRINGLEN]);
+        Ptr = Fallback.get();
+    }
+}
+
+EVM_ScratchBuffer::~EVM_ScratchBuffer()
+{
+    if (Index >= 0) Pool->Give(Index);
+}
+
+// Replaces the pool of transfer buffers shared by the blocking calls (EVM_DataCap, EVM_RegsTransfer...)
+// with nBuffers buffers allocated with the EVM_MEM_xxx Flags. Calls already running keep the old pool.
+// Returns 0, or the EVM_MEM_xxx flags that could not be honoured, -3 if there is no memory.
+long __stdcall EVM_SetMemoryOptions(int Flags, int nBuffers)
+{
+    if (nBuffers < 1 || nBuffers > 1024 || (Flags & ~(EVM_MEM_LOCK | EVM_MEM_LARGE_PAGES)) != 0) return(-7);
+
+    std::shared_ptr<EVM_BufferPool> Pool(new EVM_BufferPool);
+    if (!Pool->Setup(nBuffers, STRINGLEN, Flags)) return(-3);
+
+    long Missing = 0;
+    if ((Flags & EVM_MEM_LARGE_PAGES) && !Pool->Memory().LargePages()) Missing |= EVM_MEM_LARGE_PAGES;
+    if ((Flags & EVM_MEM_LOCK) && !Pool->Memory().IsLocked()) Missing |= EVM_MEM_LOCK;
+
+    std::lock_guard<std::mutex> L(SharedLock);
+    SharedPool = Pool;
+    return(Missing);
+}
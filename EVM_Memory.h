@@ -0,0 +1,92 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ *
+ * Transfer buffer memory: page aligned blocks that are touched once when allocated and,
+ * on request, locked in memory or backed by large pages, so the transfer path never
+ * takes a page fault or calls the allocator.
+ */
+
+#ifndef EVM_MEMORY_H
+#define EVM_MEMORY_H
+
+#include <memory>
+#include <stddef.h>
+
+class EVM_PageBlock
+{
+public:
+    EVM_PageBlock() : Ptr(nullptr), Size(0), Large(false), Locked(false) {}
+    ~EVM_PageBlock() { Free(); }
+
+    // Allocates Bytes with the EVM_MEM_xxx Flags. Large pages or locking that can't be had are
+    // silently left out, see LargePages and IsLocked. Returns false only if there is no memory.
+    bool Allocate(size_t Bytes, int Flags);
+    void Free();
+
+    unsigned char* Data() const { return Ptr; }
+    size_t Bytes() const { return Size; }
+    bool LargePages() const { return Large; }
+    bool IsLocked() const { return Locked; }
+
+private:
+    EVM_PageBlock(const EVM_PageBlock&);
+    EVM_PageBlock& operator=(const EVM_PageBlock&);
+
+    unsigned char* Ptr;
+    size_t Size;
+    bool Large;
+    bool Locked;
+};
+
+// Count buffers of Size bytes carved from one block, taken and given back without locks
+class EVM_BufferPool
+{
+public:
+    EVM_BufferPool();
+    ~EVM_BufferPool();
+
+    bool Setup(int Count, size_t Size, int Flags);
+    int Count() const { return N; }
+    size_t Size() const { return BufSize; }
+    unsigned char* Buffer(int i) const { return Block.Data() + (size_t)i * BufSize; }
+    const EVM_PageBlock& Memory() const { return Block; }
+
+    int Take();         // -1 if all are in use
+    void Give(int i);
+
+private:
+    struct FreeList;
+
+    EVM_PageBlock Block;
+    std::unique_ptr<FreeList> Free;
+    int N;
+    size_t BufSize;
+};
+
+// STRINGLEN bytes for the blocking calls, from the process wide pool set by EVM_SetMemoryOptions.
+// Falls back to a plain allocation when every pooled buffer is in use.
+class EVM_ScratchBuffer
+{
+public:
+    EVM_ScratchBuffer();
+    ~EVM_ScratchBuffer();
+    unsigned char* Data() const { return Ptr; }
+
+private:
+    EVM_ScratchBuffer(const EVM_ScratchBuffer&);
+    EVM_ScratchBuffer& operator=(const EVM_ScratchBuffer&);
+
+    std::shared_ptr<EVM_BufferPool> Pool;
+    int Index;
+    std::unique_ptr<unsigned char[]> Fallback;
+    unsigned char* Ptr;
+};
+
+#endif // EVM_MEMORY_H
@@ -0,0 +1,112 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ *
+ * Bounded lock-free queue for any number of producers and consumers (D. Vyukov's
+ * sequenced ring). Push and pop never block: the caller decides how to wait.
+ */
+
+#ifndef EVM_QUEUE_H
+#define EVM_QUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+
+template <typename T>
+class EVM_BoundedQueue
+{
+public:
+    EVM_BoundedQueue() : Mask(0), Head(0), Tail(0), Max(0) {}
+
+    // Empties the queue and sizes it to Capacity rounded up to a power of 2. Not thread safe.
+    void Reset(size_t Capacity)
+    {
+        size_t n = 1;
+        while (n < Capacity) n <<= 1;
+        Cells.reset(new Cell[n]);
+        for (size_t i = 0; i < n; i++) Cells[i].Seq.store(i, std::memory_order_relaxed);
+        Mask = n - 1;
+        Head.store(0, std::memory_order_relaxed);
+        Tail.store(0, std::memory_order_relaxed);
+        Max.store(0, std::memory_order_relaxed);
+    }
+
+    // Returns false if the queue is full
+    bool TryPush(const T& Item)
+    {
+        size_t Pos = Head.load(std::memory_order_relaxed);
+        Cell* C;
+        for (;;)
+        {
+            C = &Cells[Pos & Mask];
+            ptrdiff_t Diff = (ptrdiff_t)C->Seq.load(std::memory_order_acquire) - (ptrdiff_t)Pos;
+            if (Diff == 0)
+            {
+                if (Head.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed)) break;
+            }
+            else if (Diff < 0) return false;
+            else Pos = Head.load(std::memory_order_relaxed);
+        }
+        C->Item = Item;
+        C->Seq.store(Pos + 1, std::memory_order_release);
+
+        size_t d = Depth();
+        size_t m = Max.load(std::memory_order_relaxed);
+        while (d > m && !Max.compare_exchange_weak(m, d, std::memory_order_relaxed)) {}
+        return true;
+    }
+
+    // Returns false if the queue is empty
+    bool TryPop(T& Item)
+    {
+        size_t Pos = Tail.load(std::memory_order_relaxed);
+        Cell* C;
+        for (;;)
+        {
+            C = &Cells[Pos & Mask];
+            ptrdiff_t Diff = (ptrdiff_t)C->Seq.load(std::memory_order_acquire) - (ptrdiff_t)(Pos + 1);
+            if (Diff == 0)
+            {
+                if (Tail.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed)) break;
+            }
+            else if (Diff < 0) return false;
+            else Pos = Tail.load(std::memory_order_relaxed);
+        }
+        Item = C->Item;
+        C->Seq.store(Pos + Mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate number of items, exact when no push or pop is in progress
+    size_t Depth() const
+    {
+        size_t h = Head.load(std::memory_order_relaxed);
+        size_t t = Tail.load(std::memory_order_relaxed);
+        return (h > t) ? h - t : 0;
+    }
+
+    // Highest depth seen since Reset
+    size_t HighWater() const { return Max.load(std::memory_order_relaxed); }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> Seq;
+        T Item;
+    };
+
+    std::unique_ptr<Cell[]> Cells;
+    size_t Mask;
+    std::atomic<size_t> Head;
+    std::atomic<size_t> Tail;
+    std::atomic<size_t> Max;
+};
+
+#endif // EVM_QUEUE_H
@@ -0,0 +1,217 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ */
+
+#include "StdAfx.h"
+#include "DDC264EVM_IO.h"
+#include "EVM_Timing.h"
+#include "EVM_Recorder.h"
+
+#include <cstring>
+
+static const unsigned char Zeros[EVM_RECORD_ALIGN] = {};
+
+EVM_Recorder::EVM_Recorder() : File(INVALID_HANDLE_VALUE), ChunkBytes(0), Current(0), Fill(0), Offset(0), Length(0), Failed(false),
+    Bytes(0), Blocks(0), Writes(0), Waits(0), InFlight(0), InFlightMax(0), Started(0), Ended(0)
+{
+}
+
+EVM_Recorder::~EVM_Recorder()
+{
+    Close();
+}
+
+long EVM_Recorder::Open(const char* Path, int Depth, size_t ChunkBytes, int MemoryFlags, const EVM_RecordHeader& Header)
+{
+    Close();
+    if (Depth < 2 || ChunkBytes == 0 || ChunkBytes % EVM_RECORD_ALIGN != 0) return(-7);
+
+    // Page aligned, which is also sector aligned as unbuffered I/O needs
+    if (Memory.Bytes() < Depth * ChunkBytes && !Memory.Allocate(Depth * ChunkBytes, MemoryFlags)) return(-3);
+
+    File = CreateFileA(Path, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS,
+                       FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED, NULL);
+    if (File == INVALID_HANDLE_VALUE) return(-17);
+
+    Chunks.resize(Depth);
+    for (Chunk& C : Chunks)
+    {
+        memset(&C.Ov, 0, sizeof(C.Ov));
+        C.Ov.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+        C.Bytes = 0;
+        C.Pending = false;
+    }
+    this->ChunkBytes = ChunkBytes;
+    Current = 0;
+    Fill = 0;
+    Offset = 0;
+    Length = 0;
+    Failed = false;
+    Indexer.Start(Header.SampleType);
+    {
+        std::lock_guard<std::mutex> L(StatsLock);
+        Bytes = Blocks = Writes = Waits = 0;
+        InFlight = InFlightMax = 0;
+        Started = EVM_Now();
+        Ended = 0;
+    }
+
+    if (!Append(&Header, sizeof(Header)) || !Append(Zeros, EVM_RECORD_ALIGN - sizeof(Header)))
+    {
+        Close();
+        return(-17);
+    }
+    return(0);
+}
+
+bool EVM_Recorder::Write(const EVM_BlockInfo& Info, const void* Data, size_t Size, int Width)
+{
+    EVM_RecordBlock Head;
+    Head.Magic = EVM_RECORD_BLOCK_MAGIC;
+    Head.Bytes = (unsigned int)Size;
+    Head.Width = Width;
+    Head.Reserved = 0;
+    Head.Info = Info;
+    Indexer.Add(Length, Info, Data, Size, Width);
+
+    size_t Pad = (8 - Size % 8) % 8;
+    if (!Append(&Head, sizeof(Head)) || !Append(Data, Size) || !Append(Zeros, Pad)) return false;
+
+    std::lock_guard<std::mutex> L(StatsLock);
+    Blocks++;
+    return true;
+}
+
+// Copies into the current chunk, writing it out each time it fills
+bool EVM_Recorder::Append(const void* Data, size_t n)
+{
+    const unsigned char* Src = (const unsigned char*)Data;
+    while (n > 0 && !Failed)
+    {
+        size_t Part = min(n, ChunkBytes - Fill);
+        memcpy(Memory.Data() + Current * ChunkBytes + Fill, Src, Part);
+        Fill += Part;
+        Length += Part;
+        Src += Part;
+        n -= Part;
+
+        if (Fill == ChunkBytes)
+        {
+            if (!Issue(ChunkBytes)) return false;
+
+            // The next chunk to fill is the oldest write: wait for it if the disk is behind
+            Current = (Current + 1) % (int)Chunks.size();
+            Fill = 0;
+            if (Chunks[Current].Pending)
+            {
+                {
+                    std::lock_guard<std::mutex> L(StatsLock);
+                    Waits++;
+                }
+                if (!Finish(Current)) return false;
+            }
+        }
+    }
+    return !Failed;
+}
+
+// Starts the write of the first n bytes of the current chunk at its place in the file
+bool EVM_Recorder::Issue(size_t n)
+{
+    Chunk& C = Chunks[Current];
+    C.Ov.Offset = (DWORD)Offset;
+    C.Ov.OffsetHigh = (DWORD)(Offset >> 32);
+    C.Bytes = (DWORD)n;
+    Offset += n;
+
+    if (!WriteFile(File, Memory.Data() + Current * ChunkBytes, (DWORD)n, NULL, &C.Ov) && GetLastError() != ERROR_IO_PENDING)
+    {
+        Failed = true;
+        return false;
+    }
+    C.Pending = true;
+
+    std::lock_guard<std::mutex> L(StatsLock);
+    Writes++;
+    InFlight++;
+    InFlightMax = max(InFlightMax, InFlight);
+    return true;
+}
+
+// Waits for the write of chunk c
+bool EVM_Recorder::Finish(int c)
+{
+    Chunk& C = Chunks[c];
+    DWORD Done = 0;
+    bool Ok = GetOverlappedResult(File, &C.Ov, &Done, TRUE) && Done == C.Bytes;
+    C.Pending = false;
+    if (!Ok) Failed = true;
+
+    std::lock_guard<std::mutex> L(StatsLock);
+    InFlight--;
+    if (Ok) Bytes += Done;
+    return Ok;
+}
+
+long EVM_Recorder::Close()
+{
+    if (File == INVALID_HANDLE_VALUE) return(0);
+
+    if (!Failed)
+    {
+        Indexer.Flush();
+        EVM_RecordTrailer Trailer;
+        Trailer.IndexOffset = Length;
+        Trailer.Entries = Indexer.Entries();
+        Trailer.Magic = EVM_RECORD_INDEX_MAGIC;
+        Append(Indexer.Index().data(), Indexer.Index().size());
+        Append(&Trailer, sizeof(Trailer));
+    }
+
+    // The last chunk goes out padded to a whole sector, the file is then cut back to its length
+    if (!Failed && Fill > 0)
+    {
+        size_t Padded = (Fill + EVM_RECORD_ALIGN - 1) / EVM_RECORD_ALIGN * EVM_RECORD_ALIGN;
+        memset(Memory.Data() + Current * ChunkBytes + Fill, 0, Padded - Fill);
+        Issue(Padded);
+    }
+    for (int c = 0; c < (int)Chunks.size(); c++)
+    {
+        if (Chunks[c].Pending) Finish(c);
+    }
+    if (!Failed)
+    {
+        LARGE_INTEGER End;
+        End.QuadPart = Length;
+        if (!SetFilePointerEx(File, End, NULL, FILE_BEGIN) || !SetEndOfFile(File)) Failed = true;
+    }
+
+    for (Chunk& C : Chunks) CloseHandle(C.Ov.hEvent);
+    CloseHandle(File);
+    File = INVALID_HANDLE_VALUE;
+    {
+        std::lock_guard<std::mutex> L(StatsLock);
+        Ended = EVM_Now();
+    }
+    return Failed ? -17 : 0;
+}
+
+void EVM_Recorder::GetStats(EVM_RecordStats* Stats)
+{
+    std::lock_guard<std::mutex> L(StatsLock);
+    double Seconds = ((Ended > 0) ? Ended : EVM_Now()) - Started;
+    Stats->Bytes = Bytes;
+    Stats->Blocks = Blocks;
+    Stats->Writes = Writes;
+    Stats->Waits = Waits;
+    Stats->QueueDepth = InFlight;
+    Stats->QueueMax = InFlightMax;
+    Stats->MBs = (Started > 0 && Seconds > 0) ? Bytes / Seconds / 1e6 : 0;
+}
@@ -0,0 +1,84 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ *
+ * Disk recorder of a stream. Blocks are packed into a ring of sector aligned chunks that
+ * are written with unbuffered overlapped I/O, so a recording of any length takes the same
+ * memory and never goes through the file cache. When every chunk is still being written
+ * the next block waits for the oldest one: the stream slows down instead of the queue
+ * growing. The blocks are indexed as they go by and the index ends the file.
+ */
+
+#ifndef EVM_RECORDER_H
+#define EVM_RECORDER_H
+
+#include "EVM_Memory.h"
+#include "EVM_Archive.h"
+
+#include <mutex>
+#include <vector>
+
+class EVM_Recorder
+{
+public:
+    EVM_Recorder();
+    ~EVM_Recorder();
+
+    // Creates Path and writes Header. Depth chunks of ChunkBytes, a multiple of the sector size.
+    // Returns 0, -3 if there is no memory, -17 if the file can't be created or written.
+    long Open(const char* Path, int Depth, size_t ChunkBytes, int MemoryFlags, const EVM_RecordHeader& Header);
+    bool IsOpen() const { return File != INVALID_HANDLE_VALUE; }
+
+    // Appends a block of Size bytes in rows of Width samples (0 for event records). Returns false if the disk failed.
+    bool Write(const EVM_BlockInfo& Info, const void* Data, size_t Size, int Width);
+
+    // Writes the index and what is left, waits for every write and trims the file to its length. Returns 0 or -17.
+    long Close();
+
+    void GetStats(EVM_RecordStats* Stats);
+
+private:
+    EVM_Recorder(const EVM_Recorder&);
+    EVM_Recorder& operator=(const EVM_Recorder&);
+
+    struct Chunk
+    {
+        OVERLAPPED Ov;
+        DWORD Bytes;
+        bool Pending;
+    };
+
+    bool Append(const void* Data, size_t n);
+    bool Issue(size_t n);
+    bool Finish(int c);
+
+    HANDLE File;
+    EVM_PageBlock Memory;
+    std::vector<Chunk> Chunks;
+    size_t ChunkBytes;
+    int Current;          // Chunk being filled
+    size_t Fill;          // Bytes in it
+    long long Offset;     // File offset of the next chunk written
+    long long Length;     // Of the file, without the padding of the last chunk
+    bool Failed;
+    EVM_RecordIndexer Indexer;
+
+    // Metrics, guarded by StatsLock
+    std::mutex StatsLock;
+    long long Bytes;
+    long long Blocks;
+    long long Writes;
+    long long Waits;
+    int InFlight;
+    int InFlightMax;
+    double Started;
+    double Ended;
+};
+
+#endif // EVM_RECORDER_H
@@ -0,0 +1,255 @@
+/**
+ * Register schema of the DDC264EVM FPGA
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ *
+ * Every command sent through the bulk out endpoint is a sequence of
+ * (register, value) byte pairs. The addresses, bit fields and the fixed
+ * command sequences used by the library are defined here as compile time
+ * constants, so packets are assembled by the compiler with no allocation.
+ */
+
+#ifndef EVM_REGISTERS_H
+#define EVM_REGISTERS_H
+
+#include <stddef.h>
+
+// FPGA register addresses
+enum EVM_RegAddr : unsigned char
+{
+    EVM_REG_NOOP                 = 0x00,
+    EVM_REG_CONV_LOW_MSB         = 0x01,
+    EVM_REG_CONV_LOW_MIDB        = 0x02,
+    EVM_REG_CONV_LOW_LSB         = 0x03,
+    EVM_REG_CONV_HIGH_MSB        = 0x04,
+    EVM_REG_CONV_HIGH_MIDB       = 0x05,
+    EVM_REG_CONV_HIGH_LSB        = 0x06,
+    EVM_REG_DIVXCLK              = 0x07,
+    EVM_REG_DDC_CLK_SEL          = 0x08,
+    EVM_REG_FORMAT_CHANNELS      = 0x09,
+    EVM_REG_DIVXCLK_DATA         = 0x0A,
+    EVM_REG_DDC_DATA_CLK_SEL     = 0x0B,
+    EVM_REG_NDVALIDS_IGNORE      = 0x0C,
+    EVM_REG_NDVALIDS_READ_LSB    = 0x0D,
+    EVM_REG_NDVALIDS_READ_MIDB   = 0x0E,
+    EVM_REG_NDVALIDS_READ_MSB    = 0x0F,
+    EVM_REG_CONVERSIONS          = 0x10,
+    EVM_REG_CLK_CFG              = 0x11,
+    EVM_REG_DIN_CFG              = 0x12,
+    EVM_REG_DCLK_WAIT_COUNT_MSB  = 0x13,
+    EVM_REG_DCLK_WAIT_COUNT_LSB  = 0x14,
+    EVM_REG_DDC_RESETN           = 0x15,
+    EVM_REG_HARDWARE_TRIGGER_EN  = 0x16,
+    EVM_REG_DCLK_SELECT          = 0x1A,
+    EVM_REG_DOUT_IN_DCLK_MANUAL  = 0x1B,
+    EVM_REG_DDC_CFGHIGH          = 0x1C,
+    EVM_REG_DDC_CFGLOW           = 0x1D,
+    EVM_REG_TRIGGER              = 0x1E,
+    EVM_REG_FORMAT_DIN_CFG       = 0x1F,
+    EVM_REG_FREQ_DIV_DIN_CLK     = 0x20,
+    EVM_REG_DAUGHTER_CARD_SELECT = 0x22,
+    EVM_REG_CONV_WAIT_LOW_MSB    = 0x51,
+    EVM_REG_CONV_WAIT_LOW_LSB    = 0x52,
+    EVM_REG_CONV_WAIT_HIGH_MSB   = 0x53,
+    EVM_REG_CONV_WAIT_HIGH_LSB   = 0x54,
+    EVM_REG_NON_CONT             = 0x55,
+    EVM_REG_RESET_CONV           = 0x56,
+    EVM_REG_CONV_CONFIG          = 0x57,
+    EVM_REG_FIRMWARE_VERSION_MSB = 0x5E,
+    EVM_REG_FIRMWARE_VERSION_LSB = 0x5F,
+    EVM_REG_READ_OUT_TRIGGER     = 0xD0,
+    EVM_REG_RESERVED_D1          = 0xD1,
+    EVM_REG_TRIGGER_READ_AVG_RAM = 0xDA,
+    EVM_REG_STOP_ADDR_MSB        = 0xDB,
+    EVM_REG_STOP_ADDR_LSB        = 0xDC,
+    EVM_REG_AB_AVG_SEL           = 0xDD,
+    EVM_REG_USE_RAM_CHIPS        = 0xDE,
+    EVM_REG_CLKDELAY_AROUND_CONV = 0xEB,
+    EVM_REG_SOFT_FPGA_RESET      = 0xFF,
+};
+
+constexpr int EVM_REG_COUNT = 256;
+
+// Bit field of width Width at bit Shift inside a single register
+template <unsigned char Addr, int Shift, int Width>
+struct EVM_Field
+{
+    static constexpr unsigned char Reg() { return Addr; }
+    static constexpr unsigned char Mask() { return (unsigned char)(((1 << Width) - 1) << Shift); }
+    static constexpr int Get(int value) { return (value & Mask()) >> Shift; }
+    static constexpr unsigned char Set(int value, int field) { return (unsigned char)((value & ~Mask()) | ((field << Shift) & Mask())); }
+    static constexpr unsigned char Make(int field) { return Set(0, field); }
+};
+
+// Value split over several byte registers, most significant byte first
+template <unsigned char... Addrs>
+struct EVM_Word
+{
+    static constexpr int Bytes() { return sizeof...(Addrs); }
+    static constexpr unsigned char Reg(int i) { const unsigned char A[] = { Addrs... }; return A[i]; }
+    static constexpr long Get(const int* Regs)
+    {
+        long value = 0;
+        for (int i = 0; i < Bytes(); i++) value = (value << 8) | (Regs[Reg(i)] & 0xFF);
+        return value;
+    }
+    static constexpr unsigned char Byte(long value, int i) { return (unsigned char)(value >> (8 * (Bytes() - 1 - i))); }
+};
+
+// FPGA register fields
+typedef EVM_Field<EVM_REG_FORMAT_CHANNELS, 4, 1> EVM_FORMAT;            // 0 = 16 bits, 1 = 20 bits
+typedef EVM_Field<EVM_REG_FORMAT_CHANNELS, 0, 4> EVM_CHANNELS;          // log2(channel count), 0 to 8
+typedef EVM_Field<EVM_REG_CONVERSIONS, 0, 1> EVM_START_CONVERSIONS;
+typedef EVM_Field<EVM_REG_CONVERSIONS, 1, 1> EVM_DONE;
+typedef EVM_Field<EVM_REG_DIVXCLK, 4, 4> EVM_CLC_HIGH;
+typedef EVM_Field<EVM_REG_DIVXCLK, 0, 4> EVM_CLC_LOW;
+typedef EVM_Field<EVM_REG_DIVXCLK_DATA, 4, 4> EVM_DCLK_HIGH;
+typedef EVM_Field<EVM_REG_DIVXCLK_DATA, 0, 4> EVM_DCLK_LOW;
+typedef EVM_Field<EVM_REG_FREQ_DIV_DIN_CLK, 4, 4> EVM_CLK_CFG_HI;
+typedef EVM_Field<EVM_REG_FREQ_DIV_DIN_CLK, 0, 4> EVM_CLK_CFG_LO;
+typedef EVM_Field<EVM_REG_DOUT_IN_DCLK_MANUAL, 1, 1> EVM_DOUT_IN;
+typedef EVM_Field<EVM_REG_DOUT_IN_DCLK_MANUAL, 0, 1> EVM_DCLK_MANUAL_SET_VALUE;
+
+typedef EVM_Word<EVM_REG_CONV_LOW_MSB, EVM_REG_CONV_LOW_MIDB, EVM_REG_CONV_LOW_LSB> EVM_CONV_LOW;
+typedef EVM_Word<EVM_REG_CONV_HIGH_MSB, EVM_REG_CONV_HIGH_MIDB, EVM_REG_CONV_HIGH_LSB> EVM_CONV_HIGH;
+typedef EVM_Word<EVM_REG_NDVALIDS_READ_MSB, EVM_REG_NDVALIDS_READ_MIDB, EVM_REG_NDVALIDS_READ_LSB> EVM_NDVALIDS_READ;
+typedef EVM_Word<EVM_REG_DCLK_WAIT_COUNT_MSB, EVM_REG_DCLK_WAIT_COUNT_LSB> EVM_DCLK_WAIT_COUNT;
+typedef EVM_Word<EVM_REG_CONV_WAIT_LOW_MSB, EVM_REG_CONV_WAIT_LOW_LSB> EVM_CONV_WAIT_LOW;
+typedef EVM_Word<EVM_REG_CONV_WAIT_HIGH_MSB, EVM_REG_CONV_WAIT_HIGH_LSB> EVM_CONV_WAIT_HIGH;
+typedef EVM_Word<EVM_REG_FIRMWARE_VERSION_MSB, EVM_REG_FIRMWARE_VERSION_LSB> EVM_FIRMWARE_VERSION;
+
+// DDC264 configuration bits, as sent in the CFGHIGH (0x1C) and CFGLOW (0x1D) data bytes
+typedef EVM_Field<EVM_REG_DDC_CFGHIGH, 5, 1> EVM_CFG_CLKDIV;            // DDC bit 13
+typedef EVM_Field<EVM_REG_DDC_CFGHIGH, 1, 2> EVM_CFG_RANGE;             // DDC bits 10:9
+typedef EVM_Field<EVM_REG_DDC_CFGHIGH, 0, 1> EVM_CFG_FORMAT;            // DDC bit 8, 0 = 16 bits, 1 = 20 bits
+typedef EVM_Field<EVM_REG_DDC_CFGLOW, 7, 1> EVM_CFG_SPEED;              // DDC bit 7
+typedef EVM_Field<EVM_REG_DDC_CFGLOW, 4, 1> EVM_CFG_SLEW;               // DDC bit 4
+typedef EVM_Field<EVM_REG_DDC_CFGLOW, 0, 1> EVM_CFG_TEST;               // DDC bit 0
+
+// Channel count held in the CHANNELS field, 0 for an invalid field value
+constexpr int EVM_ChannelCount(int FormatChannels)
+{
+    return (EVM_CHANNELS::Get(FormatChannels) <= 8) ? (1 << EVM_CHANNELS::Get(FormatChannels)) : 0;
+}
+
+// CHANNELS field value for a power of two channel count, -1 if not valid
+constexpr int EVM_ChannelsField(int Channels)
+{
+    for (int i = 0; i <= 8; i++) if ((1 << i) == Channels) return i;
+    return -1;
+}
+
+//===================================================================================================================
+// Command packets
+
+struct EVM_Op
+{
+    unsigned char Reg;
+    unsigned char Data;
+};
+
+constexpr EVM_Op EVM_NOP = { EVM_REG_NOOP, 0x00 };
+
+// Fixed size packet assembled at compile time
+template <size_t N>
+struct EVM_Packet
+{
+    unsigned char Bytes[2 * N];
+    static constexpr long Length() { return 2 * N; }
+};
+
+template <size_t N>
+constexpr EVM_Packet<N> EVM_MakePacket(const EVM_Op (&Ops)[N])
+{
+    EVM_Packet<N> P = {};
+    for (size_t i = 0; i < N; i++)
+    {
+        P.Bytes[2 * i] = Ops[i].Reg;
+        P.Bytes[2 * i + 1] = Ops[i].Data;
+    }
+    return P;
+}
+
+template <size_t N, size_t M>
+constexpr EVM_Packet<N + M> EVM_Concat(const EVM_Packet<N>& A, const EVM_Packet<M>& B)
+{
+    EVM_Packet<N + M> P = {};
+    for (size_t i = 0; i < 2 * N; i++) P.Bytes[i] = A.Bytes[i];
+    for (size_t i = 0; i < 2 * M; i++) P.Bytes[2 * N + i] = B.Bytes[i];
+    return P;
+}
+
+// Packet of up to N operations filled at run time, lives on the stack
+template <size_t N>
+struct EVM_PacketBuf
+{
+    unsigned char Bytes[2 * N];
+    long Length = 0;
+
+    bool Put(unsigned char Reg, unsigned char Data)
+    {
+        if (Length + 2 > (long)(2 * N)) return false;
+        Bytes[Length++] = Reg;
+        Bytes[Length++] = Data;
+        return true;
+    }
+
+    template <size_t M>
+    bool Put(const EVM_Packet<M>& P)
+    {
+        if (Length + P.Length() > (long)(2 * N)) return false;
+        for (long i = 0; i < P.Length(); i++) Bytes[Length++] = P.Bytes[i];
+        return true;
+    }
+};
+
+// Soft reset of the DDC: pulse DDC_RESETN
+constexpr auto EVM_SEQ_RESET_DDC = EVM_MakePacket({
+    EVM_NOP, EVM_NOP,
+    { EVM_REG_DDC_RESETN, 0xFF }, { EVM_REG_DDC_RESETN, 0xFF },
+    { EVM_REG_DDC_RESETN, 0x00 }, { EVM_REG_DDC_RESETN, 0x00 },
+    { EVM_REG_DDC_RESETN, 0x00 }, { EVM_REG_DDC_RESETN, 0x00 },
+    { EVM_REG_DDC_RESETN, 0xFF }, { EVM_REG_DDC_RESETN, 0xFF },
+    { EVM_REG_DDC_RESETN, 0xFF }, { EVM_REG_DDC_RESETN, 0xFF } });
+
+// Makes sure the CFG state machine is reset
+constexpr auto EVM_SEQ_CLEAR_TRIGGERS = EVM_MakePacket({
+    EVM_NOP, EVM_NOP, EVM_NOP,
+    { EVM_REG_TRIGGER, 0x00 }, { EVM_REG_TRIGGER, 0x00 },
+    { EVM_REG_RESERVED_D1, 0x00 } });
+
+// Loads the DDC configuration word and shifts it into the DDC
+constexpr EVM_Packet<11> EVM_SeqDataSequence(unsigned char CFGHIGH, unsigned char CFGLOW)
+{
+    return EVM_MakePacket({
+        EVM_NOP, EVM_NOP, EVM_NOP,
+        { EVM_REG_CLK_CFG, 0x00 }, { EVM_REG_DIN_CFG, 0x00 },
+        { EVM_REG_DDC_CFGHIGH, CFGHIGH }, { EVM_REG_DDC_CFGLOW, CFGLOW },
+        { EVM_REG_FORMAT_DIN_CFG, 0x01 },
+        EVM_NOP, EVM_NOP,
+        { EVM_REG_TRIGGER, 0x00 } });
+}
+
+constexpr auto EVM_SEQ_STOP_CONVERSIONS = EVM_MakePacket({ { EVM_REG_CONVERSIONS, 0x00 } });
+constexpr auto EVM_SEQ_START_CONVERSIONS = EVM_MakePacket({ { EVM_REG_CONVERSIONS, 0xFF } });
+constexpr auto EVM_SEQ_NOP = EVM_MakePacket({ EVM_NOP });
+
+// D0 is the opcode to start/stop reading the FPGA registers
+constexpr auto EVM_SEQ_READ_REGS_START = EVM_MakePacket({ { EVM_REG_READ_OUT_TRIGGER, 0x01 } });
+constexpr auto EVM_SEQ_READ_REGS_STOP = EVM_MakePacket({ { EVM_REG_READ_OUT_TRIGGER, 0x00 } });
+
+// Stops reading the registers, then resets CONV with 5600 and 5601
+constexpr auto EVM_SEQ_RESET_CONV = EVM_MakePacket({
+    { EVM_REG_READ_OUT_TRIGGER, 0x00 }, EVM_NOP,
+    { EVM_REG_RESET_CONV, 0x00 }, EVM_NOP,
+    { EVM_REG_RESET_CONV, 0x01 } });
+
+// CONV reset followed by 0x1000 0x0000, leaves the board configured and stopped
+constexpr auto EVM_SEQ_RESET_CONV_AND_STOP = EVM_Concat(EVM_SEQ_RESET_CONV, EVM_Concat(EVM_SEQ_STOP_CONVERSIONS, EVM_SEQ_NOP));
+
+#endif // EVM_REGISTERS_H
@@ -0,0 +1,368 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ */
+
+#include "StdAfx.h"
+#include "DDC264EVM_IO.h"
+#include "EVM_Registers.h"
+#include "EVM_Server.h"
+
+#include <ws2tcpip.h>
+#include <cstring>
+
+// Clients and subscribers each, well within the 64 sockets a select takes
+static const int MAX_CLIENTS = 16;
+
+static const int SEND_BUFFER_BYTES = 1 << 20;
+
+static bool NonBlocking(SOCKET s)
+{
+    u_long On = 1;
+    return ioctlsocket(s, FIONBIO, &On) == 0;
+}
+
+static bool IsLoopback(const sockaddr_in& a)
+{
+    return (ntohl(a.sin_addr.s_addr) >> 24) == 127;
+}
+
+static bool SameAddress(const sockaddr_in& a, const sockaddr_in& b)
+{
+    return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+}
+
+EVM_Server::EVM_Server() : Flags(0), QueueBlocks(0), Started(false), Listener(INVALID_SOCKET), Datagram(INVALID_SOCKET),
+    WakeIn(INVALID_SOCKET), WakeOut(INVALID_SOCKET), Exit(false), Sequence(0), Blocks(0), BytesSent(0), Skipped(0), Dropped(0), QueueMax(0)
+{
+    memset(&WakeAddress, 0, sizeof(WakeAddress));
+}
+
+EVM_Server::~EVM_Server()
+{
+    Stop();
+}
+
+long EVM_Server::Start(int Port, int Flags, int QueueBlocks)
+{
+    if (Port <= 0 || Port > 65535 || QueueBlocks < 1) return(-7);
+    if ((Flags & ~(EVM_SERVE_TCP | EVM_SERVE_UDP | EVM_SERVE_DROP_SLOW | EVM_SERVE_PUBLISH | EVM_SERVE_REMOTE)) != 0) return(-7);
+    if ((Flags & (EVM_SERVE_TCP | EVM_SERVE_UDP)) == 0) return(-7);
+
+    Stop();
+    WSADATA Wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &Wsa) != 0) return(-18);
+    Started = true;
+
+    sockaddr_in Address;
+    memset(&Address, 0, sizeof(Address));
+    Address.sin_family = AF_INET;
+    Address.sin_addr.s_addr = htonl((Flags & EVM_SERVE_REMOTE) ? INADDR_ANY : INADDR_LOOPBACK);
+    Address.sin_port = htons((u_short)Port);
+    int SendBuffer = SEND_BUFFER_BYTES;
+
+    bool Ok = true;
+    if (Flags & EVM_SERVE_TCP)
+    {
+        Listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        Ok = Listener != INVALID_SOCKET && bind(Listener, (sockaddr*)&Address, sizeof(Address)) == 0 &&
+             listen(Listener, SOMAXCONN) == 0 && NonBlocking(Listener);
+    }
+    if (Ok && (Flags & EVM_SERVE_UDP))
+    {
+        Datagram = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        Ok = Datagram != INVALID_SOCKET && bind(Datagram, (sockaddr*)&Address, sizeof(Address)) == 0 && NonBlocking(Datagram);
+        if (Ok) setsockopt(Datagram, SOL_SOCKET, SO_SNDBUF, (const char*)&SendBuffer, sizeof(SendBuffer));
+    }
+
+    // The thread waits on the sockets, a datagram to itself wakes it when there is something to send
+    if (Ok)
+    {
+        WakeAddress.sin_family = AF_INET;
+        WakeAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        WakeAddress.sin_port = 0;
+        int Length = sizeof(WakeAddress);
+        WakeIn = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        WakeOut = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        Ok = WakeIn != INVALID_SOCKET && WakeOut != INVALID_SOCKET && bind(WakeIn, (sockaddr*)&WakeAddress, sizeof(WakeAddress)) == 0 &&
+             getsockname(WakeIn, (sockaddr*)&WakeAddress, &Length) == 0 && NonBlocking(WakeIn) && NonBlocking(WakeOut);
+    }
+    if (!Ok)
+    {
+        Close();
+        return(-18);
+    }
+
+    this->Flags = Flags;
+    this->QueueBlocks = QueueBlocks;
+    Current.reset();
+    Sequence = 0;
+    Blocks = BytesSent = Skipped = 0;
+    Dropped = 0;
+    QueueMax = 0;
+    Exit = false;
+    Thread = std::thread(&EVM_Server::Loop, this);
+    return(0);
+}
+
+void EVM_Server::Stop()
+{
+    if (Thread.joinable())
+    {
+        Exit = true;
+        Wake();
+        Thread.join();
+    }
+    Close();
+}
+
+void EVM_Server::Close()
+{
+    for (auto& C : Clients) closesocket(C->Socket);
+    Clients.clear();
+    Subscribers.clear();
+    DatagramQueue.clear();
+    SOCKET* Sockets[] = { &Listener, &Datagram, &WakeIn, &WakeOut };
+    for (SOCKET* s : Sockets)
+    {
+        if (*s != INVALID_SOCKET) closesocket(*s);
+        *s = INVALID_SOCKET;
+    }
+    if (Started) WSACleanup();
+    Started = false;
+}
+
+// Frames a message and sends it: the copy of the block every client shares
+void EVM_Server::Post(int Kind, const EVM_BlockInfo& Info, int Width, const void* Data, size_t Bytes)
+{
+    std::shared_ptr<std::vector<unsigned char>> M = std::make_shared<std::vector<unsigned char>>(sizeof(EVM_ServeFrame) + Bytes);
+    EVM_ServeFrame* F = (EVM_ServeFrame*)M->data();
+    F->Magic = EVM_SERVE_MAGIC;
+    F->Bytes = (unsigned int)Bytes;
+    F->Kind = Kind;
+    F->Width = Width;
+    F->Info = Info;
+    if (Bytes > 0) memcpy(F + 1, Data, Bytes);
+
+    {
+        std::lock_guard<std::mutex> L(Lock);
+        F->Sequence = Sequence++;
+        if (Kind == EVM_SERVE_HELLO) Current = M;
+        Queue(M, Kind == EVM_SERVE_BLOCK);
+    }
+    Wake();
+}
+
+void EVM_Server::Hello(const EVM_RecordHeader& Header, const unsigned char* Regs)
+{
+    unsigned char Data[sizeof(EVM_RecordHeader) + EVM_REG_COUNT];
+    memcpy(Data, &Header, sizeof(Header));
+    memcpy(Data + sizeof(Header), Regs, EVM_REG_COUNT);
+
+    EVM_BlockInfo Info;
+    memset(&Info, 0, sizeof(Info));
+    Post(EVM_SERVE_HELLO, Info, 0, Data, sizeof(Data));
+}
+
+void EVM_Server::Send(const EVM_BlockInfo& Info, const void* Data, size_t Bytes, int Width)
+{
+    Post(EVM_SERVE_BLOCK, Info, Width, Data, Bytes);
+}
+
+void EVM_Server::End(long Status)
+{
+    EVM_BlockInfo Info;
+    memset(&Info, 0, sizeof(Info));
+    Info.Status = Status;
+    Post(EVM_SERVE_END, Info, 0, nullptr, 0);
+}
+
+// Queues M for every client, under Lock. A block is skipped by the clients that are too far behind.
+void EVM_Server::Queue(const Message& M, bool Skippable)
+{
+    if (Skippable) Blocks++;
+    for (auto& C : Clients)
+    {
+        if (Skippable && C->Queue.size() >= QueueBlocks)
+        {
+            if (Flags & EVM_SERVE_DROP_SLOW) C->Drop = true;
+            else Skipped++;
+            continue;
+        }
+        C->Queue.push_back(M);
+        QueueMax = max(QueueMax, C->Queue.size());
+    }
+    if (!Subscribers.empty())
+    {
+        if (Skippable && DatagramQueue.size() >= QueueBlocks) Skipped++;
+        else DatagramQueue.push_back(M);
+    }
+}
+
+void EVM_Server::Wake()
+{
+    char Byte = 0;
+    sendto(WakeOut, &Byte, 1, 0, (const sockaddr*)&WakeAddress, sizeof(WakeAddress));
+}
+
+void EVM_Server::Loop()
+{
+    char Scratch[256];
+    while (!Exit)
+    {
+        fd_set Readable, Writable;
+        FD_ZERO(&Readable);
+        FD_ZERO(&Writable);
+        FD_SET(WakeIn, &Readable);
+        if (Listener != INVALID_SOCKET) FD_SET(Listener, &Readable);
+        if (Datagram != INVALID_SOCKET) FD_SET(Datagram, &Readable);
+        {
+            std::lock_guard<std::mutex> L(Lock);
+            for (auto& C : Clients)
+            {
+                // Clients send nothing, a readable socket is one being closed
+                FD_SET(C->Socket, &Readable);
+                if (!C->Queue.empty()) FD_SET(C->Socket, &Writable);
+            }
+        }
+        if (select(0, &Readable, &Writable, nullptr, nullptr) == SOCKET_ERROR) continue;
+        if (Exit) break;
+        if (FD_ISSET(WakeIn, &Readable))
+        {
+            while (recv(WakeIn, Scratch, sizeof(Scratch), 0) > 0) {}
+        }
+
+        std::lock_guard<std::mutex> L(Lock);
+        if (Listener != INVALID_SOCKET && FD_ISSET(Listener, &Readable)) Accept();
+        if (Datagram != INVALID_SOCKET && FD_ISSET(Datagram, &Readable)) Subscribe();
+        for (size_t i = 0; i < Clients.size();)
+        {
+            Client& C = *Clients[i];
+            bool Ok = !C.Drop;
+            if (Ok && FD_ISSET(C.Socket, &Readable))
+            {
+                int n = recv(C.Socket, Scratch, sizeof(Scratch), 0);
+                Ok = n > 0 || (n == SOCKET_ERROR && WSAGetLastError() == WSAEWOULDBLOCK);
+            }
+            if (Ok && FD_ISSET(C.Socket, &Writable)) Ok = Flush(C);
+            if (Ok)
+            {
+                i++;
+                continue;
+            }
+            if (C.Drop) Dropped++;
+            closesocket(C.Socket);
+            Clients.erase(Clients.begin() + i);
+        }
+        while (!DatagramQueue.empty())
+        {
+            SendDatagrams(DatagramQueue.front());
+            DatagramQueue.pop_front();
+        }
+    }
+}
+
+void EVM_Server::Accept()
+{
+    SOCKET s = accept(Listener, nullptr, nullptr);
+    if (s == INVALID_SOCKET) return;
+    if ((int)Clients.size() >= MAX_CLIENTS || !NonBlocking(s))
+    {
+        closesocket(s);
+        return;
+    }
+    int On = 1, SendBuffer = SEND_BUFFER_BYTES;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&On, sizeof(On));
+    setsockopt(s, SOL_SOCKET, SO_SNDBUF, (const char*)&SendBuffer, sizeof(SendBuffer));
+
+    std::unique_ptr<Client> C(new Client);
+    C->Socket = s;
+    C->Sent = 0;
+    C->Drop = false;
+    if (Current) C->Queue.push_back(Current);
+    Clients.push_back(std::move(C));
+}
+
+// A datagram with first byte 1 subscribes its sender, 0 removes it. Without EVM_SERVE_REMOTE only a sender of
+// this machine is served, whatever reaches the socket.
+void EVM_Server::Subscribe()
+{
+    unsigned char Request[16];
+    sockaddr_in From;
+    int Length = sizeof(From);
+    int n;
+    while ((n = recvfrom(Datagram, (char*)Request, sizeof(Request), 0, (sockaddr*)&From, &Length)) != SOCKET_ERROR)
+    {
+        Length = sizeof(From);
+        if (!(Flags & EVM_SERVE_REMOTE) && !IsLoopback(From)) continue;
+        size_t i = 0;
+        while (i < Subscribers.size() && !SameAddress(Subscribers[i], From)) i++;
+        if (n > 0 && Request[0] == 1 && i == Subscribers.size() && (int)Subscribers.size() < MAX_CLIENTS)
+        {
+            Subscribers.push_back(From);
+            if (Current) DatagramQueue.push_back(Current);
+        }
+        else if (n > 0 && Request[0] == 0 && i < Subscribers.size()) Subscribers.erase(Subscribers.begin() + i);
+    }
+}
+
+// Sends what the socket takes of the queue of C. Returns false if the client is gone.
+bool EVM_Server::Flush(Client& C)
+{
+    while (!C.Queue.empty())
+    {
+        const std::vector<unsigned char>& M = *C.Queue.front();
+        int n = send(C.Socket, (const char*)M.data() + C.Sent, (int)(M.size() - C.Sent), 0);
+        if (n == SOCKET_ERROR) return WSAGetLastError() == WSAEWOULDBLOCK;
+        C.Sent += n;
+        BytesSent += n;
+        if (C.Sent < M.size()) return true;
+        C.Queue.pop_front();
+        C.Sent = 0;
+    }
+    return true;
+}
+
+// Sends M to every subscriber in parts, the header and the part gathered from where they are
+void EVM_Server::SendDatagrams(const Message& M)
+{
+    EVM_ServeDatagram Head;
+    Head.Magic = EVM_SERVE_DATAGRAM_MAGIC;
+    Head.Bytes = (unsigned int)M->size();
+    Head.Reserved = 0;
+    Head.Sequence = ((const EVM_ServeFrame*)M->data())->Sequence;
+
+    for (const sockaddr_in& To : Subscribers)
+    {
+        for (size_t Offset = 0; Offset < M->size(); Offset += EVM_SERVE_DATAGRAM_BYTES)
+        {
+            Head.Offset = (unsigned int)Offset;
+            WSABUF Parts[2];
+            Parts[0].buf = (char*)&Head;
+            Parts[0].len = sizeof(Head);
+            Parts[1].buf = (char*)M->data() + Offset;
+            Parts[1].len = (ULONG)min(M->size() - Offset, (size_t)EVM_SERVE_DATAGRAM_BYTES);
+            DWORD Sent = 0;
+            // Datagrams are lost if the socket is full: a client sees a message with parts missing
+            if (WSASendTo(Datagram, Parts, 2, &Sent, 0, (const sockaddr*)&To, sizeof(To), nullptr, nullptr) == SOCKET_ERROR) break;
+        }
+    }
+}
+
+void EVM_Server::GetStats(EVM_ServeStats* Stats)
+{
+    std::lock_guard<std::mutex> L(Lock);
+    Stats->Blocks = Blocks;
+    Stats->Bytes = BytesSent;
+    Stats->Skipped = Skipped;
+    Stats->Clients = (int)Clients.size();
+    Stats->Subscribers = (int)Subscribers.size();
+    Stats->Dropped = Dropped;
+    Stats->QueueMax = (int)QueueMax;
+}
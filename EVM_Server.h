@@ -0,0 +1,97 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ *
+ * Fan-out of a stream to other processes. Each block is framed once into a shared message
+ * and every client queue holds a reference to it; one thread sends the queues over
+ * non-blocking sockets as the clients take them. A client whose queue is full skips the
+ * block, or is disconnected, so a slow one never holds back the stream.
+ */
+
+#ifndef EVM_SERVER_H
+#define EVM_SERVER_H
+
+#include <winsock2.h>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class EVM_Server
+{
+public:
+    EVM_Server();
+    ~EVM_Server();
+
+    // Listens on Port, over TCP and/or UDP as Flags says, on the loopback interface unless EVM_SERVE_REMOTE.
+    // Returns 0, -7 or -18 if the port can't be opened.
+    long Start(int Port, int Flags, int QueueBlocks);
+    void Stop();
+    bool IsOn() const { return Thread.joinable(); }
+
+    // Describes the stream to every client, and to the ones connecting later
+    void Hello(const EVM_RecordHeader& Header, const unsigned char* Regs);
+    void Send(const EVM_BlockInfo& Info, const void* Data, size_t Bytes, int Width);
+    void End(long Status);
+
+    void GetStats(EVM_ServeStats* Stats);
+
+private:
+    EVM_Server(const EVM_Server&);
+    EVM_Server& operator=(const EVM_Server&);
+
+    typedef std::shared_ptr<const std::vector<unsigned char>> Message;
+
+    struct Client
+    {
+        SOCKET Socket;
+        std::deque<Message> Queue;
+        size_t Sent;          // Of the message at the front
+        bool Drop;
+    };
+
+    void Post(int Kind, const EVM_BlockInfo& Info, int Width, const void* Data, size_t Bytes);
+    void Queue(const Message& M, bool Skippable);
+    void Wake();
+    void Loop();
+    void Accept();
+    void Subscribe();
+    bool Flush(Client& C);
+    void SendDatagrams(const Message& M);
+    void Close();
+
+    int Flags;
+    size_t QueueBlocks;
+    bool Started;           // Winsock
+    SOCKET Listener;
+    SOCKET Datagram;
+    SOCKET WakeIn;          // Loopback socket the thread also waits on
+    SOCKET WakeOut;
+    sockaddr_in WakeAddress;
+    std::thread Thread;
+    std::atomic<bool> Exit;
+
+    // Guarded by Lock
+    std::mutex Lock;
+    std::vector<std::unique_ptr<Client>> Clients;
+    std::vector<sockaddr_in> Subscribers;
+    std::deque<Message> DatagramQueue;
+    Message Current;        // Hello of the stream
+    long long Sequence;
+    long long Blocks;
+    long long BytesSent;
+    long long Skipped;
+    int Dropped;
+    size_t QueueMax;
+};
+
+#endif // EVM_SERVER_H
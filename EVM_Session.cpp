@@ -0,0 +1,1088 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ */
+
+#include "StdAfx.h"
+#include "CyApi.h"
+#include "DDC264EVM_IO.h"
+#include "EVM_Registers.h"
+#include "EVM_Internal.h"
+#include "EVM_Decode.h"
+#include "EVM_Filter.h"
+#include "EVM_Queue.h"
+#include "EVM_Memory.h"
+#include "EVM_Spectrum.h"
+#include "EVM_Events.h"
+#include "EVM_Timing.h"
+#include "EVM_Recorder.h"
+#include "EVM_Server.h"
+#include "EVM_Shared.h"
+#include "EVM_Board.h"
+#include "EVM_Trace.h"
+#include "EVM_Session.h"
+
+#include <algorithm>
+#include <cstring>
+
+EVM_Session::EVM_Session(int USBdev) :
+    USBdev(USBdev), Board(&EVM_GetBoard(USBdev)), Channels(0), nDVALIDReads(0), nFrames(0), BytesOfData(0),
+    SampleType(EVM_SAMPLE_INT32), CFGHIGH(0), Conv(EVM_RawConversion()), nWorkers(1), nTransfers(0), TransferCount(0), MemoryFlags(0), ReaderPriority(EVM_PRIORITY_NORMAL), ReaderCore(-1), RoiImage(false),
+    PsdLength(0), PsdRate(0), PsdGain(1), PsdFrame(-1), TimingFrame(-1), RecordFlags(0), RecordDepth(4), RecordChunk(4 << 20), RecordError(0), ServeFlags(0), ShareFlags(0),
+    WholeRows(false), CarryWords(0), SlotBytes(0), WorkersExit(false), Issued(0), NextCommit(0), BlockSequence(0),
+    nTransfersRead(0), nBlocks(0), TransferWaits(0), SlotWaits(0), ReadyHighWater(0),
+    StopRequest(false), Running(false), Error(0)
+{
+    memset(ServeRegs, 0, sizeof(ServeRegs));
+}
+
+EVM_Session::~EVM_Session()
+{
+    Stop();
+    if (USBDevice) USBDevice->Close();
+}
+
+bool EVM_Session::Open()
+{
+    USBDevice.reset(new CCyUSBDevice(NULL));
+    if (!EVM_OpenDevice(USBDevice.get(), USBdev)) return false;
+    return (USBDevice->BulkInEndPt != nullptr && USBDevice->BulkOutEndPt != nullptr);
+}
+
+long EVM_Session::SetSampleType(int SampleType, byte CFGHIGH)
+{
+    if (EVM_SampleSize(SampleType) == 0) return(-7);
+    if ((SampleType & EVM_SAMPLE_TYPE_MASK) == EVM_SAMPLE_UINT16 && EVM_CFG_FORMAT::Get(CFGHIGH) != 0) return(-7);
+
+    std::lock_guard<std::mutex> L(Lock);
+    if (Running) return(-14);
+    this->SampleType = SampleType;
+    this->CFGHIGH = CFGHIGH;
+    return(0);
+}
+
+long EVM_Session::SetFilter(int Mode, int Order, int nGroups, const int* GroupChannels, const int* Factors)
+{
+    std::lock_guard<std::mutex> L(Lock);
+    if (Running) return(-14);
+    return Filter.Setup(Mode, Order, nGroups, GroupChannels, Factors) ? 0 : -7;
+}
+
+long EVM_Session::SetPSD(int SegmentLength, double DVALIDRate)
+{
+    if (SegmentLength != 0 && DVALIDRate <= 0) return(-7);
+
+    std::lock_guard<std::mutex> L(Lock);
+    if (Running) return(-14);
+    // Only checks the length here, the estimators are sized by Start
+    EVM_Welch Check;
+    if (!Check.Setup(1, SegmentLength, 0)) return(-7);
+    PsdLength = SegmentLength;
+    PsdRate = DVALIDRate;
+    return(0);
+}
+
+long EVM_Session::GetPSD(double* PSD)
+{
+    std::lock_guard<std::mutex> L(Lock);
+    if (!Spectrum[0].Active() || Channels <= 0) return(-7);
+
+    const size_t SideBins = (size_t)Channels * (PsdLength / 2 + 1);
+    long A = Spectrum[0].Get(PSD, PsdRate / 2, PsdGain);
+    long B = Spectrum[1].Get(PSD + SideBins, PsdRate / 2, PsdGain);
+    return min(A, B);
+}
+
+// Returns the frame described
+long EVM_Session::GetTiming(EVM_Timing* Timing)
+{
+    std::lock_guard<std::mutex> G(TimingLock);
+    this->Timing.Get(Timing);
+    return(TimingFrame);
+}
+
+// Returns the bytes of a record
+long EVM_Session::SetEvents(int nThresholds, const int* Thresholds, int Hysteresis, int PreSamples, int PostSamples, int BaselineShift)
+{
+    std::lock_guard<std::mutex> L(Lock);
+    if (Running) return(-14);
+    if (!Events.Setup(nThresholds, Thresholds, Hysteresis, PreSamples, PostSamples, BaselineShift)) return(-7);
+    return Events.Active() ? Events.RecordBytes() : 0;
+}
+
+long EVM_Session::SetRecord(const char* Path, int Flags, int QueueDepth, int ChunkKB)
+{
+    if ((Flags & ~EVM_RECORD_PUBLISH) != 0 || QueueDepth < 0 || QueueDepth == 1 || QueueDepth > 64) return(-7);
+    if (ChunkKB < 0 || ChunkKB % (EVM_RECORD_ALIGN / 1024) != 0 || ChunkKB > 256 * 1024) return(-7);
+
+    std::lock_guard<std::mutex> L(Lock);
+    if (Running) return(-14);
+    RecordPath = (Path != nullptr) ? Path : "";
+    RecordFlags = Flags;
+    RecordDepth = (QueueDepth > 0) ? QueueDepth : 4;
+    RecordChunk = (ChunkKB > 0) ? (size_t)ChunkKB * 1024 : 4 << 20;
+    return(0);
+}
+
+void EVM_Session::GetRecordStats(EVM_RecordStats* Stats)
+{
+    Recorder.GetStats(Stats);
+}
+
+long EVM_Session::SetServe(int Port, int Flags, int QueueBlocks, const int* Regs)
+{
+    if (Port < 0 || QueueBlocks < 0) return(-7);
+
+    std::lock_guard<std::mutex> L(Lock);
+    if (Running) return(-14);
+    Server.Stop();
+    ServeFlags = 0;
+    if (Port == 0) return(0);
+
+    if (Regs != nullptr)
+    {
+        for (int i = 0; i < EVM_REG_COUNT; i++) ServeRegs[i] = (unsigned char)Regs[i];
+    }
+    else Board->Registers(ServeRegs);
+    long Result = Server.Start(Port, Flags, (QueueBlocks > 0) ? QueueBlocks : 64);
+    if (Result == 0) ServeFlags = Flags;
+    return(Result);
+}
+
+void EVM_Session::GetServeStats(EVM_ServeStats* Stats)
+{
+    Server.GetStats(Stats);
+}
+
+long EVM_Session::SetShare(const char* Name, int Slots, int SlotKB, int Flags)
+{
+    if ((Flags & ~EVM_SHARE_PUBLISH) != 0 || Slots < 0 || Slots == 1 || SlotKB < 0 || SlotKB > 64 * 1024) return(-7);
+
+    std::lock_guard<std::mutex> L(Lock);
+    if (Running) return(-14);
+    Shared.Close();
+    ShareFlags = 0;
+    if (Name == nullptr) return(0);
+
+    // By default room for the largest dense block, doubles with a carried row
+    size_t Bytes = (SlotKB > 0) ? (size_t)SlotKB * 1024 : (STRINGLEN / 4 + MAX_CHANNELS_FAST) * sizeof(double);
+    long Result = Shared.Create(Name, (Slots > 0) ? Slots : 64, Bytes);
+    if (Result == 0) ShareFlags = Flags;
+    return(Result);
+}
+
+long EVM_Session::SetROI(int nSelected, const int* ChannelList)
+{
+    if (nSelected < 0 || (nSelected > 0 && ChannelList == nullptr)) return(-7);
+
+    std::lock_guard<std::mutex> L(Lock);
+    if (Running) return(-14);
+    RoiList.assign(ChannelList, ChannelList + nSelected);
+    RoiImage = false;
+    return(0);
+}
+
+long EVM_Session::SetImage(int Width, int Height, const int* Gather)
+{
+    if (Width < 0 || Height < 0 || (Width * Height > 0 && Gather == nullptr)) return(-7);
+
+    std::lock_guard<std::mutex> L(Lock);
+    if (Running) return(-14);
+    RoiList.assign(Gather, Gather + Width * Height);
+    RoiImage = true;
+    return(0);
+}
+
+long EVM_Session::SetPipeline(int nWorkers, int nTransfers)
+{
+    if (nWorkers < 1 || nWorkers > 64 || nTransfers < 0 || (nTransfers > 0 && nTransfers < 2)) return(-7);
+
+    std::lock_guard<std::mutex> L(Lock);
+    if (Running) return(-14);
+    this->nWorkers = nWorkers;
+    this->nTransfers = nTransfers;
+    return(0);
+}
+
+long EVM_Session::SetMemory(int Flags)
+{
+    if ((Flags & ~(EVM_MEM_LOCK | EVM_MEM_LARGE_PAGES)) != 0) return(-7);
+
+    std::lock_guard<std::mutex> L(Lock);
+    if (Running) return(-14);
+    MemoryFlags = Flags;
+    SlotMemory.Free();
+    TransferMemory.Free();
+
+    // Allocate now so the caller learns what was honoured
+    if (!Reserve(SlotMemory, STRINGLEN * 4) || !Reserve(TransferMemory, STRINGLEN * 4)) return(-3);
+    long Missing = 0;
+    if ((Flags & EVM_MEM_LARGE_PAGES) && !SlotMemory.LargePages()) Missing |= EVM_MEM_LARGE_PAGES;
+    if ((Flags & EVM_MEM_LOCK) && !SlotMemory.IsLocked()) Missing |= EVM_MEM_LOCK;
+    return(Missing);
+}
+
+long EVM_Session::SetReaderPriority(int Priority, int Core)
+{
+    if (Priority < EVM_PRIORITY_NORMAL || Priority > EVM_PRIORITY_REALTIME || Core < -1 || Core >= 64) return(-7);
+
+    std::lock_guard<std::mutex> L(Lock);
+    if (Running) return(-14);
+    ReaderPriority = Priority;
+    ReaderCore = Core;
+    return(0);
+}
+
+// Makes Block hold at least Bytes, keeping it if it already does
+bool EVM_Session::Reserve(EVM_PageBlock& Block, size_t Bytes)
+{
+    if (Block.Data() != nullptr && Block.Bytes() >= Bytes) return true;
+    return Block.Allocate(Bytes, MemoryFlags);
+}
+
+long EVM_Session::Start(int Channels, int nDVALIDReads, int nFrames, int nBuffers)
+{
+    if (Channels <= 0 || nDVALIDReads <= 0 || nFrames < 0 || nBuffers < 2) return(-7);
+
+    std::lock_guard<std::mutex> L(Lock);
+    if (Running) return(-14);
+    if (Reader.joinable()) Reader.join();
+
+    Conv = (SampleType == EVM_SAMPLE_INT32) ? EVM_RawConversion() : EVM_MakeConversion(SampleType, CFGHIGH, Channels);
+    Conv.Channels = Channels;
+    if (!RoiList.empty() && !Filter.Active() && !Events.Active())
+    {
+        bool Valid = RoiImage ? EVM_MakeImageRoi(Roi, Channels, (int)RoiList.size(), RoiList.data())
+                              : EVM_MakeRoi(Roi, Channels, (int)RoiList.size(), RoiList.data());
+        if (!Valid) return(-7);
+        EVM_ApplyRoi(Conv, &Roi);
+    }
+    if (Conv.Fn == nullptr) return(-7);
+    if (Filter.Active() && Filter.UsedChannels() > Channels) return(-7);
+    if (Events.Active() && (Filter.Active() || !Events.Start(Channels))) return(-7);
+
+    this->Channels = Channels;
+    this->nDVALIDReads = nDVALIDReads;
+    this->nFrames = nFrames;
+    BytesOfData = Channels * nDVALIDReads * 4;
+
+    // Noise spectra of both sides, in pC when the stream is, in codes otherwise
+    int PsdMask = 0xFFFFFF;
+    PsdGain = 1.0;
+    if (Conv.SampleType == EVM_SAMPLE_FLOAT32 || Conv.SampleType == EVM_SAMPLE_FLOAT64) EVM_PsdScale(&CFGHIGH, Channels, PsdMask, PsdGain);
+    for (int s = 0; s < 2; s++) Spectrum[s].Setup(Channels, PsdLength, PsdMask);
+    PsdFrame = -1;
+    {
+        std::lock_guard<std::mutex> G(TimingLock);
+        Timing.Reset(Channels);
+        TimingFrame = -1;
+    }
+
+    // A block can also hold the row completed with the words carried from the previous transfer. Blocks are
+    // always whole rows: a channel major block is laid out by rows, and the (channel, DVALID) views of the
+    // Python binding and the recording index take them by rows in either layout.
+    WholeRows = true;
+    Carry.resize(Channels * 4);
+    CarryWords = 0;
+    long SlotSamples = STRINGLEN / 4 + (WholeRows ? Channels : 0);
+    if (Filter.Active())
+    {
+        Filter.Reset();
+        FilterOut.resize(SlotSamples + Channels);
+    }
+
+    // All the memory of the stream comes from two page blocks, kept from one stream to the next when the
+    // sizes don't change: nothing is allocated or faulted in once the reader runs
+    SlotBytes = (SlotSamples * EVM_SampleSize(Conv.SampleType) + 63) & ~(size_t)63;
+    if (Events.Active()) SlotBytes = max(SlotBytes, ((size_t)Events.RecordBytes() + 63) & ~(size_t)63);
+    if (Shared.IsOpen() && SlotBytes > Shared.SlotBytes()) return(-7);
+    if (!Reserve(SlotMemory, SlotBytes * nBuffers)) return(-3);
+    Slots.resize(nBuffers);
+    for (int i = 0; i < nBuffers; i++)
+    {
+        Slots[i].Data = SlotMemory.Data() + i * SlotBytes;
+        Slots[i].State = SLOT_FREE;
+    }
+    ReadyQueue.clear();
+
+    // Transfer buffers: enough for every worker to be busy while the reader fills the next ones
+    TransferCount = (nTransfers > 0) ? nTransfers : 2 * nWorkers + 2;
+    size_t RawBytes = (Channels * 4 + STRINGLEN + 63) & ~(size_t)63;
+    size_t CodeBytes = (Filter.Active() || PsdLength > 0 || Events.Active()) ? ((SlotSamples * sizeof(int) + 63) & ~(size_t)63) : 0;
+    if (!Reserve(TransferMemory, (RawBytes + CodeBytes) * TransferCount)) return(-3);
+
+    // From here the board belongs to the stream, the exports only queue control writes for it
+    if (Board->BeginStream() != 0) return(-14);
+    RecordError = 0;
+    if (!RecordPath.empty())
+    {
+        long Result = Recorder.Open(RecordPath.c_str(), RecordDepth, RecordChunk, MemoryFlags, Describe());
+        if (Result != 0)
+        {
+            Board->EndStream(USBDevice.get());
+            return(Result);
+        }
+    }
+    if (Server.IsOn()) Server.Hello(Describe(), ServeRegs);
+    if (Shared.IsOpen()) Shared.Begin(Describe());
+
+    Transfers.reset(new Transfer[TransferCount]);
+    InFlight.reset(new int[TransferCount]);
+    FreeTransfers.Reset(TransferCount);
+    DecodeQueue.Reset(TransferCount);
+    for (int t = 0; t < TransferCount; t++)
+    {
+        Transfers[t].Data = TransferMemory.Data() + t * (RawBytes + CodeBytes);
+        Transfers[t].Codes = (CodeBytes > 0) ? (int*)(Transfers[t].Data + RawBytes) : nullptr;
+        FreeTransfers.TryPush(t);
+    }
+    Issued = 0;
+    NextCommit = 0;
+    BlockSequence = 0;
+    nTransfersRead = 0;
+    nBlocks = 0;
+    TransferWaits = 0;
+    SlotWaits = 0;
+    ReadyHighWater = 0;
+
+    StopRequest = false;
+    WorkersExit = false;
+    Running = true;
+    Error = 0;
+    Workers.clear();
+    for (int w = 0; w < nWorkers; w++) Workers.push_back(std::thread(&EVM_Session::WorkerLoop, this));
+    Reader = std::thread(&EVM_Session::ReaderLoop, this);
+    return(0);
+}
+
+long EVM_Session::Stop()
+{
+    StopRequest = true;
+    {
+        // A pending read only returns on timeout, abort it until the reader is out
+        std::unique_lock<std::mutex> L(Lock);
+        SlotFreed.notify_all();
+        while (Running)
+        {
+            L.unlock();
+            {
+                std::lock_guard<std::mutex> P(PipeLock);
+                TransferFreed.notify_all();
+            }
+            L.lock();
+            USBDevice->BulkInEndPt->Abort();
+            BlockReady.wait_for(L, std::chrono::milliseconds(20));
+        }
+    }
+    if (Reader.joinable()) Reader.join();
+    return(Error);
+}
+
+long EVM_Session::Acquire(int TimeoutMs, void** Data, int* Samples, EVM_BlockInfo* Info)
+{
+    std::unique_lock<std::mutex> L(Lock);
+    auto Available = [this] { return !ReadyQueue.empty() || !Running; };
+
+    if (TimeoutMs < 0) BlockReady.wait(L, Available);
+    else if (!BlockReady.wait_for(L, std::chrono::milliseconds(TimeoutMs), Available)) return(-4);
+
+    if (ReadyQueue.empty()) return (Error != 0) ? Error : -13;
+
+    int Index = ReadyQueue.front();
+    ReadyQueue.pop_front();
+    Slot& S = Slots[Index];
+    S.State = SLOT_ACQUIRED;
+    if (Data != nullptr) *Data = S.Data;
+    if (Samples != nullptr) *Samples = S.Info.Samples;
+    if (Info != nullptr) *Info = S.Info;
+    return(Index);
+}
+
+long EVM_Session::Release(int Index)
+{
+    std::lock_guard<std::mutex> L(Lock);
+    if (Index < 0 || Index >= (int)Slots.size() || Slots[Index].State != SLOT_ACQUIRED) return(-15);
+    Slots[Index].State = SLOT_FREE;
+    SlotFreed.notify_one();
+    return(0);
+}
+
+void EVM_Session::GetStats(EVM_StreamStats* Stats)
+{
+    Stats->Transfers = nTransfersRead;
+    Stats->Blocks = nBlocks;
+    Stats->TransferWaits = TransferWaits;
+    Stats->BufferWaits = SlotWaits;
+    Stats->DecodeQueueDepth = (int)DecodeQueue.Depth();
+    Stats->DecodeQueueMax = (int)DecodeQueue.HighWater();
+    std::lock_guard<std::mutex> L(Lock);
+    Stats->ReadyQueueDepth = (int)ReadyQueue.size();
+    Stats->ReadyQueueMax = (int)ReadyHighWater;
+    Stats->Workers = (int)Workers.size();
+}
+
+// Waits for a free buffer and claims it, -1 if the stream is being stopped
+int EVM_Session::WaitFreeSlot()
+{
+    std::unique_lock<std::mutex> L(Lock);
+    int Index = -1;
+    auto Free = [&] {
+        for (int i = 0; i < (int)Slots.size(); i++)
+        {
+            if (Slots[i].State == SLOT_FREE) { Index = i; return true; }
+        }
+        return StopRequest.load();
+    };
+    if (!Free())
+    {
+        SlotWaits++;
+        SlotFreed.wait(L, Free);
+    }
+    if (StopRequest) return(-1);
+    Slots[Index].State = SLOT_FILLING;
+    return(Index);
+}
+
+// Describes the stream being started to the recording, the clients of the server and the shared ring
+EVM_RecordHeader EVM_Session::Describe() const
+{
+    EVM_RecordHeader Header;
+    memset(&Header, 0, sizeof(Header));
+    memcpy(Header.Magic, "EVMREC1", 8);
+    Header.Version = 2;
+    Header.Channels = Channels;
+    Header.nDVALIDReads = nDVALIDReads;
+    Header.SampleType = Conv.SampleType | Conv.Layout;
+    Header.Content = Events.Active() ? EVM_RECORD_EVENTS : Filter.Active() ? EVM_RECORD_FILTERED : EVM_RECORD_SAMPLES;
+    Header.RecordBytes = Events.Active() ? Events.RecordBytes() : 0;
+    Header.CFGHIGH = CFGHIGH;
+    Header.StartTime = EVM_Now();
+    return Header;
+}
+
+// Hands a filled buffer to the caller, writing it to the recording, the clients and the shared ring first
+void EVM_Session::Publish(int Index)
+{
+    EVM_TRACE_SCOPE_ARG("publish", Slots[Index].Info.Sequence);
+    const Slot& S = Slots[Index];
+    const size_t Bytes = (size_t)S.Info.Samples * (Events.Active() ? Events.RecordBytes() : EVM_SampleSize(Conv.SampleType));
+    const int Width = Events.Active() ? 0 : Filter.Active() ? Filter.GroupChannels(S.Info.Group / 2) : (Conv.Roi != nullptr) ? (int)Roi.Index.size() : Channels;
+    bool Local = true;
+
+    if (Recorder.IsOpen())
+    {
+        if (RecordError == 0 && !Recorder.Write(S.Info, S.Data, Bytes, Width))
+        {
+            RecordError = -17;
+            StopRequest = true;
+        }
+        if (!(RecordFlags & EVM_RECORD_PUBLISH)) Local = false;
+    }
+    if (Server.IsOn())
+    {
+        Server.Send(S.Info, S.Data, Bytes, Width);
+        if (!(ServeFlags & EVM_SERVE_PUBLISH)) Local = false;
+    }
+    if (Shared.IsOpen())
+    {
+        Shared.Write(S.Info, S.Data, Bytes, Width);
+        if (!(ShareFlags & EVM_SHARE_PUBLISH)) Local = false;
+    }
+
+    std::lock_guard<std::mutex> L(Lock);
+    if (!Local)
+    {
+        // Only recorded or sent, the buffer goes straight back to the ring
+        Slots[Index].State = SLOT_FREE;
+        nBlocks++;
+        SlotFreed.notify_one();
+        return;
+    }
+    Slots[Index].State = SLOT_READY;
+    ReadyQueue.push_back(Index);
+    ReadyHighWater = max(ReadyHighWater, ReadyQueue.size());
+    nBlocks++;
+    BlockReady.notify_one();
+}
+
+// Takes a free transfer buffer, waiting for the workers to give one back. -1 if the stream is being stopped.
+int EVM_Session::TakeTransfer()
+{
+    int t;
+    if (FreeTransfers.TryPop(t)) return(t);
+
+    TransferWaits++;
+    std::unique_lock<std::mutex> P(PipeLock);
+    TransferFreed.wait(P, [&] { return FreeTransfers.TryPop(t) || StopRequest.load(); });
+    return StopRequest ? -1 : t;
+}
+
+void EVM_Session::GiveTransfer(int t)
+{
+    FreeTransfers.TryPush(t);
+    std::lock_guard<std::mutex> P(PipeLock);
+    TransferFreed.notify_one();
+}
+
+void EVM_Session::ReaderLoop()
+{
+    // Transfer completions are only serviced as fast as this thread gets scheduled
+    static const int Priorities[] = { THREAD_PRIORITY_NORMAL, THREAD_PRIORITY_HIGHEST, THREAD_PRIORITY_TIME_CRITICAL };
+    SetThreadPriority(GetCurrentThread(), Priorities[ReaderPriority]);
+    if (ReaderCore >= 0) SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << ReaderCore);
+    EVM_TRACE_THREAD("session reader");
+
+    auto StopNopCmd = EVM_Concat(EVM_SEQ_STOP_CONVERSIONS, EVM_SEQ_NOP);
+    auto StopCmd = EVM_SEQ_STOP_CONVERSIONS;
+    long Result;
+
+    DEBUGECHO("Empty buffer");
+
+    if (SendPacket(USBDevice.get(), StopNopCmd.Bytes, StopNopCmd.Length(), 250))
+    {
+        int t = TakeTransfer();
+        if (t >= 0)
+        {
+            DrainBulkIn(USBDevice.get(), Transfers[t].Data + Channels * 4, STRINGLEN, 250, 32);
+            GiveTransfer(t);
+        }
+        Result = ReadFrames();
+        if (!SendPacket(USBDevice.get(), StopCmd.Bytes, StopCmd.Length(), 250) && Result == 0) Result = -6;
+    }
+    else Result = -5;
+    Board->EndStream(USBDevice.get());
+
+    // Let the workers finish what was queued
+    {
+        std::lock_guard<std::mutex> P(PipeLock);
+        WorkersExit = true;
+        WorkQueued.notify_all();
+    }
+    for (std::thread& W : Workers) W.join();
+    Workers.clear();
+
+    // The recording is complete only once the last chunk is on disk
+    if (Recorder.IsOpen())
+    {
+        long Closed = Recorder.Close();
+        if (Result == 0) Result = (RecordError != 0) ? RecordError : Closed;
+    }
+    if (Server.IsOn()) Server.End(Result);
+    if (Shared.IsOpen()) Shared.End(Result);
+
+    std::lock_guard<std::mutex> L(Lock);
+    Error = Result;
+    Running = false;
+    BlockReady.notify_all();
+}
+
+// Captures nFrames frames (0 = until stopped), re-arming each one as soon as the previous is read: stop, drain
+// the words converted meanwhile and start, so none of them leads the next frame. Only reads: every transfer is
+// handed to the workers as it arrives. Each transfer and re-arm is traced with the frame it belongs to.
+long EVM_Session::ReadFrames()
+{
+    auto StartCmd = EVM_SEQ_START_CONVERSIONS;
+    const long Room = Channels * 4;
+    EVM_ScratchBuffer Scratch;
+
+    DEBUGECHO("Starts a conversion");
+
+    if (!SendPacket(USBDevice.get(), StartCmd.Bytes, StartCmd.Length(), 250)) return(-5);
+    USBDevice->BulkInEndPt->SetXferSize(STRINGLEN);
+
+    for (int Frame = 0; nFrames == 0 || Frame < nFrames; Frame++)
+    {
+        long BytesRead = 0;
+        while (BytesRead < BytesOfData)
+        {
+            long Len = STRINGLEN;
+            bool First = (BytesRead == 0);
+
+            if (StopRequest) return(0);
+            int t = TakeTransfer();
+            if (t < 0) return(0);
+
+            bool Read;
+            {
+                EVM_TRACE_SCOPE_ARG("transfer", Frame);
+                Read = ReadTransfer(USBDevice.get(), Transfers[t].Data + Room, Len, First ? 10000 : 250, First ? 3 : 40);
+            }
+            if (!Read)
+            {
+                GiveTransfer(t);
+                return StopRequest ? 0 : -4;
+            }
+            double Stamp = EVM_Now();
+            if (Len % 4 != 0)
+            {
+                GiveTransfer(t);
+                return(-8);
+            }
+            Len = min(Len, BytesOfData - BytesRead);
+            nTransfersRead++;
+            Board->ApplyControl(USBDevice.get());
+
+            if (!Issue(t, Len, BytesRead, Frame, Stamp)) return(0);
+            BytesRead += Len;
+
+            if (BytesRead >= BytesOfData && (nFrames == 0 || Frame + 1 < nFrames))
+            {
+                EVM_TRACE_SCOPE_ARG("rearm", Frame);
+                if (BurstRearm(USBDevice.get(), Scratch.Data()) != 0) return(-5);
+            }
+        }
+    }
+
+    return(0);
+}
+
+// Describes the transfer just read into t, completed at Stamp, and queues it for decoding. When whole rows are
+// needed the words carried from the previous transfer go in front of it and the cut row at its end is carried
+// to the next. Returns false if the stream is being stopped.
+bool EVM_Session::Issue(int t, long Len, long long BytesRead, int Frame, double Stamp)
+{
+    Transfer& T = Transfers[t];
+    const long Room = Channels * 4;
+    long long FirstWord = BytesRead / 4;
+
+    {
+        std::lock_guard<std::mutex> G(TimingLock);
+        if (BytesRead == 0)
+        {
+            Timing.NewFrame((T.Data[Room] == 128) ? 0 : 1);
+            TimingFrame = Frame;
+        }
+        Timing.Add((BytesRead + Len) / 4, Stamp);
+    }
+
+    T.Offset = Room;
+    T.Len = Len;
+    if (WholeRows)
+    {
+        FirstWord -= CarryWords;
+        T.Offset -= CarryWords * 4;
+        memcpy(T.Data + T.Offset, Carry.data(), CarryWords * 4);
+        T.Len += CarryWords * 4;
+
+        long Whole = (T.Len / 4) / Channels * Channels * 4;
+        CarryWords = (T.Len - Whole) / 4;
+        memcpy(Carry.data(), T.Data + T.Offset + Whole, CarryWords * 4);
+        T.Len = Whole;
+        if (T.Len == 0)
+        {
+            GiveTransfer(t);
+            return true;
+        }
+    }
+
+    T.Rows = (T.Len / 4 + Channels - 1) / Channels;
+    T.Frame = Frame;
+    T.Row = FirstWord / Channels;
+    T.Stamp = Stamp;
+    T.Time = Timing.Time(T.Row);
+    T.AorB = (T.Data[T.Offset] == 128) ? 0 : 1;
+    if (Conv.Roi != nullptr)
+    {
+        T.SampleIndex = FirstWord / Channels * (long long)Conv.Roi->Index.size();
+        T.Samples = (int)(T.Rows * (long)Conv.Roi->Index.size());
+    }
+    else
+    {
+        T.SampleIndex = FirstWord;
+        T.Samples = (int)(T.Len / 4);
+    }
+
+    // The output buffer is claimed in transfer order, so a slow consumer stalls the reader here
+    T.OutSlot = -1;
+    if (!Filter.Active() && !Events.Active())
+    {
+        T.OutSlot = WaitFreeSlot();
+        if (T.OutSlot < 0)
+        {
+            GiveTransfer(t);
+            return false;
+        }
+    }
+
+    T.Seq = Issued;
+    T.Done.store(false, std::memory_order_relaxed);
+    InFlight[T.Seq % TransferCount] = t;
+    Issued++;
+    DecodeQueue.TryPush(t);
+    std::lock_guard<std::mutex> P(PipeLock);
+    WorkQueued.notify_one();
+    return true;
+}
+
+void EVM_Session::WorkerLoop()
+{
+    EVM_TRACE_THREAD("session decoder");
+    for (;;)
+    {
+        int t;
+        if (!DecodeQueue.TryPop(t))
+        {
+            std::unique_lock<std::mutex> P(PipeLock);
+            WorkQueued.wait(P, [&] { return DecodeQueue.Depth() > 0 || WorkersExit.load(); });
+            if (DecodeQueue.Depth() == 0 && WorkersExit) return;
+            continue;
+        }
+
+        Transfer& T = Transfers[t];
+        const unsigned char* Raw = T.Data + T.Offset;
+        EVM_TRACE_SCOPE_ARG("decode", T.Len);
+        if (T.OutSlot >= 0) DecodeSamples(Raw, T.Len, 0, Slots[T.OutSlot].Data, T.Rows, Conv);
+        if (T.Codes != nullptr) DecodeSamples(Raw, T.Len, T.Codes);
+        T.Done.store(true, std::memory_order_release);
+
+        Commit();
+    }
+}
+
+// Publishes every decoded transfer that is next in order. Only one thread commits at a time, which
+// is also what keeps the filter, whose state depends on the order, single threaded.
+void EVM_Session::Commit()
+{
+    std::lock_guard<std::mutex> C(CommitLock);
+    while (NextCommit < Issued)
+    {
+        int t = InFlight[NextCommit % TransferCount];
+        Transfer& T = Transfers[t];
+        if (!T.Done.load(std::memory_order_acquire)) break;
+
+        if (Spectrum[0].Active()) CommitSpectrum(T);
+
+        if (T.OutSlot >= 0)
+        {
+            Slot& S = Slots[T.OutSlot];
+            S.Info.Sequence = BlockSequence++;
+            S.Info.SampleIndex = T.SampleIndex;
+            S.Info.Frame = T.Frame;
+            S.Info.Samples = T.Samples;
+            S.Info.AorB = T.AorB;
+            S.Info.Status = 0;
+            S.Info.Group = 0;
+            S.Info.Timestamp = T.Stamp;
+            S.Info.Time = T.Time;
+            Publish(T.OutSlot);
+        }
+        else if (Events.Active()) CommitEvents(T);
+        else CommitFiltered(T);
+
+        NextCommit++;
+        GiveTransfer(t);
+    }
+}
+
+// Adds the rows of one transfer to the noise spectra, alternate rows going to sides A and B.
+// Rows of different frames are not contiguous, so segments don't span a frame boundary.
+void EVM_Session::CommitSpectrum(Transfer& T)
+{
+    if (T.Frame != PsdFrame)
+    {
+        Spectrum[0].Restart();
+        Spectrum[1].Restart();
+        PsdFrame = T.Frame;
+    }
+
+    long Rows = T.Len / 4 / Channels;
+    for (int s = 0; s < 2; s++)
+    {
+        long First = (s == T.AorB) ? 0 : 1;
+        if (Rows > First) Spectrum[s].Feed(T.Codes + First * Channels, (Rows - First + 1) / 2, 2L * Channels);
+    }
+}
+
+// Runs the codes of one transfer through the decimation stage, alternate rows going to the filters of sides
+// A and B, and publishes one block for each group and side that completed rows. The filter state carries over
+// to the next transfer. Returns false if the stream is being stopped.
+bool EVM_Session::CommitFiltered(Transfer& T)
+{
+    long Rows = T.Len / 4 / Channels;
+
+    for (int s = 0; s < 2; s++)
+    {
+        long First = (s == T.AorB) ? 0 : 1;
+        if (Rows <= First) continue;
+
+        for (int g = 0; g < Filter.Groups(); g++)
+        {
+            long long FirstRow = Filter.Emitted(g, s);
+            long OutRows = Filter.Process(g, s, T.Codes + First * Channels, (Rows - First + 1) / 2, 2 * Channels, FilterOut.data());
+            if (OutRows == 0) continue;
+
+            int Index = WaitFreeSlot();
+            if (Index < 0) return false;
+
+            Slot& S = Slots[Index];
+            long n = OutRows * Filter.GroupChannels(g);
+            StoreCodes(FilterOut.data(), n, S.Data, Conv);
+            S.Info.Sequence = BlockSequence++;
+            S.Info.SampleIndex = FirstRow * Filter.GroupChannels(g);
+            S.Info.Frame = T.Frame;
+            S.Info.Samples = n;
+            S.Info.AorB = s;
+            S.Info.Status = 0;
+            S.Info.Group = 2 * g + s;
+            S.Info.Timestamp = T.Stamp;
+            S.Info.Time = T.Time;
+            Publish(Index);
+        }
+    }
+    return true;
+}
+
+// Runs the codes of one transfer through the event detector and publishes the completed records, as many
+// per block as fit. Events still open at the end of a frame are closed there. Returns false if the stream
+// is being stopped.
+bool EVM_Session::CommitEvents(Transfer& T)
+{
+    long Rows = T.Len / 4 / Channels;
+    Events.Feed(T.Codes, Rows, T.Row, T.Frame, T.AorB);
+    if (T.Row + Rows >= nDVALIDReads) Events.EndFrame();
+
+    const long PerBlock = (long)(SlotBytes / Events.RecordBytes());
+    for (long Ready = Events.Ready(); Ready > 0; Ready = Events.Ready())
+    {
+        int Index = WaitFreeSlot();
+        if (Index < 0) return false;
+
+        Slot& S = Slots[Index];
+        long n = min(Ready, PerBlock);
+        const EVM_Event* First = (const EVM_Event*)Events.Records();
+        memcpy(S.Data, First, (size_t)n * Events.RecordBytes());
+        S.Info.Sequence = BlockSequence++;
+        S.Info.SampleIndex = First->SampleIndex;
+        S.Info.Frame = First->Frame;
+        S.Info.Samples = n;
+        S.Info.AorB = First->AorB;
+        S.Info.Status = 0;
+        S.Info.Group = 0;
+        S.Info.Timestamp = T.Stamp;
+        S.Info.Time = T.Time;
+        Publish(Index);
+        Events.Drop(n);
+    }
+    return true;
+}
+
+//===================================================================================================================
+
+// Opens the board USBdev for streaming, returns null if it can't be opened
+EVM_HANDLE __stdcall EVM_SessionOpen(int USBdev)
+{
+    EVM_Session* Session = new EVM_Session(USBdev);
+    if (!Session->Open())
+    {
+        delete Session;
+        return(nullptr);
+    }
+    return(Session);
+}
+
+// Opens the board with serial number Serial for streaming, returns null if it is not attached
+EVM_HANDLE __stdcall EVM_SessionOpenSerial(char* Serial)
+{
+    int USBdev = EVM_FindDevice(Serial);
+    if (USBdev < 0) return(nullptr);
+    return EVM_SessionOpen(USBdev);
+}
+
+// Stops any running stream and closes the board
+void __stdcall EVM_SessionClose(EVM_HANDLE Session)
+{
+    delete Session;
+}
+
+// Selects the sample type and layout of the stream buffers (EVM_SAMPLE_xxx | EVM_LAYOUT_xxx), as in EVM_DataCapEx.
+// Default is EVM_SAMPLE_INT32. A channel major block holds the whole DVALIDs it covers.
+long __stdcall EVM_StreamSetSampleType(EVM_HANDLE Session, int SampleType, byte* CFGHIGH)
+{
+    if (Session == nullptr) return(-7);
+    return Session->SetSampleType(SampleType, *CFGHIGH);
+}
+
+// Sets the decimation stage applied to the following streams (EVM_FILTER_xxx, EVM_FILTER_NONE to remove it).
+// Group g takes the next GroupChannels[g] channels of each DVALID and outputs one row of them every Factors[g]
+// DVALIDs of each side, sides A and B filtered apart. The rows of group g and side s come in blocks of their own
+// tagged with Info.Group = 2 * g + s and Info.AorB = s. Channels past the last group are dropped.
+// The filter state carries across transfers and frames until the stream is stopped.
+long __stdcall EVM_StreamSetFilter(EVM_HANDLE Session, int Mode, int Order, int nGroups, int* GroupChannels, int* Factors)
+{
+    if (Session == nullptr) return(-7);
+    return Session->SetFilter(Mode, Order, nGroups, GroupChannels, Factors);
+}
+
+// Estimates the noise PSD of every channel and side while streaming: Welch averaged, SegmentLength points
+// (a power of 2, 16 to 32768) per segment, DVALIDRate the DVALIDs per second. 0 turns it off.
+long __stdcall EVM_StreamSetPSD(EVM_HANDLE Session, int SegmentLength, double DVALIDRate)
+{
+    if (Session == nullptr) return(-7);
+    return Session->SetPSD(SegmentLength, DVALIDRate);
+}
+
+// Copies the estimate so far into PSD, laid out as in EVM_ComputePSD. Returns the segments averaged per side.
+long __stdcall EVM_StreamGetPSD(EVM_HANDLE Session, double* PSD)
+{
+    if (Session == nullptr || PSD == nullptr) return(-7);
+    return Session->GetPSD(PSD);
+}
+
+// Timing of the frame being streamed: completion of its transfers and the fitted time of its DVALIDs, which
+// EVM_SampleTime maps. Blocks carry the time of their own transfer. Returns the frame, -1 before the first.
+long __stdcall EVM_StreamGetTiming(EVM_HANDLE Session, EVM_Timing* Timing)
+{
+    if (Session == nullptr || Timing == nullptr) return(-7);
+    return Session->GetTiming(Timing);
+}
+
+// Replaces the dense blocks of the following streams with event records (nThresholds 0 to go back). Each
+// channel of each side triggers when it moves Thresholds[c] codes over its baseline (under it if negative),
+// one threshold for all if nThresholds is 1, and re-arms once back within Hysteresis codes of the baseline
+// side. The baseline follows the idle channels with a time constant of 2^BaselineShift samples (0 to 20).
+// A record keeps PreSamples codes before the trigger and PostSamples after it (0 to 4096 each, same side).
+// Blocks then hold Info.Samples records as raw codes whatever the sample type. Not with a filter, ROI ignored.
+// Returns the bytes of a record, EVM_Event plus its window.
+long __stdcall EVM_StreamSetEvents(EVM_HANDLE Session, int nThresholds, int* Thresholds, int Hysteresis,
+                                   int PreSamples, int PostSamples, int BaselineShift)
+{
+    if (Session == nullptr) return(-7);
+    return Session->SetEvents(nThresholds, Thresholds, Hysteresis, PreSamples, PostSamples, BaselineShift);
+}
+
+// Records the following streams to Path, none if null. Every block is appended to the file as it is published,
+// see EVM_RecordHeader, through QueueDepth chunks of ChunkKB KB (multiple of 4, 0 = 4 chunks of 4096 KB) written
+// with unbuffered overlapped I/O. Blocks are not handed to EVM_BufferAcquire unless Flags has EVM_RECORD_PUBLISH.
+// If the disk can't keep up the stream waits for it; if it fails the stream ends with -17.
+long __stdcall EVM_StreamRecord(EVM_HANDLE Session, char* Path, int Flags, int QueueDepth, int ChunkKB)
+{
+    if (Session == nullptr) return(-7);
+    return Session->SetRecord(Path, Flags, QueueDepth, ChunkKB);
+}
+
+// Reads the recorder counters of the current or last stream. A growing Waits means the disk is the bottleneck.
+long __stdcall EVM_StreamGetRecordStats(EVM_HANDLE Session, EVM_RecordStats* Stats)
+{
+    if (Session == nullptr || Stats == nullptr) return(-7);
+    Session->GetRecordStats(Stats);
+    return(0);
+}
+
+// Serves the following streams to other processes on Port of this host (0 to stop), over TCP, UDP or both
+// (EVM_SERVE_xxx). Every block goes out once framed as an EVM_ServeFrame, each stream starting with an
+// EVM_SERVE_HELLO that describes it along with Regs (as in EVM_RegsTransfer, null for the last readback).
+// A client more than QueueBlocks blocks behind (0 = 64) skips blocks, or is dropped with EVM_SERVE_DROP_SLOW.
+// Blocks are not handed to EVM_BufferAcquire unless Flags has EVM_SERVE_PUBLISH. Only local clients are served
+// unless Flags has EVM_SERVE_REMOTE. Returns 0, -18 if the port can't be opened.
+long __stdcall EVM_StreamServe(EVM_HANDLE Session, int Port, int Flags, int QueueBlocks, int* Regs)
+{
+    if (Session == nullptr) return(-7);
+    return Session->SetServe(Port, Flags, QueueBlocks, Regs);
+}
+
+// Reads the server counters. Skipped blocks or dropped clients mean the clients can't keep up.
+long __stdcall EVM_StreamGetServeStats(EVM_HANDLE Session, EVM_ServeStats* Stats)
+{
+    if (Session == nullptr || Stats == nullptr) return(-7);
+    Session->GetServeStats(Stats);
+    return(0);
+}
+
+// Before EVM_StreamStart, publishes the blocks in the named shared memory ring Name of Slots slots (0 = 64) of
+// SlotKB KB (0 = room for any dense block), for readers on this machine (see EVM_SharedOpen). Name null to stop
+// sharing. The producer never waits for the readers, they detect the blocks they missed. Blocks are not handed
+// to EVM_BufferAcquire unless Flags has EVM_SHARE_PUBLISH. Returns 0, -18 if the ring can't be created or the
+// name is in use. A stream whose blocks don't fit the slots fails to start with -7.
+long __stdcall EVM_StreamShare(EVM_HANDLE Session, char* Name, int Slots, int SlotKB, int Flags)
+{
+    if (Session == nullptr) return(-7);
+    return Session->SetShare(Name, Slots, SlotKB, Flags);
+}
+
+// Keeps only the nSelected channels of ChannelList, in that order, in the following streams (0 to keep all).
+// The list is checked against Channels by EVM_StreamStart. Blocks then hold whole DVALIDs of nSelected samples
+// and EVM_BlockInfo.SampleIndex counts the selected samples. Ignored when a filter is set, its groups select.
+long __stdcall EVM_StreamSetROI(EVM_HANDLE Session, int nSelected, int* ChannelList)
+{
+    if (Session == nullptr) return(-7);
+    return Session->SetROI(nSelected, ChannelList);
+}
+
+// Delivers every DVALID of the following streams as a Width x Height image in row major order, gathered with
+// the table of EVM_MapPixels while decoding (0 x 0 to keep all channels). Replaces the ROI, which it is: blocks
+// hold whole images and EVM_BlockInfo.SampleIndex counts pixels. The masked pixels are 0, NaN for float types.
+long __stdcall EVM_StreamSetImage(EVM_HANDLE Session, int Width, int Height, int* Gather)
+{
+    if (Session == nullptr) return(-7);
+    return Session->SetImage(Width, Height, Gather);
+}
+
+// Sets the pipeline of the following streams: nWorkers decode threads (1 to 64, default 1) and nTransfers
+// transfer buffers between the reader and them (0 = 2 * nWorkers + 2). Blocks are published in order anyway.
+long __stdcall EVM_StreamSetPipeline(EVM_HANDLE Session, int nWorkers, int nTransfers)
+{
+    if (Session == nullptr) return(-7);
+    return Session->SetPipeline(nWorkers, nTransfers);
+}
+
+// Sets how the buffers of the following streams are allocated: EVM_MEM_LOCK locks them in memory,
+// EVM_MEM_LARGE_PAGES backs them with large pages (needs the "Lock pages in memory" right). They are always
+// allocated once, touched and reused across streams. Returns 0, or the flags that could not be honoured.
+long __stdcall EVM_StreamSetMemory(EVM_HANDLE Session, int Flags)
+{
+    if (Session == nullptr) return(-7);
+    return Session->SetMemory(Flags);
+}
+
+// Runs the reader thread of the following streams at EVM_PRIORITY_xxx, pinned to Core (-1 = any)
+long __stdcall EVM_StreamSetReaderPriority(EVM_HANDLE Session, int Priority, int Core)
+{
+    if (Session == nullptr) return(-7);
+    return Session->SetReaderPriority(Priority, Core);
+}
+
+// Starts streaming nFrames captures of Channels * nDVALIDReads samples (0 = until stopped)
+// into a ring of nBuffers library owned buffers of STRINGLEN / 4 samples each.
+long __stdcall EVM_StreamStart(EVM_HANDLE Session, int Channels, int nDVALIDReads, int nFrames, int nBuffers)
+{
+    if (Session == nullptr) return(-7);
+    return Session->Start(Channels, nDVALIDReads, nFrames, nBuffers);
+}
+
+// Stops the stream, returns the error that ended it or 0
+long __stdcall EVM_StreamStop(EVM_HANDLE Session)
+{
+    if (Session == nullptr) return(-7);
+    return Session->Stop();
+}
+
+// Waits up to TimeoutMs (-1 = forever) for the next completed buffer. Returns its index, to be given back
+// with EVM_BufferRelease, -4 on timeout, -13 at the end of the stream or the error that ended it.
+// Data stays valid and untouched by the library until the buffer is released.
+long __stdcall EVM_BufferAcquire(EVM_HANDLE Session, int TimeoutMs, void** Data, int* Samples, EVM_BlockInfo* Info)
+{
+    if (Session == nullptr) return(-7);
+    return Session->Acquire(TimeoutMs, Data, Samples, Info);
+}
+
+// Gives a buffer back to the reader, -15 if Index is not an acquired buffer
+long __stdcall EVM_BufferRelease(EVM_HANDLE Session, int Index)
+{
+    if (Session == nullptr) return(-7);
+    return Session->Release(Index);
+}
+
+// Reads the pipeline counters of the current or last stream. A growing BufferWaits means the caller is the
+// bottleneck, TransferWaits with a full decode queue means more workers are needed.
+long __stdcall EVM_StreamGetStats(EVM_HANDLE Session, EVM_StreamStats* Stats)
+{
+    if (Session == nullptr || Stats == nullptr) return(-7);
+    Session->GetStats(Stats);
+    return(0);
+}
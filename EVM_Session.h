@@ -0,0 +1,213 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ *
+ * A session keeps one board open and streams captures into a ring of library owned
+ * sample buffers. The caller borrows completed buffers with EVM_BufferAcquire and gives
+ * them back with EVM_BufferRelease while the pipeline fills the others.
+ *
+ * Pipeline: the reader thread only moves transfers from the board into a pool of raw
+ * buffers and queues them; a pool of workers decodes them in parallel; the commit step,
+ * run by whichever worker finishes the oldest transfer, applies the stateful stages and
+ * publishes the blocks in transfer order.
+ */
+
+#ifndef EVM_SESSION_H
+#define EVM_SESSION_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class CCyUSBDevice;
+class EVM_Board;
+
+struct EVM_Session
+{
+    enum SlotState { SLOT_FREE, SLOT_FILLING, SLOT_READY, SLOT_ACQUIRED };
+
+    struct Slot
+    {
+        unsigned char* Data;  // In SlotMemory
+        EVM_BlockInfo Info;
+        SlotState State;
+    };
+
+    // One transfer on its way through the pipeline
+    struct Transfer
+    {
+        unsigned char* Data;                    // In TransferMemory: room for a carried row, then STRINGLEN bytes
+        int* Codes;                             // Decoded codes for the filter, the spectra and the events
+        long long Seq;
+        long Offset;                            // Words to decode start at Data + Offset
+        long Len;
+        long Rows;
+        int OutSlot;                            // Output buffer, -1 when filtered or detecting events
+        int Frame;
+        long long SampleIndex;
+        long long Row;                          // First DVALID within the frame
+        int Samples;
+        int AorB;
+        double Stamp;                           // Completion of the transfer
+        double Time;                            // Estimated time of its first DVALID
+        std::atomic<bool> Done;
+    };
+
+    int USBdev;
+    std::unique_ptr<CCyUSBDevice> USBDevice;
+    EVM_Board* Board;     // Owned by the data path while the reader runs
+
+    // Stream configuration
+    int Channels;
+    int nDVALIDReads;
+    int nFrames;
+    long BytesOfData;
+    int SampleType;
+    byte CFGHIGH;
+    EVM_Conversion Conv;  // Built by Start for the selected sample type and channel count
+    int nWorkers;
+    int nTransfers;       // 0 = default
+    int TransferCount;
+    int MemoryFlags;      // EVM_MEM_xxx
+    int ReaderPriority;   // EVM_PRIORITY_xxx
+    int ReaderCore;       // -1 = any
+    EVM_PageBlock SlotMemory;
+    EVM_PageBlock TransferMemory;
+
+    // Channel selection, see EVM_StreamSetROI, or pixel gather table of EVM_StreamSetImage
+    std::vector<int> RoiList;
+    bool RoiImage;
+    EVM_Roi Roi;
+
+    // Decimation stage, see EVM_StreamSetFilter
+    EVM_Decimator Filter;
+    std::vector<double> FilterOut;
+
+    // Noise spectra of sides A and B, see EVM_StreamSetPSD. Fed by the commit step.
+    int PsdLength;
+    double PsdRate;
+    double PsdGain;
+    int PsdFrame;
+    EVM_Welch Spectrum[2];
+
+    // Time of the DVALIDs, fitted by the reader as the transfers arrive
+    EVM_TimingFit Timing;
+    int TimingFrame;
+    std::mutex TimingLock;                    // The reader takes it to update the fit, not to read it
+
+    // Event detection, see EVM_StreamSetEvents. Replaces the dense blocks with event records.
+    EVM_EventDetector Events;
+
+    // Recording of the blocks, see EVM_StreamRecord. Written by the commit step.
+    EVM_Recorder Recorder;
+    std::string RecordPath;                   // Empty = not recording
+    int RecordFlags;
+    int RecordDepth;
+    size_t RecordChunk;
+    long RecordError;
+
+    // Fan-out to other processes, see EVM_StreamServe. Stays up across streams.
+    EVM_Server Server;
+    int ServeFlags;
+    unsigned char ServeRegs[EVM_REG_COUNT];
+
+    // Shared memory ring for readers on this machine, see EVM_StreamShare. Stays up across streams.
+    EVM_SharedRing Shared;
+    int ShareFlags;
+
+    // Rows cut by the end of a transfer are completed with the start of the next one, every
+    // block holds whole rows. Reader thread only.
+    bool WholeRows;
+    std::vector<unsigned char> Carry;
+    long CarryWords;
+
+    // Buffer ring, guarded by Lock
+    std::vector<Slot> Slots;
+    size_t SlotBytes;
+    std::deque<int> ReadyQueue;
+    std::mutex Lock;
+    std::condition_variable SlotFreed;
+    std::condition_variable BlockReady;
+
+    // Pipeline
+    std::unique_ptr<Transfer[]> Transfers;
+    std::unique_ptr<int[]> InFlight;          // Transfer holding each sequence number, modulo nTransfers
+    EVM_BoundedQueue<int> FreeTransfers;
+    EVM_BoundedQueue<int> DecodeQueue;
+    std::mutex PipeLock;                      // Only to sleep on the conditions below
+    std::condition_variable TransferFreed;
+    std::condition_variable WorkQueued;
+    std::vector<std::thread> Workers;
+    std::atomic<bool> WorkersExit;
+    std::atomic<long long> Issued;            // Transfers queued by the reader
+    std::mutex CommitLock;
+    long long NextCommit;
+    long long BlockSequence;
+
+    // Metrics, see EVM_StreamGetStats
+    std::atomic<long long> nTransfersRead;
+    std::atomic<long long> nBlocks;
+    std::atomic<long long> TransferWaits;
+    std::atomic<long long> SlotWaits;
+    size_t ReadyHighWater;
+
+    std::thread Reader;
+    std::atomic<bool> StopRequest;
+    bool Running;
+    long Error;
+
+    EVM_Session(int USBdev);
+    ~EVM_Session();
+
+    bool Open();
+    long SetSampleType(int SampleType, byte CFGHIGH);
+    long SetROI(int nSelected, const int* ChannelList);
+    long SetImage(int Width, int Height, const int* Gather);
+    long SetFilter(int Mode, int Order, int nGroups, const int* GroupChannels, const int* Factors);
+    long SetPipeline(int nWorkers, int nTransfers);
+    long SetPSD(int SegmentLength, double DVALIDRate);
+    long GetPSD(double* PSD);
+    long GetTiming(EVM_Timing* Timing);
+    long SetEvents(int nThresholds, const int* Thresholds, int Hysteresis, int PreSamples, int PostSamples, int BaselineShift);
+    long SetRecord(const char* Path, int Flags, int QueueDepth, int ChunkKB);
+    void GetRecordStats(EVM_RecordStats* Stats);
+    long SetServe(int Port, int Flags, int QueueBlocks, const int* Regs);
+    void GetServeStats(EVM_ServeStats* Stats);
+    long SetShare(const char* Name, int Slots, int SlotKB, int Flags);
+    long SetMemory(int Flags);
+    long SetReaderPriority(int Priority, int Core);
+    long Start(int Channels, int nDVALIDReads, int nFrames, int nBuffers);
+    long Stop();
+    long Acquire(int TimeoutMs, void** Data, int* Samples, EVM_BlockInfo* Info);
+    long Release(int Index);
+    void GetStats(EVM_StreamStats* Stats);
+
+private:
+    bool Reserve(EVM_PageBlock& Block, size_t Bytes);
+    void ReaderLoop();
+    long ReadFrames();
+    bool Issue(int t, long Len, long long BytesRead, int Frame, double Stamp);
+    void WorkerLoop();
+    void Commit();
+    bool CommitFiltered(Transfer& T);
+    void CommitSpectrum(Transfer& T);
+    bool CommitEvents(Transfer& T);
+    int TakeTransfer();
+    void GiveTransfer(int t);
+    int WaitFreeSlot();
+    void Publish(int Index);
+    EVM_RecordHeader Describe() const;
+};
+
+#endif // EVM_SESSION_H
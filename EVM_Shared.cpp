@@ -0,0 +1,306 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ */
+
+#include "StdAfx.h"
+#include "DDC264EVM_IO.h"
+#include "EVM_Timing.h"
+#include "EVM_Shared.h"
+
+#include <atomic>
+#include <climits>
+#include <cstring>
+
+static const long long HEADER_BYTES = 4096;
+
+static size_t SlotStride(size_t SlotBytes)
+{
+    return (sizeof(EVM_SharedSlot) + SlotBytes + 63) & ~(size_t)63;
+}
+
+std::string EVM_SharedEventName(const char* Name, int Parity)
+{
+    return std::string(Name) + ((Parity == 0) ? ".Ready0" : ".Ready1");
+}
+
+EVM_SharedRing::EVM_SharedRing() : Mapping(NULL), Header(nullptr)
+{
+    Ready[0] = Ready[1] = NULL;
+}
+
+EVM_SharedRing::~EVM_SharedRing()
+{
+    Close();
+}
+
+long EVM_SharedRing::Create(const char* Name, int Slots, size_t SlotBytes)
+{
+    Close();
+    if (Name == nullptr || *Name == 0 || Slots < 2 || SlotBytes == 0) return(-7);
+
+    unsigned long long Bytes = HEADER_BYTES + (unsigned long long)Slots * SlotStride(SlotBytes);
+    Mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)(Bytes >> 32), (DWORD)Bytes, Name);
+    // A ring of that name still mapped by its readers would have another layout
+    if (Mapping != NULL && GetLastError() == ERROR_ALREADY_EXISTS)
+    {
+        CloseHandle(Mapping);
+        Mapping = NULL;
+    }
+    if (Mapping == NULL) return(-18);
+    Header = (EVM_SharedHeader*)MapViewOfFile(Mapping, FILE_MAP_WRITE, 0, 0, 0);
+    for (int p = 0; p < 2; p++) Ready[p] = CreateEventA(NULL, TRUE, FALSE, EVM_SharedEventName(Name, p).c_str());
+    if (Header == nullptr || Ready[0] == NULL || Ready[1] == NULL)
+    {
+        Close();
+        return(-18);
+    }
+
+    // The pages are zeroed: no stream and no block yet
+    memcpy(Header->Magic, "EVMSHM1", 8);
+    Header->Version = 1;
+    Header->Slots = Slots;
+    Header->SlotBytes = SlotBytes;
+    Header->SlotStride = SlotStride(SlotBytes);
+    Header->FirstSlot = HEADER_BYTES;
+    for (int s = 0; s < Slots; s++) ((EVM_SharedSlot*)((unsigned char*)Header + HEADER_BYTES + s * Header->SlotStride))->Sequence = -1;
+    return(0);
+}
+
+void EVM_SharedRing::Close()
+{
+    if (Header != nullptr)
+    {
+        if (Header->Status == 1) End(0);
+        UnmapViewOfFile(Header);
+        Header = nullptr;
+    }
+    for (int p = 0; p < 2; p++)
+    {
+        if (Ready[p] != NULL) CloseHandle(Ready[p]);
+        Ready[p] = NULL;
+    }
+    if (Mapping != NULL) CloseHandle(Mapping);
+    Mapping = NULL;
+}
+
+void EVM_SharedRing::Begin(const EVM_RecordHeader& Describe)
+{
+    // Running before the new stream is counted: a reader never takes the end of the last one for its end
+    Header->Describe = Describe;
+    Header->Status = 1;
+    std::atomic_thread_fence(std::memory_order_release);
+    Header->Stream = Header->Stream + 1;
+}
+
+void EVM_SharedRing::Write(const EVM_BlockInfo& Info, const void* Data, size_t Bytes, int Width)
+{
+    const long long Sequence = Header->Head;
+    EVM_SharedSlot* S = (EVM_SharedSlot*)((unsigned char*)Header + Header->FirstSlot + (Sequence % Header->Slots) * Header->SlotStride);
+    Bytes = min(Bytes, (size_t)Header->SlotBytes);
+
+    // Readers still on the block this slot held see it is gone before any of it changes
+    S->Sequence = -1;
+    std::atomic_thread_fence(std::memory_order_release);
+    S->Stream = Header->Stream;
+    S->Info = Info;
+    S->Bytes = Bytes;
+    S->Width = Width;
+    memcpy(S + 1, Data, Bytes);
+    std::atomic_thread_fence(std::memory_order_release);
+    S->Sequence = Sequence;
+    Signal(Sequence);
+}
+
+void EVM_SharedRing::End(long Status)
+{
+    std::atomic_thread_fence(std::memory_order_release);
+    Header->Status = Status;
+    SetEvent(Ready[0]);
+    SetEvent(Ready[1]);
+}
+
+// Publishes the block Sequence. A reader waits for a block on the event of its parity, which was reset when the
+// one before was published, so it doesn't find it still set by an older block.
+void EVM_SharedRing::Signal(long long Sequence)
+{
+    ResetEvent(Ready[(Sequence + 1) & 1]);
+    std::atomic_thread_fence(std::memory_order_release);
+    Header->Head = Sequence + 1;
+    SetEvent(Ready[Sequence & 1]);
+}
+
+//===================================================================================================================
+
+EVM_SharedReader::EVM_SharedReader() : Mapping(NULL), Header(nullptr), Next(0), Held(-1), Ended(0)
+{
+    Ready[0] = Ready[1] = NULL;
+    memset(&Stats, 0, sizeof(Stats));
+}
+
+EVM_SharedReader::~EVM_SharedReader()
+{
+    if (Header != nullptr) UnmapViewOfFile(Header);
+    for (int p = 0; p < 2; p++) if (Ready[p] != NULL) CloseHandle(Ready[p]);
+    if (Mapping != NULL) CloseHandle(Mapping);
+}
+
+bool EVM_SharedReader::Open(const char* Name)
+{
+    Mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, Name);
+    if (Mapping == NULL) return(false);
+    Header = (const EVM_SharedHeader*)MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+    if (Header == nullptr || memcmp(Header->Magic, "EVMSHM1", 8) != 0 || Header->Version != 1) return(false);
+    for (int p = 0; p < 2; p++)
+    {
+        Ready[p] = OpenEventA(SYNCHRONIZE, FALSE, EVM_SharedEventName(Name, p).c_str());
+        if (Ready[p] == NULL) return(false);
+    }
+
+    // From the next block on, the end of a stream already over is not reported
+    long Status = Header->Status;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    Ended = (Status != 1) ? Header->Stream : 0;
+    Next = Header->Head;
+    return(true);
+}
+
+const EVM_SharedSlot* EVM_SharedReader::Slot(long long Sequence) const
+{
+    return (const EVM_SharedSlot*)((const unsigned char*)Header + Header->FirstSlot + (Sequence % Header->Slots) * Header->SlotStride);
+}
+
+long EVM_SharedReader::Acquire(int TimeoutMs, void** Data, EVM_SharedSlot* Block)
+{
+    if (Held >= 0) Release();
+
+    const double Deadline = EVM_Now() + TimeoutMs / 1000.0;
+    long long Lost = 0;
+    for (;;)
+    {
+        // The status before the head: a stream seen over has nothing more to publish
+        const long long Stream = Header->Stream;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const long Status = Header->Status;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const long long Head = Header->Head;
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (Next < Head)
+        {
+            // The slot of Head - Slots may be being written already
+            const long long Oldest = Head - Header->Slots + 1;
+            if (Next < Oldest)
+            {
+                Lost += Oldest - Next;
+                Next = Oldest;
+            }
+            const EVM_SharedSlot* S = Slot(Next);
+            if (S->Sequence == Next)
+            {
+                std::atomic_thread_fence(std::memory_order_acquire);
+                *Block = *S;
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (S->Sequence == Next)
+                {
+                    if (Data != nullptr) *Data = (void*)(S + 1);
+                    Held = Next++;
+                    Stats.Blocks++;
+                    Stats.Lost += Lost;
+                    return (long)min(Lost, (long long)LONG_MAX);
+                }
+            }
+            // Overwritten meanwhile, the head has moved on
+            continue;
+        }
+
+        if (Status != 1 && Stream != Ended)
+        {
+            Ended = Stream;
+            Stats.Lost += Lost;
+            return (Status != 0) ? Status : -13;
+        }
+
+        double Left = Deadline - EVM_Now();
+        if (TimeoutMs >= 0 && Left <= 0)
+        {
+            Stats.Lost += Lost;
+            return(-4);
+        }
+        // Bounded, a reader slower than two blocks may find the event of its block reset again
+        DWORD Wait = (TimeoutMs < 0) ? 10 : (DWORD)min(10.0, Left * 1000 + 1);
+        WaitForSingleObject(Ready[Next & 1], Wait);
+    }
+}
+
+long EVM_SharedReader::Release()
+{
+    if (Held < 0) return(-15);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const bool Intact = Slot(Held)->Sequence == Held;
+    Held = -1;
+    if (Intact) return(0);
+    Stats.Overruns++;
+    return(-19);
+}
+
+//===================================================================================================================
+
+// Attaches to the shared memory ring Name of EVM_StreamShare, read only, from its next block on. Null if there
+// is no such ring.
+EVM_SHARED __stdcall EVM_SharedOpen(char* Name)
+{
+    if (Name == nullptr) return(nullptr);
+    EVM_SharedReader* Reader = new EVM_SharedReader();
+    if (!Reader->Open(Name))
+    {
+        delete Reader;
+        return(nullptr);
+    }
+    return(Reader);
+}
+
+void __stdcall EVM_SharedClose(EVM_SHARED Reader)
+{
+    delete Reader;
+}
+
+// Copies the header of the ring, with the EVM_RecordHeader of the last stream. Returns the streams started.
+long long __stdcall EVM_SharedGetHeader(EVM_SHARED Reader, EVM_SharedHeader* Header)
+{
+    if (Reader == nullptr || Header == nullptr) return(-7);
+    *Header = *Reader->Header;
+    return(Header->Stream);
+}
+
+// Waits up to TimeoutMs (-1 = forever) for the next block and returns a view of it in the ring, with its slot
+// header in Block, without copying it. The view is valid until EVM_SharedRelease or the next acquire. Returns
+// the blocks lost since the previous one, overwritten before the reader got to them, -4 on timeout, or once
+// per stream -13 or the error that ended it.
+long __stdcall EVM_SharedAcquire(EVM_SHARED Reader, int TimeoutMs, void** Data, EVM_SharedSlot* Block)
+{
+    if (Reader == nullptr || Block == nullptr) return(-7);
+    return Reader->Acquire(TimeoutMs, Data, Block);
+}
+
+// Gives the view back. Returns 0, -19 if the block was overwritten while it was read: what was read of it
+// can't be trusted. -15 if no block is held.
+long __stdcall EVM_SharedRelease(EVM_SHARED Reader)
+{
+    if (Reader == nullptr) return(-7);
+    return Reader->Release();
+}
+
+long __stdcall EVM_SharedGetStats(EVM_SHARED Reader, EVM_SharedStats* Stats)
+{
+    if (Reader == nullptr || Stats == nullptr) return(-7);
+    *Stats = Reader->Stats;
+    Stats->Behind = Reader->Header->Head - Reader->Next;
+    return(0);
+}
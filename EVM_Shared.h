@@ -0,0 +1,77 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ *
+ * Ring of blocks in named shared memory, for readers on the same machine. The producer
+ * writes every block in the next slot whatever the readers do: each slot is stamped with
+ * the sequence number of its block once written, and -1 while being written, so a reader
+ * checks the stamp before and after it looks at a block to know it was not overwritten.
+ * Readers map the ring read only and keep their own position; none can slow the producer.
+ */
+
+#ifndef EVM_SHARED_H
+#define EVM_SHARED_H
+
+#include <string>
+
+class EVM_SharedRing
+{
+public:
+    EVM_SharedRing();
+    ~EVM_SharedRing();
+
+    // Creates the mapping Name of Slots slots of SlotBytes. Returns 0, -7, -18 if it can't be created.
+    long Create(const char* Name, int Slots, size_t SlotBytes);
+    void Close();
+    bool IsOpen() const { return Header != nullptr; }
+    size_t SlotBytes() const { return (Header != nullptr) ? (size_t)Header->SlotBytes : 0; }
+
+    void Begin(const EVM_RecordHeader& Describe);
+    void Write(const EVM_BlockInfo& Info, const void* Data, size_t Bytes, int Width);
+    void End(long Status);
+
+private:
+    EVM_SharedRing(const EVM_SharedRing&);
+    EVM_SharedRing& operator=(const EVM_SharedRing&);
+
+    void Signal(long long Sequence);
+
+    HANDLE Mapping;
+    HANDLE Ready[2];            // Set when a block of even, odd sequence is published
+    EVM_SharedHeader* Header;
+};
+
+struct EVM_SharedReader
+{
+    HANDLE Mapping;
+    HANDLE Ready[2];
+    const EVM_SharedHeader* Header;
+    long long Next;             // Sequence of the next block to acquire
+    long long Held;             // Of the block acquired, -1 if none
+    long long Ended;            // Last stream whose end was reported
+    EVM_SharedStats Stats;
+
+    EVM_SharedReader();
+    ~EVM_SharedReader();
+
+    bool Open(const char* Name);
+    long Acquire(int TimeoutMs, void** Data, EVM_SharedSlot* Block);
+    long Release();
+
+private:
+    EVM_SharedReader(const EVM_SharedReader&);
+    EVM_SharedReader& operator=(const EVM_SharedReader&);
+
+    const EVM_SharedSlot* Slot(long long Sequence) const;
+};
+
+// Names of the events of the ring Name
+std::string EVM_SharedEventName(const char* Name, int Parity);
+
+#endif // EVM_SHARED_H
@@ -0,0 +1,202 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ */
+
+#include "StdAfx.h"
+#include "CyApi.h"
+#include "DDC264EVM_IO.h"
+#include "EVM_Registers.h"
+#include "EVM_Internal.h"
+#include "EVM_Timing.h"
+#include "EVM_Trace.h"
+#include "EVM_Simulator.h"
+
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+
+typedef std::chrono::steady_clock SimClock;
+
+// State of the simulated FPGA, shared by every device that attaches it as a real board is
+struct SimBoard
+{
+    std::mutex Lock;
+    std::condition_variable Changed;
+    bool Enabled = false;
+    double Rate = 0;              // DVALIDs per second, 0 = as fast as read
+    int Regs[EVM_REG_COUNT] = {};
+    bool Running = false;
+    bool Readback = false;
+    SimClock::time_point Started;
+    long long Words = 0;          // Words sent since the start of the conversions
+};
+
+static SimBoard Board;
+
+// Words the board holds for the host now, Channels per DVALID
+static long long Available(const SimBoard& B, int Channels, SimClock::time_point Now)
+{
+    if (B.Rate <= 0) return LLONG_MAX;
+    double Seconds = std::chrono::duration<double>(Now - B.Started).count();
+    return (long long)(Seconds * B.Rate) * Channels - B.Words;
+}
+
+// Bulk endpoint served by the simulated board. CyAPI's XferData runs BeginDataXfer, waits for the
+// OVERLAPPED event and calls FinishDataXfer, so overriding the two virtuals is enough for every call.
+class SimEndPoint : public CCyBulkEndPoint
+{
+public:
+    SimEndPoint(bool In)
+    {
+        bIn = In;
+        TimeOut = 10000;
+        MaxPktSize = 512;
+        hDevice = INVALID_HANDLE_VALUE;
+    }
+
+    PUCHAR BeginDataXfer(PUCHAR buf, LONG len, OVERLAPPED* ov)
+    {
+        long Done = bIn ? Read(buf, len) : Write(buf, len);
+        if (ov != nullptr)
+        {
+            // Where the driver reports a completed request
+            ov->Internal = (Done >= 0) ? 0 : ERROR_SEM_TIMEOUT;
+            ov->InternalHigh = (Done >= 0) ? Done : 0;
+            if (ov->hEvent != NULL) SetEvent(ov->hEvent);
+        }
+        SetLastError((Done >= 0) ? ERROR_SUCCESS : ERROR_SEM_TIMEOUT);
+        return buf;
+    }
+
+    bool FinishDataXfer(PUCHAR buf, LONG& len, OVERLAPPED* ov, PUCHAR pXmitBuf, CCyIsoPktInfo* pktInfos)
+    {
+        if (ov == nullptr) return false;
+        len = (LONG)ov->InternalHigh;
+        bytesWritten = len;
+        return (ov->Internal == 0);
+    }
+
+private:
+    long Write(const unsigned char* buf, long len)
+    {
+        std::lock_guard<std::mutex> L(Board.Lock);
+        for (long i = 0; i + 1 < len; i += 2)
+        {
+            byte Reg = buf[i], Data = buf[i + 1];
+            if (Reg == EVM_REG_NOOP) continue;
+            if (Reg == EVM_REG_CONVERSIONS)
+            {
+                Board.Running = EVM_START_CONVERSIONS::Get(Data) != 0;
+                Board.Started = SimClock::now();
+                Board.Words = 0;
+            }
+            else if (Reg == EVM_REG_READ_OUT_TRIGGER) Board.Readback = (Data != 0);
+            Board.Regs[Reg] = Data;
+        }
+        Board.Changed.notify_all();
+        return len;
+    }
+
+    // Whole words only, -1 if nothing came within TimeOut
+    long Read(unsigned char* buf, long len)
+    {
+        std::unique_lock<std::mutex> L(Board.Lock);
+        SimClock::time_point Deadline = SimClock::now() + std::chrono::milliseconds(TimeOut);
+
+        for (;;)
+        {
+            if (Board.Readback)
+            {
+                // The register file as (address, value) pairs, once per request
+                long n = 0;
+                for (int r = 0; r < EVM_REG_COUNT && n + 2 <= len; r++)
+                {
+                    buf[n++] = (byte)r;
+                    buf[n++] = (byte)Board.Regs[r];
+                }
+                Board.Readback = false;
+                return n;
+            }
+
+            if (Board.Running && len >= 4)
+            {
+                // The board streams without pause: a request completes once full, as the FX2 FIFO fills it
+                int Channels = EVM_ChannelCount(Board.Regs[EVM_REG_FORMAT_CHANNELS]);
+                SimClock::time_point Now = SimClock::now();
+                long long n = len / 4;
+                if (Available(Board, Channels, Now) >= n)
+                {
+                    for (long long i = 0; i < n; i++, Board.Words++)
+                    {
+                        long long Row = Board.Words / Channels;
+                        int Channel = (int)(Board.Words % Channels);
+                        buf[4 * i] = (Row & 1) ? 0 : 128;
+                        buf[4 * i + 1] = 0;
+                        buf[4 * i + 2] = (byte)Channel;
+                        buf[4 * i + 3] = (byte)Row;
+                    }
+                    return (long)(4 * n);
+                }
+
+                // DVALID that fills the request
+                SimClock::time_point Next = Board.Started + std::chrono::duration_cast<SimClock::duration>(
+                    std::chrono::duration<double>(((Board.Words + n + Channels - 1) / Channels) / Board.Rate));
+                if (Next > Deadline) Next = Deadline;
+                Board.Changed.wait_until(L, Next);
+            }
+            else Board.Changed.wait_until(L, Deadline);
+
+            if (SimClock::now() >= Deadline) return(-1);
+        }
+    }
+};
+
+static SimEndPoint SimIn(true);
+static SimEndPoint SimOut(false);
+
+bool EVM_SimulatorAttach(CCyUSBDevice* USBDevice)
+{
+    {
+        std::lock_guard<std::mutex> L(Board.Lock);
+        if (!Board.Enabled) return false;
+    }
+    USBDevice->BulkInEndPt = &SimIn;
+    USBDevice->BulkOutEndPt = &SimOut;
+    return true;
+}
+
+bool EVM_OpenDevice(CCyUSBDevice* USBDevice, int USBdev)
+{
+    EVM_TRACE_SCOPE("open");
+    if (USBdev == EVM_SIMULATED_DEVICE) return EVM_SimulatorAttach(USBDevice);
+    if (USBdev < 0 || USBdev > 255) return false;
+    return USBDevice->Open((UCHAR)USBdev);
+}
+
+//===================================================================================================================
+
+// Enables the simulated board with Channels channels (a power of 2 up to 256) producing DVALIDRate DVALIDs
+// per second, 0 for as fast as they are read. Returns the USBdev to open it, EVM_SIMULATED_DEVICE.
+long __stdcall EVM_SimulatorSetup(int Channels, double DVALIDRate)
+{
+    int Field = EVM_ChannelsField(Channels);
+    if (Field < 0 || DVALIDRate < 0) return(-7);
+
+    std::lock_guard<std::mutex> L(Board.Lock);
+    Board.Enabled = true;
+    Board.Rate = DVALIDRate;
+    Board.Regs[EVM_REG_FORMAT_CHANNELS] = EVM_CHANNELS::Set(Board.Regs[EVM_REG_FORMAT_CHANNELS], Field);
+    Board.Running = false;
+    Board.Readback = false;
+    Board.Changed.notify_all();
+    return(EVM_SIMULATED_DEVICE);
+}
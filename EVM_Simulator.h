@@ -0,0 +1,29 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ *
+ * Simulated board, opened as USBdev EVM_SIMULATED_DEVICE. It answers the same command
+ * packets as the FPGA: register writes, register readback, start and stop of the
+ * conversions, and streams a known pattern at a chosen DVALID rate, so every capture
+ * and streaming call can run without hardware.
+ *
+ * Each word carries the A/B flag of its DVALID and the code
+ * ((Channel & 0xFF) << 8) | (DVALID & 0xFF), DVALIDs counted from the start of the
+ * conversions and channels from the FORMAT_CHANNELS register.
+ */
+
+#ifndef EVM_SIMULATOR_H
+#define EVM_SIMULATOR_H
+
+class CCyUSBDevice;
+
+// Attaches the simulated board to USBDevice in place of Open. Returns false if it is not enabled.
+bool EVM_SimulatorAttach(CCyUSBDevice* USBDevice);
+
+#endif // EVM_SIMULATOR_H
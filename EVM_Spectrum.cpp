@@ -0,0 +1,327 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ */
+
+#include "StdAfx.h"
+#include "DDC264EVM_IO.h"
+#include "EVM_Decode.h"
+#include "EVM_Spectrum.h"
+
+#include <climits>
+#include <cstring>
+#include <map>
+#include <math.h>
+
+static const double PI = 3.14159265358979323846;
+
+// Channels transformed together: the inner loop of every butterfly
+static const int TILE = 16;
+
+static const int MIN_LENGTH = 16;
+static const int MAX_LENGTH = 32768;
+
+// Length point real FFT done as a Length / 2 point complex FFT of the even and odd samples
+struct EVM_FFTPlan
+{
+    int Length;
+    int Half;
+    std::vector<double> Window;           // Hann, Length points
+    double WindowPower;                   // Sum of the squared window
+    std::vector<int> BitReverse;          // Half entries
+    std::vector<double> TwRe, TwIm;       // exp(-2 pi i k / Half), Half / 2 entries
+    std::vector<double> SplitRe, SplitIm; // exp(-2 pi i k / Length), Half + 1 entries
+
+    explicit EVM_FFTPlan(int Length) : Length(Length), Half(Length / 2), WindowPower(0)
+    {
+        Window.resize(Length);
+        for (int n = 0; n < Length; n++)
+        {
+            Window[n] = 0.5 - 0.5 * cos(2 * PI * n / Length);
+            WindowPower += Window[n] * Window[n];
+        }
+
+        int Bits = 0;
+        while ((1 << Bits) < Half) Bits++;
+        BitReverse.resize(Half);
+        for (int i = 0; i < Half; i++)
+        {
+            int r = 0;
+            for (int b = 0; b < Bits; b++) if (i & (1 << b)) r |= 1 << (Bits - 1 - b);
+            BitReverse[i] = r;
+        }
+
+        TwRe.resize(Half / 2);
+        TwIm.resize(Half / 2);
+        for (int k = 0; k < Half / 2; k++)
+        {
+            TwRe[k] = cos(2 * PI * k / Half);
+            TwIm[k] = -sin(2 * PI * k / Half);
+        }
+
+        SplitRe.resize(Half + 1);
+        SplitIm.resize(Half + 1);
+        for (int k = 0; k <= Half; k++)
+        {
+            SplitRe[k] = cos(2 * PI * k / Length);
+            SplitIm[k] = -sin(2 * PI * k / Length);
+        }
+    }
+};
+
+// Plans are built once per length and shared
+static std::shared_ptr<const EVM_FFTPlan> GetPlan(int Length)
+{
+    static std::mutex PlansLock;
+    static std::map<int, std::shared_ptr<const EVM_FFTPlan>> Plans;
+
+    std::lock_guard<std::mutex> L(PlansLock);
+    std::shared_ptr<const EVM_FFTPlan>& P = Plans[Length];
+    if (!P) P = std::make_shared<const EVM_FFTPlan>(Length);
+    return P;
+}
+
+// In place complex FFT of P.Half points, each point a row of Tile values
+static void BatchFFT(const EVM_FFTPlan& P, double* Re, double* Im, int Tile)
+{
+    for (int i = 0; i < P.Half; i++)
+    {
+        int j = P.BitReverse[i];
+        if (j <= i) continue;
+        for (int c = 0; c < Tile; c++)
+        {
+            double t = Re[i * Tile + c]; Re[i * Tile + c] = Re[j * Tile + c]; Re[j * Tile + c] = t;
+            t = Im[i * Tile + c]; Im[i * Tile + c] = Im[j * Tile + c]; Im[j * Tile + c] = t;
+        }
+    }
+
+    for (int Len = 2; Len <= P.Half; Len <<= 1)
+    {
+        int HalfLen = Len / 2;
+        int Step = P.Half / Len;
+        for (int Base = 0; Base < P.Half; Base += Len)
+        {
+            for (int k = 0; k < HalfLen; k++)
+            {
+                double wr = P.TwRe[k * Step], wi = P.TwIm[k * Step];
+                double* ar = Re + (Base + k) * Tile;
+                double* ai = Im + (Base + k) * Tile;
+                double* br = Re + (Base + k + HalfLen) * Tile;
+                double* bi = Im + (Base + k + HalfLen) * Tile;
+                for (int c = 0; c < Tile; c++)
+                {
+                    double tr = br[c] * wr - bi[c] * wi;
+                    double ti = br[c] * wi + bi[c] * wr;
+                    br[c] = ar[c] - tr;
+                    bi[c] = ai[c] - ti;
+                    ar[c] += tr;
+                    ai[c] += ti;
+                }
+            }
+        }
+    }
+}
+
+EVM_Welch::EVM_Welch() : Channels(0), Length(0), Mask(0), Pos(0), Filled(0), Since(0), nSegments(0)
+{
+}
+
+EVM_Welch::~EVM_Welch()
+{
+}
+
+bool EVM_Welch::Setup(int Channels, int Length, int Mask)
+{
+    if (Length == 0)
+    {
+        this->Length = 0;
+        return true;
+    }
+    if (Channels <= 0 || Length < MIN_LENGTH || Length > MAX_LENGTH || (Length & (Length - 1)) != 0) return false;
+
+    if (Length != this->Length) Plan = GetPlan(Length);
+    this->Channels = Channels;
+    this->Length = Length;
+    this->Mask = Mask;
+    History.resize((size_t)Length * Channels);
+    Re.resize((size_t)(Length / 2) * TILE);
+    Im.resize((size_t)(Length / 2) * TILE);
+    Mean.resize(TILE);
+    Power.resize((size_t)TILE * (Length / 2 + 1));
+    {
+        std::lock_guard<std::mutex> L(Lock);
+        Acc.resize((size_t)Channels * (Length / 2 + 1));
+    }
+    Reset();
+    return true;
+}
+
+void EVM_Welch::Reset()
+{
+    Restart();
+    std::lock_guard<std::mutex> L(Lock);
+    std::fill(Acc.begin(), Acc.end(), 0.0);
+    nSegments = 0;
+}
+
+void EVM_Welch::Restart()
+{
+    Pos = 0;
+    Filled = 0;
+    Since = 0;
+}
+
+void EVM_Welch::Feed(const int* Codes, long Rows, long Stride)
+{
+    if (!Active()) return;
+
+    for (long r = 0; r < Rows; r++, Codes += Stride)
+    {
+        int* Row = &History[(size_t)Pos * Channels];
+        for (int c = 0; c < Channels; c++) Row[c] = Codes[c] & Mask;
+        if (++Pos == Length) Pos = 0;
+        if (Filled < Length) Filled++;
+
+        // A segment every Length / 2 rows once the history is full
+        if (++Since >= Length / 2 && Filled == Length)
+        {
+            Segment();
+            Since = 0;
+        }
+    }
+}
+
+// Transforms the Length rows held, oldest first, and adds their power to Acc
+void EVM_Welch::Segment()
+{
+    const EVM_FFTPlan& P = *Plan;
+    const int Half = P.Half;
+
+    for (int c0 = 0; c0 < Channels; c0 += TILE)
+    {
+        int Tile = min(TILE, Channels - c0);
+
+        for (int c = 0; c < Tile; c++) Mean[c] = 0;
+        for (int n = 0; n < Length; n++)
+        {
+            const int* Row = &History[(size_t)n * Channels + c0];
+            for (int c = 0; c < Tile; c++) Mean[c] += Row[c];
+        }
+        for (int c = 0; c < Tile; c++) Mean[c] /= Length;
+
+        // Even samples into the real part, odd into the imaginary one
+        for (int m = 0; m < Half; m++)
+        {
+            long r0 = (Pos + 2 * m) % Length;
+            long r1 = (Pos + 2 * m + 1) % Length;
+            const int* Row0 = &History[(size_t)r0 * Channels + c0];
+            const int* Row1 = &History[(size_t)r1 * Channels + c0];
+            double w0 = P.Window[2 * m], w1 = P.Window[2 * m + 1];
+            for (int c = 0; c < Tile; c++)
+            {
+                Re[m * Tile + c] = (Row0[c] - Mean[c]) * w0;
+                Im[m * Tile + c] = (Row1[c] - Mean[c]) * w1;
+            }
+        }
+
+        BatchFFT(P, Re.data(), Im.data(), Tile);
+
+        // X[k] = E[k] + W^k O[k], E and O recovered from Z[k] and conj(Z[Half - k])
+        for (int k = 0; k <= Half; k++)
+        {
+            int a = (k == Half) ? 0 : k;
+            int b = (k == 0) ? 0 : Half - k;
+            for (int c = 0; c < Tile; c++)
+            {
+                double zr = Re[a * Tile + c], zi = Im[a * Tile + c];
+                double yr = Re[b * Tile + c], yi = -Im[b * Tile + c];
+                double er = 0.5 * (zr + yr), ei = 0.5 * (zi + yi);
+                double or_ = 0.5 * (zi - yi), oi = -0.5 * (zr - yr);
+                double xr = er + P.SplitRe[k] * or_ - P.SplitIm[k] * oi;
+                double xi = ei + P.SplitRe[k] * oi + P.SplitIm[k] * or_;
+                Power[(size_t)c * (Half + 1) + k] = xr * xr + xi * xi;
+            }
+        }
+
+        std::lock_guard<std::mutex> L(Lock);
+        for (int c = 0; c < Tile; c++)
+        {
+            double* A = &Acc[(size_t)(c0 + c) * (Half + 1)];
+            const double* Pw = &Power[(size_t)c * (Half + 1)];
+            for (int k = 0; k <= Half; k++) A[k] += Pw[k];
+        }
+    }
+
+    std::lock_guard<std::mutex> L(Lock);
+    nSegments++;
+}
+
+long EVM_Welch::Get(double* Psd, double SampleRate, double Gain)
+{
+    if (!Active()) return 0;
+
+    const int Bins = Length / 2 + 1;
+    std::lock_guard<std::mutex> L(Lock);
+    if (nSegments == 0)
+    {
+        memset(Psd, 0, sizeof(double) * Channels * Bins);
+        return 0;
+    }
+
+    // One sided: every bin but DC and Nyquist holds the power of its negative frequency too
+    double Scale = Gain * Gain / (SampleRate * Plan->WindowPower * nSegments);
+    for (int c = 0; c < Channels; c++)
+    {
+        const double* A = &Acc[(size_t)c * Bins];
+        double* Out = Psd + (size_t)c * Bins;
+        for (int k = 0; k < Bins; k++) Out[k] = A[k] * Scale * ((k == 0 || k == Bins - 1) ? 1 : 2);
+    }
+    return nSegments;
+}
+
+//===================================================================================================================
+
+void EVM_PsdScale(const byte* CFGHIGH, int Channels, int& Mask, double& Gain)
+{
+    Mask = 0xFFFFFF;
+    Gain = 1.0;
+    if (CFGHIGH == nullptr) return;
+
+    EVM_Conversion Conv = EVM_MakeConversion(EVM_SAMPLE_FLOAT64, *CFGHIGH, Channels);
+    Mask = (Conv.Format == EVM_DECODE_16BIT) ? 0xFFFF : 0xFFFFF;
+    Gain = Conv.Gain;
+}
+
+// Welch PSD of every channel of a capture as returned by EVM_DataCap: nDVALIDReads rows of Channels codes,
+// sides A and B alternating from AorBfirst. PSD receives 2 x Channels x (SegmentLength / 2 + 1) values,
+// side A first, in pC^2/Hz (code^2/Hz if CFGHIGH is null); bin k is at k * DVALIDRate / (2 * SegmentLength) Hz.
+// Returns the segments averaged per side. Plans and buffers are kept for the next call of the same thread.
+long __stdcall EVM_ComputePSD(int* DataArray, int Channels, int nDVALIDReads, int AorBfirst, int SegmentLength,
+                              byte* CFGHIGH, double DVALIDRate, double* PSD)
+{
+    if (DataArray == nullptr || PSD == nullptr || Channels <= 0 || nDVALIDReads <= 0 || DVALIDRate <= 0) return(-7);
+    if (AorBfirst != 0 && AorBfirst != 1) return(-7);
+
+    int Mask;
+    double Gain;
+    EVM_PsdScale(CFGHIGH, Channels, Mask, Gain);
+
+    thread_local EVM_Welch Side[2];
+    long Segments = LONG_MAX;
+    const size_t SideBins = (size_t)Channels * (SegmentLength / 2 + 1);
+    for (int s = 0; s < 2; s++)
+    {
+        // Side s holds rows First, First + 2...
+        int First = (s == AorBfirst) ? 0 : 1;
+        if (!Side[s].Setup(Channels, SegmentLength, Mask)) return(-7);
+        if (nDVALIDReads > First) Side[s].Feed(DataArray + (size_t)First * Channels, (nDVALIDReads - First + 1) / 2, 2L * Channels);
+        Segments = min(Segments, Side[s].Get(PSD + s * SideBins, DVALIDRate / 2, Gain));
+    }
+    return(Segments);
+}
@@ -0,0 +1,75 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ *
+ * Noise power spectral density of every channel, Welch averaged: Hann windowed segments
+ * with 50% overlap, mean removed. The real FFTs of a tile of channels run together, the
+ * butterflies looping over the channels, and the FFT plans are shared by every estimator
+ * of the same segment length.
+ */
+
+#ifndef EVM_SPECTRUM_H
+#define EVM_SPECTRUM_H
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct EVM_FFTPlan;
+
+class EVM_Welch
+{
+public:
+    EVM_Welch();
+    ~EVM_Welch();
+
+    // Channels codes per row, Length a power of 2 from 16 to 32768, Mask the bits of the code.
+    // Buffers are kept when the sizes don't change. Clears the estimate. Returns false if invalid.
+    bool Setup(int Channels, int Length, int Mask);
+    bool Active() const { return Length > 0; }
+
+    // Clears the estimate and the rows held
+    void Reset();
+
+    // Forgets the rows held after a gap in the data, keeping the estimate
+    void Restart();
+
+    // Adds Rows rows of Channels codes, Stride codes apart
+    void Feed(const int* Codes, long Rows, long Stride);
+
+    // Writes the one sided PSD, Channels x (Length / 2 + 1) bins, in Gain^2 / Hz for rows SampleRate
+    // apart. Returns the segments averaged.
+    long Get(double* Psd, double SampleRate, double Gain);
+
+private:
+    EVM_Welch(const EVM_Welch&);
+    EVM_Welch& operator=(const EVM_Welch&);
+
+    void Segment();
+
+    std::shared_ptr<const EVM_FFTPlan> Plan;
+    int Channels;
+    int Length;
+    int Mask;
+    std::vector<int> History;   // Last Length rows, a ring
+    long Pos;                   // Next row of History
+    long Filled;
+    long Since;                 // Rows since the last segment
+    std::vector<double> Re, Im; // Length / 2 x tile of channels
+    std::vector<double> Mean;
+    std::vector<double> Power;  // Tile of channels x bins
+    std::mutex Lock;            // Guards Acc and nSegments, read while the stream feeds
+    std::vector<double> Acc;    // Channels x bins, sum of |X|^2
+    long nSegments;
+};
+
+// Bits of the code and pC per code for CFGHIGH; all 24 bits and 1 (PSD in codes) if it is null
+void EVM_PsdScale(const byte* CFGHIGH, int Channels, int& Mask, double& Gain);
+
+#endif // EVM_SPECTRUM_H
@@ -0,0 +1,300 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ */
+
+#include "StdAfx.h"
+#include "DDC264EVM_IO.h"
+#include "EVM_Registers.h"
+#include "EVM_Timing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+// Weight of the nominal rate against the fit, as a frame spanning 10 ms would have
+static const double PRIOR_WEIGHT = 1e-4;
+
+// Share of the drift evidence of the previous frames kept at each new frame
+static const double POOL_DECAY = 0.9;
+
+// Transfers and handovers the latency percentiles are taken over, and frames drawn from each transfer
+static const size_t LATENCY_HISTORY = 4096;
+static const int LATENCY_DRAWS = 64;
+
+// Timebase of EVM_SetTimebase and the CONV registers last read back
+static struct
+{
+    std::mutex Lock;
+    double ClockHz = 0;
+    long ConvLow = 0;
+    long ConvHigh = 0;
+} Timebase;
+
+double EVM_Now()
+{
+    static double Scale = [] {
+        LARGE_INTEGER Freq;
+        QueryPerformanceFrequency(&Freq);
+        return 1.0 / (double)Freq.QuadPart;
+    }();
+    LARGE_INTEGER Count;
+    QueryPerformanceCounter(&Count);
+    return (double)Count.QuadPart * Scale;
+}
+
+void EVM_NoteConvRegisters(const int* Regs)
+{
+    std::lock_guard<std::mutex> L(Timebase.Lock);
+    Timebase.ConvLow = EVM_CONV_LOW::Get(Regs);
+    Timebase.ConvHigh = EVM_CONV_HIGH::Get(Regs);
+}
+
+EVM_TimingFit::EVM_TimingFit() : Channels(1), Known(false), PeriodA(1), PeriodB(1), AorB(0), Transfers(0), First(0), Last(0),
+    n(0), X0(0), Y0(0), Sx(0), Sy(0), Sxx(0), Sxy(0), PoolSxx(0), PoolSxy(0)
+{
+}
+
+void EVM_TimingFit::Reset(int Channels)
+{
+    {
+        std::lock_guard<std::mutex> L(Timebase.Lock);
+        Known = (Timebase.ClockHz > 0 && Timebase.ConvLow > 0 && Timebase.ConvHigh > 0);
+        // The registers hold the counts minus one, as the demo writes CONV_HIGH_INT - 1
+        PeriodA = Known ? (Timebase.ConvHigh + 1) / Timebase.ClockHz : 1.0;
+        PeriodB = Known ? (Timebase.ConvLow + 1) / Timebase.ClockHz : 1.0;
+    }
+    this->Channels = max(Channels, 1);
+    AorB = 0;
+    Transfers = 0;
+    First = Last = 0;
+    n = 0;
+    PoolSxx = PoolSxy = 0;
+}
+
+void EVM_TimingFit::NewFrame(int AorB)
+{
+    // Only the slope within each frame says anything about the drift, the frames start at unrelated times
+    if (n > 1)
+    {
+        PoolSxx = PoolSxx * POOL_DECAY + (Sxx - Sx * Sx / n);
+        PoolSxy = PoolSxy * POOL_DECAY + (Sxy - Sx * Sy / n);
+    }
+    this->AorB = AorB & 1;
+    n = 0;
+    Sx = Sy = Sxx = Sxy = 0;
+}
+
+// Nominal time from DVALID 0 to DVALID Row, or Row itself without a timebase
+double EVM_TimingFit::Nominal(long long Row) const
+{
+    // DVALIDs 1 to Row of side A: the even ones if DVALID 0 is of side A, the odd ones otherwise
+    long long A = (AorB == 0) ? Row / 2 : (Row + 1) / 2;
+    return A * PeriodA + (Row - A) * PeriodB;
+}
+
+// Host seconds per nominal second, 1 + drift; or seconds per DVALID without a timebase, 0 while unknown
+double EVM_TimingFit::Slope() const
+{
+    double Sxxc = PoolSxx + ((n > 1) ? Sxx - Sx * Sx / n : 0);
+    double Sxyc = PoolSxy + ((n > 1) ? Sxy - Sx * Sy / n : 0);
+    double W = Known ? PRIOR_WEIGHT : 0;
+    if (Sxxc + W <= 0) return Known ? 1.0 : 0.0;
+    return (Sxyc + W * (Known ? 1.0 : 0.0)) / (Sxxc + W);
+}
+
+// The transfer that completes with Words words of the frame holds DVALIDs up to Words / Channels - 1
+void EVM_TimingFit::Add(long long Words, double Stamp)
+{
+    long long Row = Words / Channels - 1;
+    if (Row < 0) return;
+
+    if (Transfers == 0) First = Stamp;
+    Last = Stamp;
+    Transfers++;
+
+    double x = Nominal(Row);
+    if (n == 0)
+    {
+        X0 = x;
+        Y0 = Stamp;
+    }
+    x -= X0;
+    double y = Stamp - Y0;
+    n++;
+    Sx += x;
+    Sy += y;
+    Sxx += x * x;
+    Sxy += x * y;
+}
+
+double EVM_TimingFit::Time(long long Row) const
+{
+    if (n == 0) return 0;
+    double b = Slope();
+    // Fitted line through the means of the frame
+    double Start = Y0 + (Sy - b * Sx) / n - b * X0;
+    return Start + b * Nominal(Row);
+}
+
+void EVM_TimingFit::Get(EVM_Timing* Timing) const
+{
+    double b = Slope();
+    Timing->FirstTransfer = First;
+    Timing->LastTransfer = Last;
+    Timing->Transfers = Transfers;
+    Timing->AorB = AorB;
+    Timing->Start = Time(0);
+    Timing->PeriodA = b * PeriodA;
+    Timing->PeriodB = b * PeriodB;
+    Timing->Drift = Known ? b - 1.0 : 0.0;
+}
+
+EVM_TimingFit& EVM_CaptureTiming()
+{
+    thread_local EVM_TimingFit Fit;
+    return Fit;
+}
+
+EVM_LatencyMeter::EVM_LatencyMeter()
+{
+    Reset();
+}
+
+void EVM_LatencyMeter::Reset()
+{
+    std::lock_guard<std::mutex> L(Lock);
+    Arrivals.resize(LATENCY_HISTORY);
+    Handovers.resize(LATENCY_HISTORY);
+    nArrivals = nHandovers = 0;
+    Frames = 0;
+    K0 = 0;
+    Y0 = 0;
+    n = Sx = Sy = Sxx = Sxy = 0;
+}
+
+void EVM_LatencyMeter::Add(long long Last, int Count, double Stamp)
+{
+    std::lock_guard<std::mutex> L(Lock);
+    if (n == 0)
+    {
+        K0 = Last;
+        Y0 = Stamp;
+    }
+    double x = (double)(Last - K0), y = Stamp - Y0;
+    n++;
+    Sx += x;
+    Sy += y;
+    Sxx += x * x;
+    Sxy += x * y;
+
+    Arrival& A = Arrivals[nArrivals++ % LATENCY_HISTORY];
+    A.Last = Last;
+    A.n = Count;
+    A.Stamp = Stamp;
+    Frames += Count;
+}
+
+void EVM_LatencyMeter::Handover(double Delay)
+{
+    std::lock_guard<std::mutex> L(Lock);
+    Handovers[nHandovers++ % LATENCY_HISTORY] = (float)Delay;
+}
+
+static double Percentile(std::vector<float>& v, double p)
+{
+    if (v.empty()) return(0);
+    size_t k = min((size_t)(p * v.size()), v.size() - 1);
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+void EVM_LatencyMeter::Get(EVM_Latency* Latency)
+{
+    std::lock_guard<std::mutex> L(Lock);
+    memset(Latency, 0, sizeof(*Latency));
+    Latency->Frames = Frames;
+
+    std::vector<float> Values;
+    double Det = n * Sxx - Sx * Sx;
+    if (n >= 2 && Det > 0)
+    {
+        // The line through the earliest transfer: no transfer comes before it
+        double b = (n * Sxy - Sx * Sy) / Det;
+        size_t Count = min(nArrivals, LATENCY_HISTORY);
+        double Floor = 0;
+        for (size_t i = 0; i < Count; i++)
+        {
+            double r = Arrivals[i].Stamp - Y0 - b * (double)(Arrivals[i].Last - K0);
+            Floor = (i == 0) ? r : min(Floor, r);
+        }
+
+        // The frames of a transfer waited for the ones after them, evenly spread
+        double Sum = 0;
+        long long Drawn = 0;
+        for (size_t i = 0; i < Count; i++)
+        {
+            const Arrival& A = Arrivals[i];
+            double Newest = A.Stamp - Y0 - b * (double)(A.Last - K0) - Floor;
+            int Draws = min(A.n, LATENCY_DRAWS);
+            for (int d = 0; d < Draws; d++)
+            {
+                double Back = (Draws > 1) ? (double)d * (A.n - 1) / (Draws - 1) : 0;
+                double v = Newest + b * Back;
+                Values.push_back((float)v);
+                Sum += v;
+                Drawn++;
+            }
+        }
+        Latency->Period = b;
+        Latency->Mean = Sum / Drawn;
+        Latency->Max = *std::max_element(Values.begin(), Values.end());
+        Latency->P50 = Percentile(Values, 0.5);
+        Latency->P90 = Percentile(Values, 0.9);
+        Latency->P99 = Percentile(Values, 0.99);
+        Latency->P999 = Percentile(Values, 0.999);
+    }
+
+    std::vector<float> Delays(Handovers.begin(), Handovers.begin() + min(nHandovers, LATENCY_HISTORY));
+    Latency->Handover50 = Percentile(Delays, 0.5);
+    Latency->Handover99 = Percentile(Delays, 0.99);
+}
+
+//===================================================================================================================
+
+// Sets the clock of the CONV_LOW/CONV_HIGH counts, in Hz, used to time the following captures and streams.
+// The registers hold each count minus one, a side lasts CONV + 1 clocks.
+// Regs holds the register values as in EVM_RegsTransfer, null for the ones last read back by it. With
+// ClockHz 0 the DVALID period is only measured from the transfer times.
+long __stdcall EVM_SetTimebase(double ClockHz, int* Regs)
+{
+    if (ClockHz < 0) return(-7);
+    if (Regs != nullptr) EVM_NoteConvRegisters(Regs);
+
+    std::lock_guard<std::mutex> L(Timebase.Lock);
+    Timebase.ClockHz = ClockHz;
+    return(0);
+}
+
+// Estimated time of DVALID Row of the frame described by Timing, in seconds of the performance counter
+double __stdcall EVM_SampleTime(EVM_Timing* Timing, long long Row)
+{
+    // DVALIDs 1 to Row of side A, as in EVM_TimingFit::Nominal
+    long long A = (Timing->AorB == 0) ? Row / 2 : (Row + 1) / 2;
+    return Timing->Start + A * Timing->PeriodA + (Row - A) * Timing->PeriodB;
+}
+
+// Timing of the last capture taken by the calling thread with EVM_DataCap, EVM_DataCapEx, EVM_DataCapROI,
+// EVM_ConfigureAndCapture or EVM_DataCapBatch (its last frame). Returns the transfers stamped.
+long __stdcall EVM_GetCaptureTiming(EVM_Timing* Timing)
+{
+    if (Timing == nullptr) return(-7);
+    EVM_CaptureTiming().Get(Timing);
+    return(Timing->Transfers);
+}
@@ -0,0 +1,112 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ *
+ * Time of the samples. Every transfer is stamped with the performance counter when it
+ * completes, and the stamps are fitted against the DVALIDs received: the nominal DVALID
+ * periods come from CONV_HIGH (side A) and CONV_LOW (side B) at the timebase clock, and
+ * the fit corrects their rate (the drift, pooled over the frames) and places DVALID 0 of
+ * the frame. Without a timebase the fit gives the period itself.
+ */
+
+#ifndef EVM_TIMING_H
+#define EVM_TIMING_H
+
+#include <mutex>
+#include <vector>
+
+// Seconds of the performance counter
+double EVM_Now();
+
+// Keeps the CONV_LOW/CONV_HIGH values of a register readback for EVM_SetTimebase
+void EVM_NoteConvRegisters(const int* Regs);
+
+class EVM_TimingFit
+{
+public:
+    EVM_TimingFit();
+
+    // Takes the nominal periods of the timebase and clears the estimate for rows of Channels words
+    void Reset(int Channels);
+
+    // Starts a frame whose DVALID 0 is of side AorB. The drift carries over from the previous frames.
+    void NewFrame(int AorB);
+
+    // Adds the time a transfer completed with Words words of the frame received
+    void Add(long long Words, double Stamp);
+
+    // Estimated time of DVALID Row of the current frame
+    double Time(long long Row) const;
+
+    void Get(EVM_Timing* Timing) const;
+
+private:
+    double Nominal(long long Row) const;
+    double Slope() const;
+
+    int Channels;
+    bool Known;       // Nominal periods set
+    double PeriodA;
+    double PeriodB;
+    int AorB;
+    int Transfers;
+    double First;
+    double Last;
+
+    // Current frame, x and y relative to its first point
+    int n;
+    double X0, Y0;
+    double Sx, Sy, Sxx, Sxy;
+
+    // Earlier frames, centered on each frame's means and decayed
+    double PoolSxx, PoolSxy;
+};
+
+// Timing of the last capture of the calling thread, filled by the capture calls
+EVM_TimingFit& EVM_CaptureTiming();
+
+// Latency of the frames of a continuous conversion, see EVM_Latency. The transfer times are fitted
+// against the frame numbers; the earliest transfer relative to that line is taken as no latency.
+class EVM_LatencyMeter
+{
+public:
+    EVM_LatencyMeter();
+
+    void Reset();
+
+    // Frames Last - Count + 1 to Last, counted from the start, reached the host at Stamp
+    void Add(long long Last, int Count, double Stamp);
+
+    // The caller got a frame Delay seconds after it reached the host
+    void Handover(double Delay);
+
+    void Get(EVM_Latency* Latency);
+
+private:
+    struct Arrival
+    {
+        long long Last;
+        int n;
+        double Stamp;
+    };
+
+    std::mutex Lock;
+    std::vector<Arrival> Arrivals;      // The last ones, a ring
+    size_t nArrivals;
+    std::vector<float> Handovers;       // Same
+    size_t nHandovers;
+    long long Frames;
+
+    // Fit of the stamps against the last frame of each transfer, relative to the first
+    long long K0;
+    double Y0;
+    double n, Sx, Sy, Sxx, Sxy;
+};
+
+#endif // EVM_TIMING_H
@@ -0,0 +1,174 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ */
+
+#include "StdAfx.h"
+#include "DDC264EVM_IO.h"
+#include "EVM_Timing.h"
+#include "EVM_Trace.h"
+
+#ifdef EVM_TRACE
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Ring of one thread. Only that thread writes it and Count is published after each event, so the exporter
+// reads whole events except the ones overwritten while it reads.
+struct EVM_TraceRing
+{
+    EVM_TraceEvent Events[EVM_TRACE_EVENTS];
+    std::atomic<long long> Count;
+    std::atomic<bool> InUse;
+    DWORD Thread;
+    const char* Name;
+};
+
+static std::mutex RingsLock;
+static std::vector<std::unique_ptr<EVM_TraceRing>> Rings;
+static std::atomic<double> Since(0);
+
+// Gives the ring back when its thread exits, the next thread goes on with it
+struct EVM_TraceOwner
+{
+    EVM_TraceRing* Ring = nullptr;
+    ~EVM_TraceOwner() { if (Ring != nullptr) Ring->InUse = false; }
+};
+
+static thread_local EVM_TraceOwner Owner;
+
+static EVM_TraceRing* OwnRing()
+{
+    if (Owner.Ring != nullptr) return(Owner.Ring);
+
+    std::lock_guard<std::mutex> L(RingsLock);
+    for (auto& R : Rings)
+    {
+        if (!R->InUse)
+        {
+            Owner.Ring = R.get();
+            break;
+        }
+    }
+    if (Owner.Ring == nullptr)
+    {
+        Rings.emplace_back(new EVM_TraceRing());
+        Owner.Ring = Rings.back().get();
+        Owner.Ring->Count = 0;
+    }
+    Owner.Ring->InUse = true;
+    Owner.Ring->Thread = GetCurrentThreadId();
+    Owner.Ring->Name = nullptr;
+    return(Owner.Ring);
+}
+
+void EVM_TraceRecord(const char* Name, double Begin, double End, long long Arg)
+{
+    EVM_TraceRing* R = OwnRing();
+    long long n = R->Count.load(std::memory_order_relaxed);
+    EVM_TraceEvent& E = R->Events[n % EVM_TRACE_EVENTS];
+    E.Name = Name;
+    E.Begin = Begin;
+    E.End = End;
+    E.Arg = Arg;
+    E.Thread = R->Thread;
+    R->Count.store(n + 1, std::memory_order_release);
+}
+
+void EVM_TraceThread(const char* Name)
+{
+    OwnRing()->Name = Name;
+}
+
+// One trace event object, Chrome timestamps are in microseconds
+static void Append(std::string& Json, const EVM_TraceEvent& E, DWORD Process)
+{
+    char Line[256];
+    if (E.End > E.Begin)
+    {
+        snprintf(Line, sizeof(Line), "{\"name\":\"%s\",\"cat\":\"evm\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%lu,\"tid\":%lu",
+                 E.Name, E.Begin * 1e6, (E.End - E.Begin) * 1e6, (unsigned long)Process, (unsigned long)E.Thread);
+    }
+    else
+    {
+        snprintf(Line, sizeof(Line), "{\"name\":\"%s\",\"cat\":\"evm\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%lu,\"tid\":%lu",
+                 E.Name, E.Begin * 1e6, (unsigned long)Process, (unsigned long)E.Thread);
+    }
+    Json += Line;
+    if (E.Arg >= 0)
+    {
+        snprintf(Line, sizeof(Line), ",\"args\":{\"n\":%lld}", E.Arg);
+        Json += Line;
+    }
+    Json += "}";
+}
+
+#endif
+
+// Writes the events recorded since EVM_TraceClear to Path as Chrome trace event JSON, for ui.perfetto.dev or
+// chrome://tracing. Returns the events written, -17 if the file can't be written, 0 without writing it when the
+// DLL is built without EVM_TRACE. Events recorded while it runs may come out torn, save once the capture is over.
+long __stdcall EVM_TraceSave(char* Path)
+{
+#ifdef EVM_TRACE
+    if (Path == nullptr) return(-7);
+
+    const DWORD Process = GetCurrentProcessId();
+    const double From = Since.load();
+    std::string Json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    long Written = 0;
+    bool First = true;
+    char Line[256];
+    {
+        std::lock_guard<std::mutex> L(RingsLock);
+        for (auto& R : Rings)
+        {
+            if (R->Name != nullptr)
+            {
+                snprintf(Line, sizeof(Line), "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%lu,\"tid\":%lu,\"args\":{\"name\":\"%s\"}}",
+                         First ? "" : ",", (unsigned long)Process, (unsigned long)R->Thread, R->Name);
+                Json += Line;
+                First = false;
+            }
+            const long long Count = R->Count.load(std::memory_order_acquire);
+            for (long long i = max(0LL, Count - EVM_TRACE_EVENTS); i < Count; i++)
+            {
+                const EVM_TraceEvent E = R->Events[i % EVM_TRACE_EVENTS];
+                if (E.Begin < From) continue;
+                Json += First ? "\n" : ",\n";
+                Append(Json, E, Process);
+                First = false;
+                Written++;
+            }
+        }
+    }
+    Json += "\n]}\n";
+
+    HANDLE File = CreateFileA(Path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (File == INVALID_HANDLE_VALUE) return(-17);
+    DWORD Done = 0;
+    bool Ok = WriteFile(File, Json.data(), (DWORD)Json.size(), &Done, NULL) && Done == Json.size();
+    CloseHandle(File);
+    return Ok ? Written : -17;
+#else
+    return(0);
+#endif
+}
+
+// Forgets the events recorded so far
+void __stdcall EVM_TraceClear()
+{
+#ifdef EVM_TRACE
+    Since = EVM_Now();
+#endif
+}
@@ -0,0 +1,72 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ *
+ * Timeline tracing of the acquisition phases. With EVM_TRACE defined for the whole project
+ * every EVM_TRACE_SCOPE records when its block began and ended into a ring of the calling
+ * thread, which only that thread writes: no lock and no allocation on the transfer path.
+ * EVM_TraceSave exports the rings as Chrome trace events, to open in ui.perfetto.dev or
+ * chrome://tracing. Without EVM_TRACE the macros expand to nothing.
+ */
+
+#ifndef EVM_TRACE_H
+#define EVM_TRACE_H
+
+//#define EVM_TRACE
+
+#ifdef EVM_TRACE
+
+#include "EVM_Timing.h"
+
+// Events kept per thread, the oldest are overwritten
+const int EVM_TRACE_EVENTS = 16384;
+
+struct EVM_TraceEvent
+{
+    const char* Name;       // String literal, without quotes
+    double Begin;           // EVM_Now seconds
+    double End;             // Same as Begin for an instant
+    long long Arg;          // Bytes or count of the phase, -1 for none
+    DWORD Thread;
+};
+
+// Records an event into the ring of the calling thread
+void EVM_TraceRecord(const char* Name, double Begin, double End, long long Arg);
+
+// Names the calling thread in the exported timeline
+void EVM_TraceThread(const char* Name);
+
+// Records the time the enclosing block took, with an optional argument set meanwhile
+class EVM_TraceScope
+{
+public:
+    explicit EVM_TraceScope(const char* Name, long long Arg = -1) : Name(Name), Arg(Arg), Begin(EVM_Now()) {}
+    ~EVM_TraceScope() { EVM_TraceRecord(Name, Begin, EVM_Now(), Arg); }
+    void SetArg(long long Value) { Arg = Value; }
+
+private:
+    const char* Name;
+    long long Arg;
+    double Begin;
+};
+
+  #define EVM_TRACE_JOIN2(A, B) A##B
+  #define EVM_TRACE_JOIN(A, B) EVM_TRACE_JOIN2(A, B)
+  #define EVM_TRACE_SCOPE(NAME) EVM_TraceScope EVM_TRACE_JOIN(TraceScope, __LINE__)(NAME)
+  #define EVM_TRACE_SCOPE_ARG(NAME, ARG) EVM_TraceScope EVM_TRACE_JOIN(TraceScope, __LINE__)(NAME, (long long)(ARG))
+  #define EVM_TRACE_MARK(NAME, ARG) { double Now = EVM_Now(); EVM_TraceRecord(NAME, Now, Now, (long long)(ARG)); }
+  #define EVM_TRACE_THREAD(NAME) EVM_TraceThread(NAME)
+#else
+  #define EVM_TRACE_SCOPE(NAME) {}
+  #define EVM_TRACE_SCOPE_ARG(NAME, ARG) {}
+  #define EVM_TRACE_MARK(NAME, ARG) {}
+  #define EVM_TRACE_THREAD(NAME) {}
+#endif
+
+#endif // EVM_TRACE_H
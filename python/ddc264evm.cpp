@@ -0,0 +1,664 @@
+/**
+ * Acquisition library for the DDC264 Evaluation Module
+ * https://www.ti.com/tool/DDC264EVM
+ *
+ * Author: Miguel Risco-Castillo
+ * Version: 3.3
+ * Date: 2024/02/27
+ *
+ * LICENSE: MIT License.
+ *
+ * Python binding of DDC264EVM_IO. Captures and stream buffers are exported through the
+ * buffer protocol with a (channel, DVALID) shape, so numpy.asarray() wraps them without
+ * a copy. Stream buffers stay owned by the DLL and go back to the session when the last
+ * array viewing them is released.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <windows.h>
+
+// Declared as the DLL itself compiles them: the import library maps these C++ names to the undecorated
+// exports of DDC264EVM_IO.def
+#include "../DDC264EVM_IO.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static PyObject* EVMError;
+
+static const char* ErrorText(long Code)
+{
+    switch (Code)
+    {
+    case -1: case -2: return "board could not be opened";
+    case -3: return "out of memory";
+    case -4: return "timeout";
+    case -5: return "transfer failed";
+    case -6: return "conversions could not be stopped";
+    case -7: return "invalid arguments";
+    case -8: return "transfer not a multiple of 4 bytes";
+    case -9: return "no bulk out endpoint";
+    case -10: return "no bulk in endpoint";
+    case -11: return "register readback mismatch";
+    case -12: return "frame not captured";
+    case -13: return "end of stream";
+    case -14: return "stream running";
+    case -15: return "invalid buffer index";
+    }
+    return "error";
+}
+
+static PyObject* RaiseError(long Code)
+{
+    PyObject* Args = Py_BuildValue("(ls)", Code, ErrorText(Code));
+    if (Args != NULL)
+    {
+        PyErr_SetObject(EVMError, Args);
+        Py_DECREF(Args);
+    }
+    return NULL;
+}
+
+static const char* FormatOf(int SampleType)
+{
+    switch (SampleType & EVM_SAMPLE_TYPE_MASK)
+    {
+    case EVM_SAMPLE_INT32: return "i";
+    case EVM_SAMPLE_UINT16: return "H";
+    case EVM_SAMPLE_FLOAT32: return "f";
+    case EVM_SAMPLE_FLOAT64: return "d";
+    }
+    return NULL;
+}
+
+static Py_ssize_t ItemSize(int SampleType)
+{
+    switch (SampleType & EVM_SAMPLE_TYPE_MASK)
+    {
+    case EVM_SAMPLE_UINT16: return 2;
+    case EVM_SAMPLE_FLOAT64: return 8;
+    }
+    return 4;
+}
+
+// The DLL writes channel major buffers when it can, (channel, DVALID) is then C contiguous.
+// Otherwise the interleaved buffer is described with strides.
+static int LayoutFor(int Width, bool Roi)
+{
+    bool PowerOf2 = Width > 0 && Width <= 256 && (Width & (Width - 1)) == 0;
+    return (Roi || PowerOf2) ? EVM_LAYOUT_CHANNEL_MAJOR : EVM_LAYOUT_INTERLEAVED;
+}
+
+// Shape and strides of a (channel, DVALID) view of Rows rows of Width samples
+struct View
+{
+    Py_ssize_t Shape[2];
+    Py_ssize_t Strides[2];
+    int SampleType;
+
+    void Set(int Width, long Rows, int Type)
+    {
+        Py_ssize_t Item = ItemSize(Type);
+        SampleType = Type;
+        Shape[0] = Width;
+        Shape[1] = Rows;
+        if ((Type & EVM_LAYOUT_MASK) == EVM_LAYOUT_CHANNEL_MAJOR)
+        {
+            Strides[0] = Rows * Item;
+            Strides[1] = Item;
+        }
+        else
+        {
+            Strides[0] = Item;
+            Strides[1] = Width * Item;
+        }
+    }
+
+    bool Contiguous() const { return Shape[1] <= 1 || Strides[1] == ItemSize(SampleType); }
+};
+
+static int FillBuffer(PyObject* Exporter, Py_buffer* Buf, int Flags, void* Data, View& V, bool ReadOnly)
+{
+    if ((Flags & PyBUF_WRITABLE) == PyBUF_WRITABLE && ReadOnly)
+    {
+        PyErr_SetString(PyExc_BufferError, "buffer is read only");
+        return -1;
+    }
+    if ((Flags & PyBUF_STRIDES) != PyBUF_STRIDES && !V.Contiguous())
+    {
+        PyErr_SetString(PyExc_BufferError, "interleaved buffer needs strides");
+        return -1;
+    }
+
+    Buf->buf = Data;
+    Buf->obj = Exporter;
+    Py_INCREF(Exporter);
+    Buf->itemsize = ItemSize(V.SampleType);
+    Buf->len = V.Shape[0] * V.Shape[1] * Buf->itemsize;
+    Buf->readonly = ReadOnly ? 1 : 0;
+    Buf->format = (Flags & PyBUF_FORMAT) ? (char*)FormatOf(V.SampleType) : NULL;
+    Buf->ndim = 2;
+    Buf->shape = (Flags & PyBUF_ND) ? V.Shape : NULL;
+    Buf->strides = ((Flags & PyBUF_STRIDES) == PyBUF_STRIDES) ? V.Strides : NULL;
+    Buf->suboffsets = NULL;
+    Buf->internal = NULL;
+    return 0;
+}
+
+static bool ParseRoi(PyObject* Roi, int** List, int* Count)
+{
+    *List = NULL;
+    *Count = 0;
+    if (Roi == NULL || Roi == Py_None) return true;
+
+    PyObject* Seq = PySequence_Fast(Roi, "roi must be a sequence of channel numbers");
+    if (Seq == NULL) return false;
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(Seq);
+    *List = (int*)malloc((n > 0 ? n : 1) * sizeof(int));
+    if (*List == NULL)
+    {
+        Py_DECREF(Seq);
+        PyErr_NoMemory();
+        return false;
+    }
+    for (Py_ssize_t i = 0; i < n; i++)
+    {
+        long c = PyLong_AsLong(PySequence_Fast_GET_ITEM(Seq, i));
+        if (c == -1 && PyErr_Occurred())
+        {
+            Py_DECREF(Seq);
+            free(*List);
+            *List = NULL;
+            return false;
+        }
+        (*List)[i] = (int)c;
+    }
+    Py_DECREF(Seq);
+    *Count = (int)n;
+    return true;
+}
+
+//===================================================================================================================
+// Capture: the samples of one EVM_DataCapEx call
+
+typedef struct
+{
+    PyObject_HEAD
+    void* Data;
+    View V;
+    int AorB;
+} CaptureObject;
+
+static void Capture_dealloc(CaptureObject* Self)
+{
+    free(Self->Data);
+    Py_TYPE(Self)->tp_free((PyObject*)Self);
+}
+
+static int Capture_getbuffer(CaptureObject* Self, Py_buffer* Buf, int Flags)
+{
+    return FillBuffer((PyObject*)Self, Buf, Flags, Self->Data, Self->V, false);
+}
+
+static PyObject* Capture_aorb(CaptureObject* Self, void*)
+{
+    return PyLong_FromLong(Self->AorB);
+}
+
+static PyBufferProcs Capture_buffer = { (getbufferproc)Capture_getbuffer, NULL };
+
+static PyGetSetDef Capture_getset[] = {
+    { "aorb", (getter)Capture_aorb, NULL, "0 if the first DVALID is from side A, 1 if from side B", NULL },
+    { NULL }
+};
+
+static PyTypeObject CaptureType = { PyVarObject_HEAD_INIT(NULL, 0) };
+
+//===================================================================================================================
+// Stream: a session of the DLL streaming into its own buffers
+
+typedef struct
+{
+    PyObject_HEAD
+    EVM_HANDLE Session;
+    int Width;          // Samples per DVALID in the buffers
+    int SampleType;     // With the layout bits
+    int Outstanding;    // Blocks not yet given back
+    bool Closed;        // Closed by the caller, the session goes when the last block is given back
+} StreamObject;
+
+typedef struct
+{
+    PyObject_HEAD
+    StreamObject* Stream;
+    int Index;          // -1 once released
+    int Exports;
+    void* Data;
+    View V;
+    EVM_BlockInfo Info;
+} BlockObject;
+
+static PyTypeObject StreamType = { PyVarObject_HEAD_INIT(NULL, 0) };
+static PyTypeObject BlockType = { PyVarObject_HEAD_INIT(NULL, 0) };
+
+static void CloseSession(StreamObject* Self)
+{
+    if (Self->Session == NULL) return;
+    EVM_HANDLE Session = Self->Session;
+    Self->Session = NULL;
+    Py_BEGIN_ALLOW_THREADS
+    EVM_SessionClose(Session);
+    Py_END_ALLOW_THREADS
+}
+
+static void GiveBack(BlockObject* Self)
+{
+    if (Self->Index < 0) return;
+    StreamObject* Stream = Self->Stream;
+    if (Stream->Session != NULL) EVM_BufferRelease(Stream->Session, Self->Index);
+    Self->Index = -1;
+    Self->Data = NULL;
+    if (--Stream->Outstanding == 0 && Stream->Closed) CloseSession(Stream);
+}
+
+static int Stream_init(StreamObject* Self, PyObject* Args, PyObject* Kwds)
+{
+    static const char* Keywords[] = { "device", "channels", "samples", "frames", "buffers", "sample_type",
+                                      "cfghigh", "workers", "roi", NULL };
+    int Device, Channels, Samples, Frames = 0, Buffers = 8, SampleType = EVM_SAMPLE_INT32, CfgHigh = 0, Workers = 1;
+    PyObject* Roi = NULL;
+    if (!PyArg_ParseTupleAndKeywords(Args, Kwds, "iii|iiiiiO", (char**)Keywords, &Device, &Channels, &Samples,
+                                     &Frames, &Buffers, &SampleType, &CfgHigh, &Workers, &Roi))
+        return -1;
+    if (FormatOf(SampleType) == NULL)
+    {
+        PyErr_SetString(PyExc_ValueError, "unknown sample type");
+        return -1;
+    }
+    if (Self->Session != NULL)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "stream already open");
+        return -1;
+    }
+
+    int* List;
+    int nSelected;
+    if (!ParseRoi(Roi, &List, &nSelected)) return -1;
+
+    Self->Width = (List != NULL) ? nSelected : Channels;
+    Self->SampleType = (SampleType & EVM_SAMPLE_TYPE_MASK) | LayoutFor(Self->Width, List != NULL);
+    Self->Outstanding = 0;
+    Self->Closed = false;
+
+    byte Cfg = (byte)CfgHigh;
+    long Result;
+    EVM_HANDLE Session;
+    Py_BEGIN_ALLOW_THREADS
+    Session = EVM_SessionOpen(Device);
+    Result = (Session != NULL) ? 0 : -2;
+    if (Result == 0) Result = EVM_StreamSetSampleType(Session, Self->SampleType, &Cfg);
+    if (Result == 0 && List != NULL) Result = EVM_StreamSetROI(Session, nSelected, List);
+    if (Result == 0) Result = EVM_StreamSetPipeline(Session, Workers, 0);
+    if (Result == 0) Result = EVM_StreamStart(Session, Channels, Samples, Frames, Buffers);
+    if (Result != 0 && Session != NULL) EVM_SessionClose(Session);
+    Py_END_ALLOW_THREADS
+    free(List);
+
+    if (Result != 0)
+    {
+        RaiseError(Result);
+        return -1;
+    }
+    Self->Session = Session;
+    return 0;
+}
+
+static void Stream_dealloc(StreamObject* Self)
+{
+    // Blocks hold a reference: none is outstanding here
+    CloseSession(Self);
+    Py_TYPE(Self)->tp_free((PyObject*)Self);
+}
+
+// Waits in short slices with the GIL released so other threads run and Ctrl+C is seen
+static PyObject* Acquire(StreamObject* Self, int TimeoutMs, bool Iterating)
+{
+    if (Self->Session == NULL || Self->Closed)
+    {
+        PyErr_SetString(PyExc_ValueError, "stream is closed");
+        return NULL;
+    }
+
+    void* Data = NULL;
+    int Samples = 0;
+    EVM_BlockInfo Info;
+    long Index = -4;
+    int Left = TimeoutMs;
+    do
+    {
+        int Slice = (Left < 0 || Left > 100) ? 100 : Left;
+        Py_BEGIN_ALLOW_THREADS
+        Index = EVM_BufferAcquire(Self->Session, Slice, &Data, &Samples, &Info);
+        Py_END_ALLOW_THREADS
+        if (Index != -4) break;
+        if (PyErr_CheckSignals() != 0) return NULL;
+        if (Left >= 0) Left -= Slice;
+    } while (Left != 0);
+
+    if (Index == -4 && !Iterating) Py_RETURN_NONE;
+    if (Index == -13 && Iterating) return NULL;  // StopIteration
+    if (Index < 0) return RaiseError(Index);
+
+    // The session hands out whole DVALIDs, anything else can't be viewed as (channel, DVALID)
+    if (Samples % Self->Width != 0)
+    {
+        EVM_BufferRelease(Self->Session, Index);
+        PyErr_SetString(PyExc_BufferError, "block does not hold whole DVALIDs");
+        return NULL;
+    }
+
+    BlockObject* Block = PyObject_New(BlockObject, &BlockType);
+    if (Block == NULL)
+    {
+        EVM_BufferRelease(Self->Session, Index);
+        return NULL;
+    }
+    Py_INCREF(Self);
+    Block->Stream = Self;
+    Block->Index = Index;
+    Block->Exports = 0;
+    Block->Data = Data;
+    Block->Info = Info;
+    Block->V.Set(Self->Width, Samples / Self->Width, Self->SampleType);
+    Self->Outstanding++;
+    return (PyObject*)Block;
+}
+
+static PyObject* Stream_acquire(StreamObject* Self, PyObject* Args, PyObject* Kwds)
+{
+    static const char* Keywords[] = { "timeout_ms", NULL };
+    int TimeoutMs = 1000;
+    if (!PyArg_ParseTupleAndKeywords(Args, Kwds, "|i", (char**)Keywords, &TimeoutMs)) return NULL;
+    return Acquire(Self, TimeoutMs, false);
+}
+
+static PyObject* Stream_iter(StreamObject* Self)
+{
+    Py_INCREF(Self);
+    return (PyObject*)Self;
+}
+
+static PyObject* Stream_next(StreamObject* Self)
+{
+    return Acquire(Self, -1, true);
+}
+
+static PyObject* Stream_stop(StreamObject* Self, PyObject*)
+{
+    long Result = 0;
+    if (Self->Session != NULL)
+    {
+        Py_BEGIN_ALLOW_THREADS
+        Result = EVM_StreamStop(Self->Session);
+        Py_END_ALLOW_THREADS
+    }
+    if (Result != 0) return RaiseError(Result);
+    Py_RETURN_NONE;
+}
+
+static PyObject* Stream_close(StreamObject* Self, PyObject*)
+{
+    if (Self->Session != NULL && !Self->Closed)
+    {
+        Py_BEGIN_ALLOW_THREADS
+        EVM_StreamStop(Self->Session);
+        Py_END_ALLOW_THREADS
+        Self->Closed = true;
+        if (Self->Outstanding == 0) CloseSession(Self);
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* Stream_enter(StreamObject* Self, PyObject*)
+{
+    Py_INCREF(Self);
+    return (PyObject*)Self;
+}
+
+static PyObject* Stream_exit(StreamObject* Self, PyObject*)
+{
+    return Stream_close(Self, NULL);
+}
+
+static PyObject* Stream_stats(StreamObject* Self, PyObject*)
+{
+    EVM_StreamStats S;
+    long Result = (Self->Session != NULL) ? EVM_StreamGetStats(Self->Session, &S) : -7;
+    if (Result != 0) return RaiseError(Result);
+    return Py_BuildValue("{sLsLsLsLsisisisisi}", "transfers", S.Transfers, "blocks", S.Blocks,
+                         "transfer_waits", S.TransferWaits, "buffer_waits", S.BufferWaits,
+                         "decode_queue_depth", S.DecodeQueueDepth, "decode_queue_max", S.DecodeQueueMax,
+                         "ready_queue_depth", S.ReadyQueueDepth, "ready_queue_max", S.ReadyQueueMax,
+                         "workers", S.Workers);
+}
+
+static PyMethodDef Stream_methods[] = {
+    { "acquire", (PyCFunction)Stream_acquire, METH_VARARGS | METH_KEYWORDS,
+      "acquire(timeout_ms=1000) -> Block or None on timeout. The GIL is released while waiting." },
+    { "stop", (PyCFunction)Stream_stop, METH_NOARGS, "Stops the stream, acquired blocks stay valid." },
+    { "close", (PyCFunction)Stream_close, METH_NOARGS, "Stops the stream and closes the board once every block is released." },
+    { "stats", (PyCFunction)Stream_stats, METH_NOARGS, "Pipeline counters as a dict." },
+    { "__enter__", (PyCFunction)Stream_enter, METH_NOARGS, NULL },
+    { "__exit__", (PyCFunction)Stream_exit, METH_VARARGS, NULL },
+    { NULL }
+};
+
+//===================================================================================================================
+// Block: one stream buffer, borrowed from the session
+
+static void Block_dealloc(BlockObject* Self)
+{
+    GiveBack(Self);
+    Py_DECREF(Self->Stream);
+    PyObject_Del(Self);
+}
+
+static int Block_getbuffer(BlockObject* Self, Py_buffer* Buf, int Flags)
+{
+    if (Self->Index < 0)
+    {
+        PyErr_SetString(PyExc_BufferError, "block already released");
+        return -1;
+    }
+    if (FillBuffer((PyObject*)Self, Buf, Flags, Self->Data, Self->V, true) != 0) return -1;
+    Self->Exports++;
+    return 0;
+}
+
+static void Block_releasebuffer(BlockObject* Self, Py_buffer*)
+{
+    Self->Exports--;
+}
+
+static PyObject* Block_release(BlockObject* Self, PyObject*)
+{
+    if (Self->Exports > 0)
+    {
+        PyErr_SetString(PyExc_BufferError, "block is still viewed by an array");
+        return NULL;
+    }
+    GiveBack(Self);
+    Py_RETURN_NONE;
+}
+
+static PyObject* Block_get(BlockObject* Self, void* Field)
+{
+    const EVM_BlockInfo& I = Self->Info;
+    switch ((int)(intptr_t)Field)
+    {
+    case 0: return PyLong_FromLongLong(I.Sequence);
+    case 1: return PyLong_FromLongLong(I.SampleIndex);
+    case 2: return PyLong_FromLong(I.Frame);
+    case 3: return PyLong_FromLong(I.AorB);
+    case 4: return PyLong_FromLong(I.Status);
+    case 5: return PyLong_FromLong(I.Group);
+    case 6: return PyFloat_FromDouble(I.Timestamp);
+    case 7: return PyFloat_FromDouble(I.Time);
+    }
+    Py_RETURN_NONE;
+}
+
+static PyBufferProcs Block_buffer = { (getbufferproc)Block_getbuffer, (releasebufferproc)Block_releasebuffer };
+
+static PyGetSetDef Block_getset[] = {
+    { "sequence", (getter)Block_get, NULL, "Block number since the stream started", (void*)0 },
+    { "sample_index", (getter)Block_get, NULL, "Index of the first sample within its frame", (void*)1 },
+    { "frame", (getter)Block_get, NULL, "Capture number since the stream started", (void*)2 },
+    { "aorb", (getter)Block_get, NULL, "0 if the first sample is from side A, 1 if from side B", (void*)3 },
+    { "status", (getter)Block_get, NULL, "0, or the error that ended the stream", (void*)4 },
+    { "group", (getter)Block_get, NULL, "2 * channel group + side of a filtered block", (void*)5 },
+    { "timestamp", (getter)Block_get, NULL, "Performance counter seconds when its transfer completed", (void*)6 },
+    { "time", (getter)Block_get, NULL, "Estimated time of the first DVALID of its transfer", (void*)7 },
+    { NULL }
+};
+
+static PyMethodDef Block_methods[] = {
+    { "release", (PyCFunction)Block_release, METH_NOARGS, "Gives the buffer back to the stream now rather than when the block is freed." },
+    { NULL }
+};
+
+//===================================================================================================================
+// Module functions
+
+static PyObject* Module_capture(PyObject*, PyObject* Args, PyObject* Kwds)
+{
+    static const char* Keywords[] = { "device", "channels", "samples", "sample_type", "cfghigh", "roi", NULL };
+    int Device, Channels, Samples, SampleType = EVM_SAMPLE_INT32, CfgHigh = 0;
+    PyObject* Roi = NULL;
+    if (!PyArg_ParseTupleAndKeywords(Args, Kwds, "iii|iiO", (char**)Keywords, &Device, &Channels, &Samples,
+                                     &SampleType, &CfgHigh, &Roi))
+        return NULL;
+    if (FormatOf(SampleType) == NULL || Channels <= 0 || Samples <= 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "invalid arguments");
+        return NULL;
+    }
+
+    int* List;
+    int nSelected;
+    if (!ParseRoi(Roi, &List, &nSelected)) return NULL;
+    int Width = (List != NULL) ? nSelected : Channels;
+    int Type = (SampleType & EVM_SAMPLE_TYPE_MASK) | LayoutFor(Width, List != NULL);
+
+    CaptureObject* Cap = PyObject_New(CaptureObject, &CaptureType);
+    if (Cap == NULL)
+    {
+        free(List);
+        return NULL;
+    }
+    Cap->V.Set(Width, Samples, Type);
+    Cap->Data = malloc((size_t)Width * Samples * ItemSize(Type));
+    Cap->AorB = 0;
+    if (Cap->Data == NULL)
+    {
+        free(List);
+        Py_DECREF(Cap);
+        return PyErr_NoMemory();
+    }
+
+    byte Cfg = (byte)CfgHigh;
+    long Result;
+    Py_BEGIN_ALLOW_THREADS
+    if (List != NULL) Result = EVM_DataCapROI(&Device, Channels, Samples, Type, &Cfg, nSelected, List, Cap->Data, &Cap->AorB);
+    else Result = EVM_DataCapEx(&Device, Channels, Samples, Type, &Cfg, Cap->Data, &Cap->AorB);
+    Py_END_ALLOW_THREADS
+    free(List);
+
+    if (Result != 0)
+    {
+        Py_DECREF(Cap);
+        return RaiseError(Result);
+    }
+    return (PyObject*)Cap;
+}
+
+static PyObject* Module_simulator(PyObject*, PyObject* Args, PyObject* Kwds)
+{
+    static const char* Keywords[] = { "channels", "rate", NULL };
+    int Channels = 256;
+    double Rate = 0;
+    if (!PyArg_ParseTupleAndKeywords(Args, Kwds, "|id", (char**)Keywords, &Channels, &Rate)) return NULL;
+    long Result = EVM_SimulatorSetup(Channels, Rate);
+    if (Result < 0) return RaiseError(Result);
+    return PyLong_FromLong(Result);
+}
+
+static PyObject* Module_find(PyObject*, PyObject* Args)
+{
+    const char* Serial;
+    if (!PyArg_ParseTuple(Args, "s", &Serial)) return NULL;
+    return PyLong_FromLong(EVM_FindDevice((char*)Serial));
+}
+
+static PyMethodDef Module_methods[] = {
+    { "capture", (PyCFunction)Module_capture, METH_VARARGS | METH_KEYWORDS,
+      "capture(device, channels, samples, sample_type=INT32, cfghigh=0, roi=None) -> Capture\n"
+      "One blocking capture. numpy.asarray() of the result has shape (channels, samples)." },
+    { "simulator", (PyCFunction)Module_simulator, METH_VARARGS | METH_KEYWORDS,
+      "simulator(channels=256, rate=0) -> device number of the simulated board, rate in DVALIDs per second (0 = unpaced)" },
+    { "find_device", (PyCFunction)Module_find, METH_VARARGS, "find_device(serial) -> device number, -1 if not attached" },
+    { NULL }
+};
+
+static struct PyModuleDef Module = { PyModuleDef_HEAD_INIT, "ddc264evm", "DDC264EVM acquisition, zero copy buffers", -1, Module_methods };
+
+PyMODINIT_FUNC PyInit_ddc264evm(void)
+{
+    CaptureType.tp_name = "ddc264evm.Capture";
+    CaptureType.tp_basicsize = sizeof(CaptureObject);
+    CaptureType.tp_flags = Py_TPFLAGS_DEFAULT;
+    CaptureType.tp_doc = "Samples of one capture, exported through the buffer protocol";
+    CaptureType.tp_dealloc = (destructor)Capture_dealloc;
+    CaptureType.tp_as_buffer = &Capture_buffer;
+    CaptureType.tp_getset = Capture_getset;
+
+    StreamType.tp_name = "ddc264evm.Stream";
+    StreamType.tp_basicsize = sizeof(StreamObject);
+    StreamType.tp_flags = Py_TPFLAGS_DEFAULT;
+    StreamType.tp_doc = "Stream(device, channels, samples, frames=0, buffers=8, sample_type=INT32, cfghigh=0, workers=1, roi=None)\n"
+                        "Streams frames of channels x samples (0 frames = until stopped). Iterating yields Blocks.";
+    StreamType.tp_new = PyType_GenericNew;
+    StreamType.tp_init = (initproc)Stream_init;
+    StreamType.tp_dealloc = (destructor)Stream_dealloc;
+    StreamType.tp_iter = (getiterfunc)Stream_iter;
+    StreamType.tp_iternext = (iternextfunc)Stream_next;
+    StreamType.tp_methods = Stream_methods;
+
+    BlockType.tp_name = "ddc264evm.Block";
+    BlockType.tp_basicsize = sizeof(BlockObject);
+    BlockType.tp_flags = Py_TPFLAGS_DEFAULT;
+    BlockType.tp_doc = "One stream buffer, owned by the DLL until released";
+    BlockType.tp_dealloc = (destructor)Block_dealloc;
+    BlockType.tp_as_buffer = &Block_buffer;
+    BlockType.tp_getset = Block_getset;
+    BlockType.tp_methods = Block_methods;
+
+    if (PyType_Ready(&CaptureType) < 0 || PyType_Ready(&StreamType) < 0 || PyType_Ready(&BlockType) < 0) return NULL;
+
+    PyObject* M = PyModule_Create(&Module);
+    if (M == NULL) return NULL;
+
+    EVMError = PyErr_NewException("ddc264evm.EVMError", PyExc_OSError, NULL);
+    Py_INCREF(EVMError);
+    PyModule_AddObject(M, "EVMError", EVMError);
+    Py_INCREF(&StreamType);
+    PyModule_AddObject(M, "Stream", (PyObject*)&StreamType);
+    PyModule_AddIntConstant(M, "INT32", EVM_SAMPLE_INT32);
+    PyModule_AddIntConstant(M, "UINT16", EVM_SAMPLE_UINT16);
+    PyModule_AddIntConstant(M, "FLOAT32", EVM_SAMPLE_FLOAT32);
+    PyModule_AddIntConstant(M, "FLOAT64", EVM_SAMPLE_FLOAT64);
+    PyModule_AddIntConstant(M, "SIMULATED_DEVICE", EVM_SIMULATED_DEVICE);
+    return M;
+}
@@ -0,0 +1,28 @@
+# Builds the ddc264evm extension against the DLL import library.
+#
+#   python setup.py build_ext --inplace
+#
+# EVM_LIB_DIR points to the folder holding DDC264EVM_IO.lib (default: the Release|Win32 output of
+# DDC264EVM_IO.sln). CyAPI.lib is 32-bit only, so is the DLL: the module needs a 32-bit Python.
+# DDC264EVM_IO.dll must be next to the module or on the PATH when it is imported.
+
+import os
+from setuptools import setup, Extension
+
+here = os.path.dirname(os.path.abspath(__file__))
+lib_dir = os.environ.get("EVM_LIB_DIR", os.path.join(here, "..", "Release"))
+
+setup(
+    name="ddc264evm",
+    version="3.3",
+    description="DDC264EVM acquisition with zero copy NumPy buffers",
+    ext_modules=[
+        Extension(
+            "ddc264evm",
+            sources=["ddc264evm.cpp"],
+            include_dirs=[os.path.join(here, "..")],
+            library_dirs=[lib_dir],
+            libraries=["DDC264EVM_IO"],
+        )
+    ],
+)